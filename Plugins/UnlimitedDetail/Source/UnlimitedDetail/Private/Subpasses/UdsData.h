@@ -1,13 +1,18 @@
 #pragma once
 
 #include "UdsSubpassSharedTypes.h"
+#include "UDDefine.h"
+#include "UDTextureUploader.h"
 #include "PostProcess/PostProcessTonemap.h"
 
+// Per-frame data for a single view, pooled by FUdsCompositeState and reset at the start of every frame
 struct FUdsData
 {
 	bool bInitialized = false;
 	bool bEnabled;
 
+	uint32 FrameNumber = 0;
+
 	//FRDGTextureDesc FSROutputTextureDesc;
 	//FPostProcessSettings ChromaticAberrationPostProcessSettings;
 	//FScreenPassTextureViewportParameters PassOutputViewportParams;
@@ -19,7 +24,20 @@ struct FUdsData
 	FRDGTextureRef SceneDepthTexture;
 	FTexture2DRHIRef UdColorTexture;
 	FTexture2DRHIRef UdDepthTexture;
+	FUDTextureUploadPtr UdUpload; // Game thread staged, written into the textures when the family starts rendering
+	FRDGTextureRef UdColorRDGTexture = nullptr; // The UD textures as registered with this frame's graph, valid once UdUpload has gone in
+	FRDGTextureRef UdDepthRDGTexture = nullptr;
+	EUDOutputFormat UdOutputFormat;
+	EUDDepthPrepass UdDepthPrepass = EUDDepthPrepass::Off;
+	bool bUdTemporal = false; // Rendered at internal resolution and written into scene color before TSR, see r.Uds.Temporal
+	FVector2f UdJitter = FVector2f::ZeroVector;
+	TArray<FUDInstanceMotion> UdInstanceMotion; // Moved since the previous frame, their pixels carry index + 1 in the UD color alpha
+	FUDCoverage UdCoverage;
+	FUDReprojection UdReprojection; // The UD textures were rendered for an earlier camera, see r.Uds.RenderRate
+	FUDCheckerboard UdCheckerboard; // The UD textures hold two interleaved halves, see r.Uds.Checkerboard
+	TSharedPtr<const TArray<FColor>, ESPMode::ThreadSafe> UdCheckerboardReference; // Full resolution render to score the reconstruction against
 	FScreenPassTexture FinalOutput;
 
 	FVector2d ColorDepthExtentRatio; // Adding
-};
\ No newline at end of file
+	FVector2f UdScale = FVector2f::UnitVector; // UD pixels per output pixel, below 1 with r.Uds.ScreenPercentage
+};
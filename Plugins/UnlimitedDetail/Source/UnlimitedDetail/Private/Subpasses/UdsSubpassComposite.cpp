@@ -1,6 +1,7 @@
 #include "UdsSubpassComposite.h"
 #include "UDSubsystem.h"
 #include "ExternalTexture.h"
+#include "RenderGraphUtils.h"
 
 #include "Runtime/Renderer/Private/SceneRendering.h"
 
@@ -11,9 +12,64 @@ static FAutoConsoleVariableRef CVarUdsComposite(
 	TEXT("Uds Composite Enabled = 1 or 0"),
 	ECVF_RenderThreadSafe);
 
+static float GUdsCompositeScissorThreshold = 0.5f;
+static FAutoConsoleVariableRef CVarUdsCompositeScissorThreshold(
+	TEXT("r.Uds.Composite.ScissorThreshold"),
+	GUdsCompositeScissorThreshold,
+	TEXT("Fraction of the view the UD coverage rect has to stay under for the composite to be scissored to it (the rest of the view is copied). 0 always composites the full view."),
+	ECVF_RenderThreadSafe);
+
+static int32 GUdsCompositeCompute = 1;
+static FAutoConsoleVariableRef CVarUdsCompositeCompute(
+	TEXT("r.Uds.Composite.Compute"),
+	GUdsCompositeCompute,
+	TEXT("1: tiled compute composite, tiles are classified as scene only, UD only or mixed and each class is dispatched indirectly (default)\n")
+	TEXT("0: full screen pixel shader composite, also used when the output can't be bound as a UAV"),
+	ECVF_RenderThreadSafe);
+
+// Matches UDS_COMPOSITE_TILE_SIZE in Uds_Composite.usf
+#define UDS_COMPOSITE_TILE_SIZE 16
+
+// Matches UDS_TILE_CLASS_* in Uds_Composite.usf
+enum class EUdsCompositeTileClass : uint8
+{
+	Scene,
+	Ud,
+	Mixed,
+
+	MAX
+};
 
 class FSceneRenderTargets;
 
+// Permutation dimensions shared by every composite shader, picked per view by GetCompositePermutation()
+class FUdsOutputFormatDim : SHADER_PERMUTATION_ENUM_CLASS("UDS_OUTPUT_FORMAT", EUDOutputFormat);	// decodes the UD textures as uploaded by FUDTextureUploader
+class FUdsDepthConventionDim : SHADER_PERMUTATION_ENUM_CLASS("UDS_DEPTH_CONVENTION", EUDDepthConvention);
+class FUdsDepthRatioDim : SHADER_PERMUTATION_BOOL("UDS_DEPTH_RATIO");	// scene depth extent differs from scene color, see ColorDepthExtentRatio
+class FUdsUpsampleDim : SHADER_PERMUTATION_BOOL("UDS_UPSAMPLE");		// UD rendered below output resolution
+using FUdsCompositeDomain = TShaderPermutationDomain<FUdsOutputFormatDim, FUdsDepthConventionDim, FUdsDepthRatioDim, FUdsUpsampleDim>;
+
+static bool ShouldCompileCompositePermutation(const FGlobalShaderPermutationParameters& Parameters, const FUdsCompositeDomain& PermutationVector)
+{
+	// The depth convention is fixed by how each format is converted on upload
+	if (PermutationVector.Get<FUdsDepthConventionDim>() != GetUDDepthConvention(PermutationVector.Get<FUdsOutputFormatDim>()))
+	{
+		return false;
+	}
+
+	return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+}
+
+static FUdsCompositeDomain GetCompositePermutation(const FUdsData& Data)
+{
+	FUdsCompositeDomain PermutationVector;
+	PermutationVector.Set<FUdsOutputFormatDim>(Data.UdOutputFormat);
+	PermutationVector.Set<FUdsDepthConventionDim>(GetUDDepthConvention(Data.UdOutputFormat));
+	PermutationVector.Set<FUdsDepthRatioDim>(Data.ColorDepthExtentRatio != FVector2d::UnitVector);
+	PermutationVector.Set<FUdsUpsampleDim>(Data.UdScale != FVector2f::UnitVector);
+	return PermutationVector;
+}
+
 ///
 /// PIXEL SHADER
 ///
@@ -23,6 +79,8 @@ public:
 	DECLARE_GLOBAL_SHADER(FUdsCompositePS);
 	SHADER_USE_PARAMETER_STRUCT(FUdsCompositePS, FGlobalShader);
 
+	using FPermutationDomain = FUdsCompositeDomain;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		SHADER_PARAMETER_STRUCT_INCLUDE(FCompositePassParameters, Composite)
 		RENDER_TARGET_BINDING_SLOTS()
@@ -30,7 +88,7 @@ public:
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
-		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+		return ShouldCompileCompositePermutation(Parameters, FPermutationDomain(Parameters.PermutationId));
 	}
 	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
 	{
@@ -39,6 +97,101 @@ public:
 
 	IMPLEMENT_GLOBAL_SHADER(FUdsCompositePS, "/Plugins/UnlimitedDetail/Private/Uds_Composite.usf", "MainPS", SF_Pixel);
 
+///
+/// COMPUTE SHADERS
+///
+BEGIN_SHADER_PARAMETER_STRUCT(FUdsCompositeTileParameters, )
+	SHADER_PARAMETER(FIntPoint, RectMin)
+	SHADER_PARAMETER(FIntPoint, RectMax)
+	SHADER_PARAMETER(uint32, TileListStride)
+END_SHADER_PARAMETER_STRUCT()
+
+class FUdsCompositeClassifyCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsCompositeClassifyCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsCompositeClassifyCS, FGlobalShader);
+
+	using FPermutationDomain = FUdsCompositeDomain;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FCompositePassParameters, Composite)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FUdsCompositeTileParameters, Tiles)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, RWTileIndirectArgs)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, RWTileList)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return ShouldCompileCompositePermutation(Parameters, FPermutationDomain(Parameters.PermutationId));
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("UDS_COMPOSITE_TILE_SIZE"), UDS_COMPOSITE_TILE_SIZE);
+	}
+};
+
+	IMPLEMENT_GLOBAL_SHADER(FUdsCompositeClassifyCS, "/Plugins/UnlimitedDetail/Private/Uds_Composite.usf", "ClassifyCS", SF_Compute);
+
+class FUdsCompositeApplyCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsCompositeApplyCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsCompositeApplyCS, FGlobalShader);
+
+	class FTileClassDim : SHADER_PERMUTATION_ENUM_CLASS("UDS_TILE_CLASS", EUdsCompositeTileClass);
+	using FPermutationDomain = TShaderPermutationDomain<FUdsCompositeDomain, FTileClassDim>;
+
+	// Drops the dimensions a tile class never reads, so those tiles share one permutation
+	static FPermutationDomain RemapPermutation(FPermutationDomain PermutationVector)
+	{
+		FUdsCompositeDomain CompositeVector = PermutationVector.Get<FUdsCompositeDomain>();
+		const EUdsCompositeTileClass TileClass = PermutationVector.Get<FTileClassDim>();
+
+		// Scene tiles are a plain copy and never decode UD
+		if (TileClass == EUdsCompositeTileClass::Scene)
+		{
+			CompositeVector = FUdsCompositeDomain();
+			CompositeVector.Set<FUdsDepthConventionDim>(GetUDDepthConvention(CompositeVector.Get<FUdsOutputFormatDim>()));
+		}
+
+		// UD tiles already passed the depth test in ClassifyCS
+		if (TileClass == EUdsCompositeTileClass::Ud)
+		{
+			CompositeVector.Set<FUdsDepthRatioDim>(false);
+		}
+
+		PermutationVector.Set<FUdsCompositeDomain>(CompositeVector);
+		return PermutationVector;
+	}
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FCompositePassParameters, Composite)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FUdsCompositeTileParameters, Tiles)
+		SHADER_PARAMETER(uint32, TileListOffset)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, TileList)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, OutputTexture)
+		RDG_BUFFER_ACCESS(IndirectArgs, ERHIAccess::IndirectArgs)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		const FPermutationDomain PermutationVector(Parameters.PermutationId);
+		if (RemapPermutation(PermutationVector) != PermutationVector)
+		{
+			return false;
+		}
+
+		return ShouldCompileCompositePermutation(Parameters, PermutationVector.Get<FUdsCompositeDomain>());
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("UDS_COMPOSITE_TILE_SIZE"), UDS_COMPOSITE_TILE_SIZE);
+	}
+};
+
+	IMPLEMENT_GLOBAL_SHADER(FUdsCompositeApplyCS, "/Plugins/UnlimitedDetail/Private/Uds_Composite.usf", "ApplyCS", SF_Compute);
+
 void FUdsSubpassComposite::ParseEnvironment(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs)
 {
 	Data->bEnabled = GUdsComposite > 0;// && Data->UdColorTexture&& Data->UdDepthTexture;
@@ -75,6 +228,14 @@ void FUdsSubpassComposite::CreateResources(FRDGBuilder& GraphBuilder, const FVie
 		Data->ColorDepthExtentRatio.X = ColorExtentF.X/DepthExtentF.X;
 		Data->ColorDepthExtentRatio.Y = ColorExtentF.Y/DepthExtentF.Y;
 
+		// UD is sized off the unconstrained view rect, and scaled down further by r.Uds.ScreenPercentage
+		if (Data->UdColorTexture.IsValid())
+		{
+			const FIntPoint UdSize = Data->UdColorTexture->GetSizeXY();
+			const FIntPoint OutputSize = PassInputs.SceneColor.ViewRect.Size();
+			Data->UdScale = FVector2f(UdSize.X / (float)OutputSize.X, UdSize.Y / (float)OutputSize.Y);
+		}
+
 		// Setup our textures for use in our post process shader later
 		// I beleive this has to be registered as external?
 		// Data->SceneDepthTexture = CurSceneDepth; // Might want to find a decent way to pass a zero depth value while scene depth isn't ready?
@@ -95,29 +256,154 @@ void FUdsSubpassComposite::PostProcess(FRDGBuilder& GraphBuilder, const FViewInf
 	if (Data->bEnabled)
 	{
 		FScreenPassRenderTarget Output = PassInputs.OverrideOutput;
+		FScreenPassTexture Input(Data->CurrentInputTexture, Data->InputViewport.Rect);
+
+		// No UD pixels were written for this view, or its textures never made it into this graph; scene color goes straight through
+		if (!Data->UdCoverage.bHasCoverage || !Data->UdColorRDGTexture)
+		{
+			AddDrawTexturePass(GraphBuilder, View, Input, Output);
 
-		FUdsCompositePS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsCompositePS::FParameters>();
+			Data->FinalOutput = Output;
+			Data->CurrentInputTexture = Output.Texture;
+			return;
+		}
 
-		PassParameters->Composite.InputTexture = Data->CurrentInputTexture;
-		PassParameters->Composite.DepthTexture = Data->SceneDepthTexture;
-		PassParameters->Composite.UdColorTexture = Data->UdColorTexture->GetTexture2D();
-		PassParameters->Composite.UdDepthTexture = Data->UdDepthTexture->GetTexture2D();
-		PassParameters->RenderTargets[0] = FRenderTargetBinding(Output.Texture, ERenderTargetLoadAction::ENoAction);
+		// Coverage is in UD pixels, UD textures are addressed with the output pixel position scaled by UdScale
+		FIntRect CompositeRect(
+			FMath::FloorToInt(Data->UdCoverage.Rect.Min.X / Data->UdScale.X),
+			FMath::FloorToInt(Data->UdCoverage.Rect.Min.Y / Data->UdScale.Y),
+			FMath::CeilToInt(Data->UdCoverage.Rect.Max.X / Data->UdScale.X),
+			FMath::CeilToInt(Data->UdCoverage.Rect.Max.Y / Data->UdScale.Y));
+		CompositeRect.Clip(Data->OutputViewport.Rect);
 
-		// Save the ratio to correct the editor depth size bug
-		PassParameters->Composite.ColorDepthRatioX = Data->ColorDepthExtentRatio.X;
-		PassParameters->Composite.ColorDepthRatioY = Data->ColorDepthExtentRatio.Y;
-		
-		TShaderMapRef<FUdsCompositePS> PixelShader(View.ShaderMap);
+		FScreenPassTextureViewport CompositeViewport = Data->OutputViewport;
+		ERenderTargetLoadAction LoadAction = ERenderTargetLoadAction::ENoAction;
 
-		AddDrawScreenPass(GraphBuilder,
-			RDG_EVENT_NAME("UdsSubpassComposite (PS)"),
-			View, Data->OutputViewport, Data->InputViewport,
-			PixelShader, PassParameters,
-			EScreenPassDrawFlags::None
-		);
+		if (CompositeRect.Area() < GUdsCompositeScissorThreshold * Data->OutputViewport.Rect.Area())
+		{
+			// A plain copy is cheaper than the composite, only pay for the latter where UD actually rendered
+			AddDrawTexturePass(GraphBuilder, View, Input, Output);
+
+			CompositeViewport = FScreenPassTextureViewport(Data->OutputViewport.Extent, CompositeRect);
+			LoadAction = ERenderTargetLoadAction::ELoad;
+		}
+
+		if (GUdsCompositeCompute && CanUseTiledComposite(Output, CompositeViewport.Rect))
+		{
+			// When the rest of the view was copied above, the scene-only tiles are already in the output
+			AddTiledComposite(GraphBuilder, View, Output, CompositeViewport.Rect, LoadAction == ERenderTargetLoadAction::ELoad);
+		}
+		else
+		{
+			FUdsCompositePS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsCompositePS::FParameters>();
+			SetCompositeParameters(PassParameters->Composite);
+			PassParameters->RenderTargets[0] = FRenderTargetBinding(Output.Texture, LoadAction);
+
+			TShaderMapRef<FUdsCompositePS> PixelShader(View.ShaderMap, GetCompositePermutation(*Data));
+
+			AddDrawScreenPass(GraphBuilder,
+				RDG_EVENT_NAME("UdsSubpassComposite (PS) %dx%d", CompositeViewport.Rect.Width(), CompositeViewport.Rect.Height()),
+				View, CompositeViewport, CompositeViewport,
+				PixelShader, PassParameters,
+				EScreenPassDrawFlags::None
+			);
+		}
 
 		Data->FinalOutput = Output;
 		Data->CurrentInputTexture = Output.Texture;
 	}
-}
\ No newline at end of file
+}
+
+void FUdsSubpassComposite::SetCompositeParameters(FCompositePassParameters& OutParameters) const
+{
+	OutParameters.InputTexture = Data->CurrentInputTexture;
+	OutParameters.DepthTexture = Data->SceneDepthTexture;
+	if (Data->UdOutputFormat == EUDOutputFormat::Packed)
+	{
+		OutParameters.UdPackedTexture = Data->UdColorRDGTexture;
+	}
+	else
+	{
+		OutParameters.UdColorTexture = Data->UdColorRDGTexture;
+		OutParameters.UdDepthTexture = Data->UdDepthRDGTexture;
+	}
+
+	// Save the ratio to correct the editor depth size bug
+	OutParameters.ColorDepthRatioX = Data->ColorDepthExtentRatio.X;
+	OutParameters.ColorDepthRatioY = Data->ColorDepthExtentRatio.Y;
+	OutParameters.UdScale = Data->UdScale;
+}
+
+bool FUdsSubpassComposite::CanUseTiledComposite(const FScreenPassRenderTarget& Output, const FIntRect& Rect) const
+{
+	const FIntPoint NumTiles = FIntPoint::DivideAndRoundUp(Rect.Size(), UDS_COMPOSITE_TILE_SIZE);
+
+	// Each class's tiles are dispatched as a 1D group count
+	return EnumHasAnyFlags(Output.Texture->Desc.Flags, TexCreate_UAV) && NumTiles.X * NumTiles.Y <= (int32)GRHIMaxDispatchThreadGroupsPerDimension.X;
+}
+
+void FUdsSubpassComposite::AddTiledComposite(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FScreenPassRenderTarget& Output, const FIntRect& Rect, bool bSceneTilesInOutput)
+{
+	RDG_EVENT_SCOPE(GraphBuilder, "UdsSubpassComposite (CS) %dx%d", Rect.Width(), Rect.Height());
+
+	const FIntPoint TileCount = FIntPoint::DivideAndRoundUp(Rect.Size(), UDS_COMPOSITE_TILE_SIZE);
+	const uint32 NumTiles = TileCount.X * TileCount.Y;
+	const uint32 NumClasses = (uint32)EUdsCompositeTileClass::MAX;
+
+	// Group counts are X, 1, 1 per class, X is counted up by the classification
+	FRDGBufferRef IndirectArgs = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateIndirectDesc<FRHIDispatchIndirectParameters>(NumClasses), TEXT("Uds.CompositeTileArgs"));
+	{
+		static const uint32 InitialArgs[] = { 0, 1, 1, 0, 1, 1, 0, 1, 1 };
+		static_assert(UE_ARRAY_COUNT(InitialArgs) == (uint32)EUdsCompositeTileClass::MAX * 3, "One set of dispatch args per tile class");
+		GraphBuilder.QueueBufferUpload(IndirectArgs, InitialArgs, sizeof(InitialArgs), ERDGInitialDataFlags::NoCopy);
+	}
+
+	FRDGBufferRef TileList = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), NumTiles * NumClasses), TEXT("Uds.CompositeTileList"));
+
+	FUdsCompositeTileParameters TileParameters;
+	TileParameters.RectMin = Rect.Min;
+	TileParameters.RectMax = Rect.Max;
+	TileParameters.TileListStride = NumTiles;
+
+	{
+		FUdsCompositeClassifyCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsCompositeClassifyCS::FParameters>();
+		SetCompositeParameters(PassParameters->Composite);
+		PassParameters->Tiles = TileParameters;
+		PassParameters->RWTileIndirectArgs = GraphBuilder.CreateUAV(IndirectArgs, PF_R32_UINT);
+		PassParameters->RWTileList = GraphBuilder.CreateUAV(TileList, PF_R32_UINT);
+
+		TShaderMapRef<FUdsCompositeClassifyCS> ComputeShader(View.ShaderMap, GetCompositePermutation(*Data));
+
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Classify %dx%d tiles", TileCount.X, TileCount.Y), ComputeShader, PassParameters, FIntVector(TileCount.X, TileCount.Y, 1));
+	}
+
+	FRDGBufferSRVRef TileListSRV = GraphBuilder.CreateSRV(TileList, PF_R32_UINT);
+	FRDGTextureUAVRef OutputUAV = GraphBuilder.CreateUAV(Output.Texture);
+
+	for (uint32 ClassIndex = 0; ClassIndex < NumClasses; ++ClassIndex)
+	{
+		const EUdsCompositeTileClass TileClass = (EUdsCompositeTileClass)ClassIndex;
+
+		// Nothing to do for scene tiles when the output already holds the scene
+		if (TileClass == EUdsCompositeTileClass::Scene && bSceneTilesInOutput)
+			continue;
+
+		FUdsCompositeApplyCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsCompositeApplyCS::FParameters>();
+		SetCompositeParameters(PassParameters->Composite);
+		PassParameters->Tiles = TileParameters;
+		PassParameters->TileListOffset = ClassIndex * NumTiles;
+		PassParameters->TileList = TileListSRV;
+		PassParameters->OutputTexture = OutputUAV;
+		PassParameters->IndirectArgs = IndirectArgs;
+
+		FUdsCompositeApplyCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FUdsCompositeDomain>(GetCompositePermutation(*Data));
+		PermutationVector.Set<FUdsCompositeApplyCS::FTileClassDim>(TileClass);
+		TShaderMapRef<FUdsCompositeApplyCS> ComputeShader(View.ShaderMap, FUdsCompositeApplyCS::RemapPermutation(PermutationVector));
+
+		static const TCHAR* const ClassNames[] = { TEXT("Scene"), TEXT("Ud"), TEXT("Mixed") };
+
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Apply %s tiles", ClassNames[ClassIndex]), ComputeShader, PassParameters,
+			IndirectArgs, ClassIndex * sizeof(FRHIDispatchIndirectParameters));
+	}
+}
@@ -10,4 +10,9 @@ public:
 	void PostProcess(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs) override;
 
 private:
+	void SetCompositeParameters(FCompositePassParameters& OutParameters) const;
+
+	// Tiled compute path, the pixel shader is the fallback when this returns false
+	bool CanUseTiledComposite(const FScreenPassRenderTarget& Output, const FIntRect& Rect) const;
+	void AddTiledComposite(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FScreenPassRenderTarget& Output, const FIntRect& Rect, bool bSceneTilesInOutput);
 };
\ No newline at end of file
@@ -5,11 +5,13 @@
 BEGIN_SHADER_PARAMETER_STRUCT(FCompositePassParameters, )
 	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, InputTexture)
 	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, DepthTexture)
-	SHADER_PARAMETER_TEXTURE(Texture2D, UdColorTexture)
-	SHADER_PARAMETER_TEXTURE(Texture2D, UdDepthTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdColorTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdDepthTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D<uint>, UdPackedTexture)
 	//SHADER_PARAMETER(UBMT_FLOAT32, ColorDepthRatio)
 	SHADER_PARAMETER(float, ColorDepthRatioX)
 	SHADER_PARAMETER(float, ColorDepthRatioY)
+	SHADER_PARAMETER(FVector2f, UdScale)
 
 
 
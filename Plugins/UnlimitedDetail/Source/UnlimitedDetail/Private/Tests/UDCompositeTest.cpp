@@ -0,0 +1,114 @@
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Engine/Engine.h"
+#include "Engine/GameViewportClient.h"
+#include "UnrealClient.h"
+#include "UDSubsystem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Frames rendered before counting starts, every view gets its composite state and the main target its size in them
+#define UDS_TEST_WARMUP_FRAMES 30
+
+// Frames rendered while counting
+#define UDS_TEST_FRAMES 300
+
+struct FUdsAllocationCounts
+{
+	uint32 Composite = 0;
+	uint32 ViewRecreations = 0;
+	FIntPoint ViewportSize = FIntPoint::ZeroValue;
+};
+
+static FUdsAllocationCounts GetUdsAllocationCounts()
+{
+	FUdsAllocationCounts Counts;
+
+	if (UUDSubsystem* Subsystem = GEngine ? GEngine->GetEngineSubsystem<UUDSubsystem>() : nullptr)
+	{
+		Counts.Composite = Subsystem->GetNumCompositeAllocations();
+		Counts.ViewRecreations = Subsystem->GetNumViewRecreations();
+	}
+
+	if (GEngine && GEngine->GameViewport && GEngine->GameViewport->Viewport)
+	{
+		Counts.ViewportSize = GEngine->GameViewport->Viewport->GetSizeXY();
+	}
+
+	return Counts;
+}
+
+// Done once Frames more frames have been rendered
+class FUdsWaitFramesCommand : public IAutomationLatentCommand
+{
+public:
+	FUdsWaitFramesCommand(uint64 InFrames) : Frames(InFrames) {}
+
+	bool Update() override
+	{
+		if (!bStarted)
+		{
+			StartFrame = GFrameCounter;
+			bStarted = true;
+		}
+		return GFrameCounter - StartFrame >= Frames;
+	}
+
+private:
+	uint64 Frames;
+	uint64 StartFrame = 0;
+	bool bStarted = false;
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FUdsCompositeSteadyStateTest, "UnlimitedDetail.Composite.SteadyStateAllocations",
+	EAutomationTestFlags::ClientContext | EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+// Renders the game viewport for a while at the size it has and expects nothing on the UD path to be allocated again once warmed up:
+// no composite subpasses or view states and no recreation of the main target and its textures and buffers
+bool FUdsCompositeSteadyStateTest::RunTest(const FString& Parameters)
+{
+	UUDSubsystem* Subsystem = GEngine ? GEngine->GetEngineSubsystem<UUDSubsystem>() : nullptr;
+	if (!TestNotNull(TEXT("UD subsystem"), Subsystem))
+	{
+		return false;
+	}
+
+	if (!GEngine->GameViewport || !GEngine->GameViewport->Viewport)
+	{
+		AddError(TEXT("Needs a game viewport to render, run it in a game or PIE session"));
+		return false;
+	}
+
+	if (!Subsystem->HasSession())
+	{
+		AddWarning(TEXT("No udSDK session, only the composite state is covered"));
+	}
+
+	TSharedRef<FUdsAllocationCounts> Before = MakeShared<FUdsAllocationCounts>();
+
+	ADD_LATENT_AUTOMATION_COMMAND(FUdsWaitFramesCommand(UDS_TEST_WARMUP_FRAMES));
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([Before]()
+	{
+		*Before = GetUdsAllocationCounts();
+		return true;
+	}));
+	ADD_LATENT_AUTOMATION_COMMAND(FUdsWaitFramesCommand(UDS_TEST_FRAMES));
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Before]()
+	{
+		const FUdsAllocationCounts After = GetUdsAllocationCounts();
+		if (After.ViewportSize != Before->ViewportSize)
+		{
+			AddError(FString::Printf(TEXT("The viewport was resized from %dx%d to %dx%d during the test"),
+				Before->ViewportSize.X, Before->ViewportSize.Y, After.ViewportSize.X, After.ViewportSize.Y));
+			return true;
+		}
+
+		TestEqual(TEXT("Composite subpasses and view states allocated after warm up"), After.Composite - Before->Composite, 0u);
+		TestEqual(TEXT("Main target recreations after warm up"), After.ViewRecreations - Before->ViewRecreations, 0u);
+		return true;
+	}));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,111 @@
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "UDReprojection.h"
+#include "UDTemporal.h"
+#include "UDTextureUploader.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// UE's world to view transform: x forward, y right, z up becomes x right, y up, z forward
+static FMatrix MakeUdsTestViewMatrix(const FVector& Location, const FRotator& Rotation)
+{
+	return FTranslationMatrix(-Location) * FInverseRotationMatrix(Rotation) * FMatrix(
+		FPlane(0, 0, 1, 0),
+		FPlane(1, 0, 0, 0),
+		FPlane(0, 1, 0, 0),
+		FPlane(0, 0, 0, 1));
+}
+
+// Reversed Z device depth of pixel i of the uploaded planes, as DecodeUdPixelDeviceZ in Uds_Common.ush reads it
+static float DecodeUdsTestDeviceZ(EUDOutputFormat Format, const uint8* const* ppPlanes, int32 i)
+{
+	FFloat16 Half;
+	switch (Format)
+	{
+	case EUDOutputFormat::Depth16:
+		Half.Encoded = reinterpret_cast<const uint16*>(ppPlanes[1])[i];
+		return Half.GetFloat();
+	case EUDOutputFormat::Packed:
+		Half.Encoded = (uint16)(reinterpret_cast<const uint32*>(ppPlanes[0])[i] >> 16);
+		return Half.GetFloat();
+	default:
+		return 1.0f - reinterpret_cast<const float*>(ppPlanes[1])[i];
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FUdsReprojectionDecodeTest, "UnlimitedDetail.Reprojection.DecodedDepth",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+// Points udSDK renders for one camera, stored in each output format and decoded the way the shaders do, reproject through
+// SourceClipToClip to where the moved camera sees them. Catches the stored depth, its decode and the reprojection matrices
+// disagreeing on the Z convention, and far depths decoding as empty.
+bool FUdsReprojectionDecodeTest::RunTest(const FString& Parameters)
+{
+	const float NearPlane = 10.0f;
+	const float HalfFOV = FMath::DegreesToRadians(45.0f);
+	const FMatrix Projection = FReversedZPerspectiveMatrix(HalfFOV, HalfFOV, 1.0f, 1920.0f / 1080.0f, NearPlane, NearPlane);
+
+	const FMatrix SourceView = MakeUdsTestViewMatrix(FVector(0.0, 0.0, 200.0), FRotator::ZeroRotator);
+	const FMatrix View = MakeUdsTestViewMatrix(FVector(150.0, -80.0, 230.0), FRotator(-2.0, 5.0, 0.0));
+
+	const FMatrix UdSDKViewProjection = SourceView * GetUdsForwardZProjection(Projection);
+	const FMatrix SourceClipToClip = GetUdsReprojectionClipToClip(SourceView * Projection, View * Projection);
+	const FMatrix ViewProjection = View * Projection;
+
+	// The last is 25km out, where 16 bit unorm reversed Z rounded to empty; it is only checked for surviving the format
+	const FVector Points[] = { FVector(500.0, 30.0, 180.0), FVector(3000.0, -400.0, 600.0), FVector(12000.0, 900.0, -300.0), FVector(40000.0, 2500.0, -1000.0), FVector(2500000.0, 10000.0, 0.0) };
+	const int32 NumPoints = UE_ARRAY_COUNT(Points);
+	const int32 NumChecked = NumPoints - 1;
+
+	// What udSDK writes for each point, forward Z
+	TArray<FVector2D> SourceNDC;
+	TArray<float> Depth;
+	TArray<FColor> Color;
+	for (const FVector& Point : Points)
+	{
+		const FVector4 Clip = UdSDKViewProjection.TransformFVector4(FVector4(Point, 1.0));
+		SourceNDC.Add(FVector2D(Clip.X / Clip.W, Clip.Y / Clip.W));
+		Depth.Add(Clip.Z / Clip.W);
+		Color.Add(FColor::White);
+	}
+
+	for (int32 f = 0; f < (int32)EUDOutputFormat::MAX; ++f)
+	{
+		const EUDOutputFormat Format = (EUDOutputFormat)f;
+
+		TArray<uint32> Scratch[UDS_MAX_OUTPUT_PLANES];
+		uint8* ScratchPlanes[UDS_MAX_OUTPUT_PLANES];
+		for (int32 p = 0; p < UDS_MAX_OUTPUT_PLANES; ++p)
+		{
+			Scratch[p].SetNumZeroed(NumPoints);
+			ScratchPlanes[p] = reinterpret_cast<uint8*>(Scratch[p].GetData());
+		}
+
+		const uint8* Planes[UDS_MAX_OUTPUT_PLANES] = {};
+		FUDTextureUploader::ConvertPlanes(Format, Color.GetData(), Depth.GetData(), NumPoints, ScratchPlanes, Planes);
+
+		for (int32 i = 0; i < NumPoints; ++i)
+		{
+			const float DeviceZ = DecodeUdsTestDeviceZ(Format, Planes, i);
+			const FString What = FString::Printf(TEXT("Format %d, point %d"), f, i);
+
+			if (!TestTrue(*(What + TEXT(" decodes as written")), DeviceZ > 0.0f) || i >= NumChecked)
+				continue;
+
+			const FVector4 Clip = SourceClipToClip.TransformFVector4(FVector4(SourceNDC[i].X, SourceNDC[i].Y, DeviceZ, 1.0));
+			const FVector4 Expected = ViewProjection.TransformFVector4(FVector4(Points[i], 1.0));
+			if (!TestTrue(*(What + TEXT(" is in front of the moved camera")), Clip.W > 0.0 && Expected.W > 0.0))
+				continue;
+
+			const FVector NDC(Clip.X / Clip.W, Clip.Y / Clip.W, Clip.Z / Clip.W);
+			const FVector ExpectedNDC(Expected.X / Expected.W, Expected.Y / Expected.W, Expected.Z / Expected.W);
+			TestNearlyEqual(*(What + TEXT(" x")), NDC.X, ExpectedNDC.X, 1e-3);
+			TestNearlyEqual(*(What + TEXT(" y")), NDC.Y, ExpectedNDC.Y, 1e-3);
+			TestNearlyEqual(*(What + TEXT(" device z")), NDC.Z, ExpectedNDC.Z, ExpectedNDC.Z * 2e-3);
+		}
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,791 @@
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "RenderingThread.h"
+#include "RHICommandList.h"
+#include "RenderGraphBuilder.h"
+#include "RenderCore.h"
+#include "Containers/Ticker.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Engine/Engine.h"
+#include "Engine/GameViewportClient.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/CameraComponent.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/GameInstance.h"
+#include "Engine/LocalPlayer.h"
+#include "UDSubsystem.h"
+#include "UDHZB.h"
+#include "UDTextureUploader.h"
+
+// Frames rendered after switching values before sampling starts, lets streaming, caches and GPU timing queries settle
+#define UDS_BENCHMARK_WARMUP_FRAMES 30
+
+// Console benchmarks for the UD render path, results are written to the log
+
+static const TCHAR* GetOutputFormatName(EUDOutputFormat Format)
+{
+	switch (Format)
+	{
+	case EUDOutputFormat::Full: return TEXT("Full (BGRA8 + R32F)");
+	case EUDOutputFormat::Depth16: return TEXT("Depth16 (BGRA8 + R16F)");
+	case EUDOutputFormat::Packed: return TEXT("Packed (R32 uint)");
+	default: return TEXT("Unknown");
+	}
+}
+
+// Stand-in for a UD render: a noisy point cloud over the middle half of the screen, clear values elsewhere
+static void FillSyntheticOutput(TArray<FColor>& Color, TArray<float>& Depth, int32 Width, int32 Height)
+{
+	Color.SetNumUninitialized(Width * Height);
+	Depth.SetNumUninitialized(Width * Height);
+
+	FRandomStream Random(Width ^ Height);
+
+	for (int32 y = 0; y < Height; ++y)
+	{
+		for (int32 x = 0; x < Width; ++x)
+		{
+			const int32 i = y * Width + x;
+			const bool bCovered = (x > Width / 4 && x < Width * 3 / 4 && y > Height / 4 && y < Height * 3 / 4);
+
+			Color[i] = bCovered ? FColor(Random.RandRange(0, 255), Random.RandRange(0, 255), Random.RandRange(0, 255), 0) : FColor(0, 0, 0, 255);
+			Depth[i] = bCovered ? Random.FRandRange(0.9f, 0.9999f) : 1.0f;
+		}
+	}
+}
+
+static void BenchmarkUpload(const TArray<FString>& Args)
+{
+	const int32 Iterations = FMath::Max((Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 20, 1);
+	const FIntPoint Resolutions[] = { FIntPoint(1920, 1080), FIntPoint(2560, 1440), FIntPoint(3840, 2160) };
+
+	TArray<FColor> Color;
+	TArray<float> Depth;
+
+	for (const FIntPoint& Resolution : Resolutions)
+	{
+		const int32 Width = Resolution.X;
+		const int32 Height = Resolution.Y;
+
+		FillSyntheticOutput(Color, Depth, Width, Height);
+
+		for (int32 FormatIndex = 0; FormatIndex < (int32)EUDOutputFormat::MAX; ++FormatIndex)
+		{
+			const EUDOutputFormat Format = (EUDOutputFormat)FormatIndex;
+			const int32 NumPlanes = FUDTextureUploader::GetNumPlanes(Format);
+
+			FTexture2DRHIRef Textures[UDS_MAX_OUTPUT_PLANES];
+			TArray<uint8> Scratch[UDS_MAX_OUTPUT_PLANES];
+			uint8* ppScratch[UDS_MAX_OUTPUT_PLANES] = {};
+			const uint8* ppPlanes[UDS_MAX_OUTPUT_PLANES] = {};
+			int32 BytesPerPixel[UDS_MAX_OUTPUT_PLANES] = {};
+			int64 FrameBytes = 0;
+
+			for (int32 p = 0; p < NumPlanes; ++p)
+			{
+				FRHITextureCreateDesc Desc = FRHITextureCreateDesc::Create2D(TEXT("UdsBenchmarkUpload"), Width, Height, FUDTextureUploader::GetPlanePixelFormat(Format, p));
+				Desc.SetFlags(FUDTextureUploader::GetTextureCreateFlags());
+				Textures[p] = RHICreateTexture(Desc);
+
+				BytesPerPixel[p] = FUDTextureUploader::GetBytesPerPixel(Format, p);
+				FrameBytes += (int64)Width * Height * BytesPerPixel[p];
+
+				if (FUDTextureUploader::IsPlaneConverted(Format, p))
+				{
+					Scratch[p].SetNumUninitialized(Width * Height * BytesPerPixel[p]);
+					ppScratch[p] = Scratch[p].GetData();
+				}
+			}
+
+			const double ConvertStart = FPlatformTime::Seconds();
+			for (int32 i = 0; i < Iterations; ++i)
+			{
+				FUDTextureUploader::ConvertPlanes(Format, Color.GetData(), Depth.GetData(), Width * Height, ppScratch, ppPlanes);
+			}
+			const double ConvertSeconds = (FPlatformTime::Seconds() - ConvertStart) / Iterations;
+
+			// Full-texture updates through the same RDG passes as the game, timed on the render thread including the RHI thread flush
+			FUDTextureUploadPtr Upload = MakeShared<FUDTextureUpload, ESPMode::ThreadSafe>();
+			Upload->Format = Format;
+			Upload->NumPlanes = NumPlanes;
+			Upload->Rects.Add(FIntRect(0, 0, Width, Height));
+			for (int32 p = 0; p < NumPlanes; ++p)
+			{
+				Upload->Textures[p] = Textures[p];
+				Upload->Data.Append(ppPlanes[p], Width * Height * BytesPerPixel[p]);
+				Upload->Data.AddZeroed(Align(Upload->Data.Num(), 4) - Upload->Data.Num());
+			}
+
+			double UploadSeconds = 0.0;
+			ENQUEUE_RENDER_COMMAND(UdsBenchmarkUpload)(
+				[&](FRHICommandListImmediate& RHICmdList)
+				{
+					const double UploadStart = FPlatformTime::Seconds();
+
+					for (int32 i = 0; i < Iterations; ++i)
+					{
+						FRDGBuilder GraphBuilder(RHICmdList);
+						FUDTextureUploader::AddUploadPasses(GraphBuilder, Upload);
+						GraphBuilder.Execute();
+					}
+					RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
+
+					UploadSeconds = (FPlatformTime::Seconds() - UploadStart) / Iterations;
+				});
+			FlushRenderingCommands();
+
+			UE_LOG(LogTemp, Display, TEXT("UnlimitedDetail | Benchmark | Upload %dx%d %-22s | %6.2f MB/frame | convert %7.3f ms | upload %7.3f ms"),
+				Width, Height, GetOutputFormatName(Format), FrameBytes / (1024.0 * 1024.0), ConvertSeconds * 1000.0, UploadSeconds * 1000.0);
+		}
+	}
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkUpload(
+	TEXT("Uds.Benchmark.Upload"),
+	TEXT("Times the conversion and full upload of each UD output format at 1080p, 1440p and 4K. Optional argument: iterations (default 20)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkUpload));
+
+// Deterministic camera path for benchmarks: from where the player is, flies forward and back while turning a full circle,
+// so every run sees the same sequence of views including disocclusions. Needs a possessed pawn (PIE or game).
+class FUdsFlythrough
+{
+public:
+	bool Begin(float InDistance)
+	{
+		UWorld* World = (GEngine && GEngine->GameViewport) ? GEngine->GameViewport->GetWorld() : nullptr;
+		APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+
+		if (!PlayerController || !PlayerController->GetPawn())
+			return false;
+
+		Controller = PlayerController;
+		StartLocation = PlayerController->GetPawn()->GetActorLocation();
+		StartRotation = PlayerController->GetControlRotation();
+		Distance = InDistance;
+		return true;
+	}
+
+	void Apply(float Alpha)
+	{
+		APlayerController* PlayerController = Controller.Get();
+		if (!PlayerController || !PlayerController->GetPawn())
+			return;
+
+		const FVector Location = StartLocation + StartRotation.Vector() * Distance * FMath::Sin(Alpha * PI);
+		PlayerController->GetPawn()->SetActorLocation(Location, false, nullptr, ETeleportType::TeleportPhysics);
+		PlayerController->SetControlRotation(StartRotation + FRotator(0.0, 360.0 * Alpha, 0.0));
+	}
+
+private:
+	TWeakObjectPtr<APlayerController> Controller;
+	FVector StartLocation;
+	FRotator StartRotation;
+	float Distance = 0.0f;
+};
+
+// Renders a number of frames for each value of a console variable and logs the average frame, game thread,
+// render thread, GPU and udSDK render times (summed over the frame's views) and culled primitives for each one. Keep the camera fixed (or play a looping sequence)
+// so every value sees the same frames. Per-pass GPU timings, e.g. BasePass, are in stat gpu while it runs.
+class FUdsFrameBenchmark
+{
+public:
+	static void Start(const FString& InCVarName, const TArray<FString>& InValues, int32 InFrames, TSharedPtr<FUdsFlythrough> InFlythrough = nullptr, TFunction<void()> InOnFinished = nullptr)
+	{
+		if (Active.IsValid() && Active->TickHandle.IsValid())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | %s is still running"), *Active->CVarName);
+			return;
+		}
+
+		IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(*InCVarName);
+		if (!CVar || InValues.Num() == 0)
+		{
+			UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | Benchmark | Unknown console variable or no values: %s"), *InCVarName);
+			return;
+		}
+
+		Active = MakeUnique<FUdsFrameBenchmark>();
+		Active->CVar = CVar;
+		Active->CVarName = InCVarName;
+		Active->OriginalValue = CVar->GetString();
+		Active->Values = InValues;
+		Active->Totals.SetNum(InValues.Num());
+		Active->Frames = FMath::Max(InFrames, 1);
+		Active->Flythrough = InFlythrough;
+		Active->OnFinished = MoveTemp(InOnFinished);
+		Active->SetValue(0);
+		SetUdsCountCulledPrimitives(true);
+		Active->TickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(Active.Get(), &FUdsFrameBenchmark::Tick));
+	}
+
+private:
+	struct FTotals
+	{
+		double FrameMs = 0.0;
+		double GameMs = 0.0;
+		double RenderMs = 0.0;
+		double GpuMs = 0.0;
+		double UdMs = 0.0;
+		double Primitives = 0.0;
+	};
+
+	void SetValue(int32 Index)
+	{
+		ValueIndex = Index;
+		Frame = -UDS_BENCHMARK_WARMUP_FRAMES;
+		CVar->Set(*Values[Index], ECVF_SetByConsole);
+
+		if (Flythrough.IsValid())
+		{
+			Flythrough->Apply(0.0f);
+		}
+	}
+
+	bool Tick(float DeltaTime)
+	{
+		// Positions the camera for the next frame; the path restarts with every value
+		if (Flythrough.IsValid())
+		{
+			Flythrough->Apply(FMath::Min((Frame + UDS_BENCHMARK_WARMUP_FRAMES + 1) / (float)(Frames + UDS_BENCHMARK_WARMUP_FRAMES), 1.0f));
+		}
+
+		if (Frame++ < 0)
+			return true;
+
+		const UUDSubsystem* Subsystem = GEngine ? GEngine->GetEngineSubsystem<UUDSubsystem>() : nullptr;
+
+		FTotals& Total = Totals[ValueIndex];
+		Total.FrameMs += DeltaTime * 1000.0;
+		Total.GameMs += FPlatformTime::ToMilliseconds(GGameThreadTime);
+		Total.RenderMs += FPlatformTime::ToMilliseconds(GRenderThreadTime);
+		Total.GpuMs += FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles(0));
+		Total.UdMs += Subsystem ? Subsystem->GetFrameRenderSeconds() * 1000.0 : 0.0;
+		Total.Primitives += GetUdsLastCulledPrimitives();
+
+		if (Frame < Frames)
+			return true;
+
+		if (ValueIndex + 1 < Values.Num())
+		{
+			SetValue(ValueIndex + 1);
+			return true;
+		}
+
+		CVar->Set(*OriginalValue, ECVF_SetByConsole);
+		SetUdsCountCulledPrimitives(false);
+
+		if (Flythrough.IsValid())
+		{
+			Flythrough->Apply(0.0f);
+		}
+
+		for (int32 i = 0; i < Values.Num(); ++i)
+		{
+			UE_LOG(LogTemp, Display, TEXT("UnlimitedDetail | Benchmark | %s %-6s | frame %7.3f ms | game %7.3f ms | render %7.3f ms | gpu %7.3f ms | ud %7.3f ms | culled primitives %8.1f"),
+				*CVarName, *Values[i], Totals[i].FrameMs / Frames, Totals[i].GameMs / Frames, Totals[i].RenderMs / Frames, Totals[i].GpuMs / Frames, Totals[i].UdMs / Frames, Totals[i].Primitives / Frames);
+		}
+
+		TickHandle.Reset();
+
+		// May start the next benchmark, which replaces this one
+		if (OnFinished)
+		{
+			TFunction<void()> Finished = MoveTemp(OnFinished);
+			Finished();
+		}
+		return false;
+	}
+
+	IConsoleVariable* CVar = nullptr;
+	FString CVarName;
+	FString OriginalValue;
+	TArray<FString> Values;
+	TArray<FTotals> Totals;
+	int32 Frames = 0;
+	int32 ValueIndex = 0;
+	int32 Frame = 0;
+	FTSTicker::FDelegateHandle TickHandle;
+	TSharedPtr<FUdsFlythrough> Flythrough;
+	TFunction<void()> OnFinished;
+
+	static TUniquePtr<FUdsFrameBenchmark> Active;
+};
+
+TUniquePtr<FUdsFrameBenchmark> FUdsFrameBenchmark::Active;
+
+static void BenchmarkFrames(const TArray<FString>& Args)
+{
+	if (Args.Num() < 3)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | Usage: Uds.Benchmark.Frames <cvar> <frames> <value> [value...]"));
+		return;
+	}
+
+	FUdsFrameBenchmark::Start(Args[0], TArray<FString>(Args.GetData() + 2, Args.Num() - 2), FCString::Atoi(*Args[1]));
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkFrames(
+	TEXT("Uds.Benchmark.Frames"),
+	TEXT("Averages frame, game, render, GPU and UD render times and culled primitives over a number of frames for each given value of a console variable. Arguments: <cvar> <frames> <value> [value...]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkFrames));
+
+static void BenchmarkDepthPrepass(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 300;
+	FUdsFrameBenchmark::Start(TEXT("r.Uds.DepthPrepass"), { TEXT("0"), TEXT("1"), TEXT("2") }, Frames);
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkDepthPrepass(
+	TEXT("Uds.Benchmark.DepthPrepass"),
+	TEXT("Compares frame and GPU cost with r.Uds.DepthPrepass 0, 1 and 2. Run it looking at scans with heavy mesh overdraw behind them, the difference is mostly base pass. Optional argument: frames per mode (default 300)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkDepthPrepass));
+
+static void BenchmarkHZB(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 300;
+	FUdsFrameBenchmark::Start(TEXT("r.Uds.HZB"), { TEXT("0"), TEXT("1") }, Frames);
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkHZB(
+	TEXT("Uds.Benchmark.HZB"),
+	TEXT("Compares frame and GPU cost and culled primitives with r.Uds.HZB off and on. Run it looking at scanned terrain with meshes behind it. Optional argument: frames per mode (default 300)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkHZB));
+
+static void BenchmarkOccluderDepth(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 600;
+	const float Distance = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 10000.0f;
+
+	TSharedPtr<FUdsFlythrough> Flythrough = MakeShared<FUdsFlythrough>();
+	if (!Flythrough->Begin(Distance))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | No player pawn to fly, benchmarking from a fixed camera"));
+		Flythrough.Reset();
+	}
+
+	FUdsFrameBenchmark::Start(TEXT("r.Uds.OccluderDepth"), { TEXT("0"), TEXT("1") }, Frames, Flythrough);
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkOccluderDepth(
+	TEXT("Uds.Benchmark.OccluderDepth"),
+	TEXT("Flies the player forward and back while turning a full circle with r.Uds.OccluderDepth off and on; the saving shows in the ud column. Start it inside or behind meshes that hide scans. Optional arguments: frames per mode (default 600), distance (default 10000)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkOccluderDepth));
+
+static void BenchmarkTemporal(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 300;
+	FUdsFrameBenchmark::Start(TEXT("r.ScreenPercentage"), { TEXT("50"), TEXT("75"), TEXT("100") }, Frames);
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkTemporal(
+	TEXT("Uds.Benchmark.Temporal"),
+	TEXT("Measures frame, GPU and UD render times at r.ScreenPercentage 50, 75 and 100. With r.Uds.Temporal 1 the ud column should follow the internal resolution, with 0 it stays flat. Optional argument: frames per value (default 300)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkTemporal));
+
+static void BenchmarkRenderRate(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 600;
+	const float Distance = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 10000.0f;
+
+	TSharedPtr<FUdsFlythrough> Flythrough = MakeShared<FUdsFlythrough>();
+	if (!Flythrough->Begin(Distance))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | No player pawn to fly, benchmarking from a fixed camera"));
+		Flythrough.Reset();
+	}
+
+	FUdsFrameBenchmark::Start(TEXT("r.Uds.RenderRate"), { TEXT("0"), TEXT("45"), TEXT("30") }, Frames, Flythrough);
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkRenderRate(
+	TEXT("Uds.Benchmark.RenderRate"),
+	TEXT("Flies the player with r.Uds.RenderRate 0 (every frame), 45 and 30. With a decoupled rate udSDK leaves the game thread, so the game and frame columns drop; the ud column is the time of one udSDK render and the reprojection cost is in gpu. Optional arguments: frames per value (default 600), distance (default 10000)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkRenderRate));
+
+static void BenchmarkCheckerboard(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 600;
+	const float Distance = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 10000.0f;
+
+	TSharedPtr<FUdsFlythrough> Flythrough = MakeShared<FUdsFlythrough>();
+	if (!Flythrough->Begin(Distance))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | No player pawn to fly, benchmarking from a fixed camera"));
+		Flythrough.Reset();
+	}
+
+	FUdsFrameBenchmark::Start(TEXT("r.Uds.Checkerboard"), { TEXT("0"), TEXT("1") }, Frames, Flythrough);
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkCheckerboard(
+	TEXT("Uds.Benchmark.Checkerboard"),
+	TEXT("Flies the player with r.Uds.Checkerboard off and on; the ud column should roughly halve, the reconstruction cost is in gpu. Optional arguments: frames per value (default 600), distance (default 10000)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkCheckerboard));
+
+// Flies the player with checkerboard rendering and a full resolution reference rendered alongside every frame,
+// then logs the PSNR of the reconstructed frames against their references
+class FUdsCheckerboardQualityBenchmark
+{
+public:
+	static void Start(int32 InFrames, TSharedPtr<FUdsFlythrough> InFlythrough)
+	{
+		if (Active.IsValid() && Active->TickHandle.IsValid())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | Checkerboard quality is still running"));
+			return;
+		}
+
+		IConsoleVariable* CheckerboardCVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.Uds.Checkerboard"));
+		IConsoleVariable* ReferenceCVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.Uds.Checkerboard.Reference"));
+		if (!CheckerboardCVar || !ReferenceCVar)
+			return;
+
+		Active = MakeUnique<FUdsCheckerboardQualityBenchmark>();
+		Active->CheckerboardCVar = CheckerboardCVar;
+		Active->ReferenceCVar = ReferenceCVar;
+		Active->OriginalCheckerboard = CheckerboardCVar->GetString();
+		Active->OriginalReference = ReferenceCVar->GetString();
+		Active->Frames = FMath::Max(InFrames, 1);
+		Active->Frame = -UDS_BENCHMARK_WARMUP_FRAMES;
+		Active->Flythrough = InFlythrough;
+
+		CheckerboardCVar->Set(TEXT("1"), ECVF_SetByConsole);
+		ReferenceCVar->Set(TEXT("1"), ECVF_SetByConsole);
+		Active->TickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(Active.Get(), &FUdsCheckerboardQualityBenchmark::Tick));
+	}
+
+private:
+	static FUDCheckerboardQuality ConsumeQuality()
+	{
+		UUDSubsystem* Subsystem = GEngine ? GEngine->GetEngineSubsystem<UUDSubsystem>() : nullptr;
+		return Subsystem ? Subsystem->ConsumeCheckerboardQuality() : FUDCheckerboardQuality();
+	}
+
+	bool Tick(float DeltaTime)
+	{
+		if (Flythrough.IsValid())
+		{
+			Flythrough->Apply(FMath::Min((Frame + UDS_BENCHMARK_WARMUP_FRAMES + 1) / (float)(Frames + UDS_BENCHMARK_WARMUP_FRAMES), 1.0f));
+		}
+
+		// Drops the scores of warm up frames, readbacks land a few frames late so the last ones are missed instead
+		if (Frame++ <= 0)
+		{
+			ConsumeQuality();
+			return true;
+		}
+
+		if (Frame < Frames)
+			return true;
+
+		CheckerboardCVar->Set(*OriginalCheckerboard, ECVF_SetByConsole);
+		ReferenceCVar->Set(*OriginalReference, ECVF_SetByConsole);
+
+		if (Flythrough.IsValid())
+		{
+			Flythrough->Apply(0.0f);
+		}
+
+		const FUDCheckerboardQuality Quality = ConsumeQuality();
+		if (Quality.NumFrames > 0)
+		{
+			UE_LOG(LogTemp, Display, TEXT("UnlimitedDetail | Benchmark | r.Uds.Checkerboard | %d frames scored | PSNR mean %6.2f dB | min %6.2f dB"),
+				Quality.NumFrames, Quality.PSNRSum / Quality.NumFrames, Quality.MinPSNR);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | r.Uds.Checkerboard | No frames scored, is r.Uds.RenderRate or r.Uds.Temporal on?"));
+		}
+
+		TickHandle.Reset();
+		return false;
+	}
+
+	IConsoleVariable* CheckerboardCVar = nullptr;
+	IConsoleVariable* ReferenceCVar = nullptr;
+	FString OriginalCheckerboard;
+	FString OriginalReference;
+	int32 Frames = 0;
+	int32 Frame = 0;
+	FTSTicker::FDelegateHandle TickHandle;
+	TSharedPtr<FUdsFlythrough> Flythrough;
+
+	static TUniquePtr<FUdsCheckerboardQualityBenchmark> Active;
+};
+
+TUniquePtr<FUdsCheckerboardQualityBenchmark> FUdsCheckerboardQualityBenchmark::Active;
+
+static void BenchmarkCheckerboardQuality(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 600;
+	const float Distance = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 10000.0f;
+
+	TSharedPtr<FUdsFlythrough> Flythrough = MakeShared<FUdsFlythrough>();
+	if (!Flythrough->Begin(Distance))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | No player pawn to fly, benchmarking from a fixed camera"));
+		Flythrough.Reset();
+	}
+
+	FUdsCheckerboardQualityBenchmark::Start(Frames, Flythrough);
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkCheckerboardQuality(
+	TEXT("Uds.Benchmark.CheckerboardQuality"),
+	TEXT("Flies the player with r.Uds.Checkerboard on, rendering a full resolution reference every frame, and logs the mean and worst PSNR of the reconstruction against it. Frame times are meaningless while it runs. Optional arguments: frames (default 600), distance (default 10000)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkCheckerboardQuality));
+
+static void BenchmarkFoveated(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 600;
+	const float Distance = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 10000.0f;
+
+	TSharedPtr<FUdsFlythrough> Flythrough = MakeShared<FUdsFlythrough>();
+	if (!Flythrough->Begin(Distance))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | No player pawn to fly, benchmarking from a fixed camera"));
+		Flythrough.Reset();
+	}
+
+	// 2 foveates every view, so it also runs without a headset
+	FUdsFrameBenchmark::Start(TEXT("r.Uds.Foveated"), { TEXT("0"), TEXT("2") }, Frames, Flythrough);
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkFoveated(
+	TEXT("Uds.Benchmark.Foveated"),
+	TEXT("Flies the player with r.Uds.Foveated off and on for every view; the ud column is both foveated renders, the CPU composite is in stat UnlimitedDetail. Optional arguments: frames per value (default 600), distance (default 10000)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkFoveated));
+
+static void BenchmarkStereo(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 600;
+	const float Distance = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 10000.0f;
+
+	TSharedPtr<FUdsFlythrough> Flythrough = MakeShared<FUdsFlythrough>();
+	if (!Flythrough->Begin(Distance))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | No player pawn to fly, benchmarking from a fixed camera"));
+		Flythrough.Reset();
+	}
+
+	FUdsFrameBenchmark::Start(TEXT("r.Uds.Stereo"), { TEXT("0"), TEXT("1"), TEXT("2") }, Frames, Flythrough);
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkStereo(
+	TEXT("Uds.Benchmark.Stereo"),
+	TEXT("Flies the player with r.Uds.Stereo 0 (two independent renders), 1 and 2 (second eye reuses the traversal); the ud column is both eyes together. Needs a stereo device or -emulatestereo. Optional arguments: frames per value (default 600), distance (default 10000)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkStereo));
+
+static void BenchmarkTiles(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 600;
+	const float Distance = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 10000.0f;
+
+	TSharedPtr<FUdsFlythrough> Flythrough = MakeShared<FUdsFlythrough>();
+	if (!Flythrough->Begin(Distance))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | No player pawn to fly, benchmarking from a fixed camera"));
+		Flythrough.Reset();
+	}
+
+	// Doubling up to one tile per worker plus the game thread's, and that count itself when it isn't a power of two
+	const int32 MaxTiles = FMath::Min(FTaskGraphInterface::Get().GetNumWorkerThreads() + 1, 64);
+	TArray<FString> Values;
+	for (int32 NumTiles = 1; NumTiles <= MaxTiles; NumTiles *= 2)
+	{
+		Values.Add(FString::FromInt(NumTiles));
+	}
+	if (!FMath::IsPowerOfTwo(MaxTiles))
+	{
+		Values.Add(FString::FromInt(MaxTiles));
+	}
+
+	FUdsFrameBenchmark::Start(TEXT("r.Uds.Tiles"), Values, Frames, Flythrough);
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkTiles(
+	TEXT("Uds.Benchmark.Tiles"),
+	TEXT("Flies the player with r.Uds.Tiles doubling from 1 to one tile per core; the ud column is the render's wall time, pick the count where it stops falling.\n")
+	TEXT("Tile Imbalance in stat UnlimitedDetail shows how much of it is the slowest tile. Optional arguments: frames per value (default 600), distance (default 10000)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkTiles));
+
+// Lifts the player Height above where it stands, looking straight down, and switches its camera between perspective and
+// orthographic; End puts everything back. Uses the pawn's camera component when it has one, the camera manager's defaults otherwise.
+class FUdsTopDownCamera
+{
+public:
+	bool Begin(float Height, float InOrthoWidth)
+	{
+		UWorld* World = (GEngine && GEngine->GameViewport) ? GEngine->GameViewport->GetWorld() : nullptr;
+		APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+		APawn* Pawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+
+		if (!Pawn)
+			return false;
+
+		Controller = PlayerController;
+		Camera = Pawn->FindComponentByClass<UCameraComponent>();
+		StartLocation = Pawn->GetActorLocation();
+		StartRotation = PlayerController->GetControlRotation();
+		OrthoWidth = InOrthoWidth;
+
+		if (Camera.IsValid())
+		{
+			bStartOrthographic = Camera->ProjectionMode == ECameraProjectionMode::Orthographic;
+			StartOrthoWidth = Camera->OrthoWidth;
+		}
+		else if (PlayerController->PlayerCameraManager)
+		{
+			bStartOrthographic = PlayerController->PlayerCameraManager->bIsOrthographic;
+			StartOrthoWidth = PlayerController->PlayerCameraManager->DefaultOrthoWidth;
+		}
+
+		Pawn->SetActorLocation(StartLocation + FVector(0.0, 0.0, Height), false, nullptr, ETeleportType::TeleportPhysics);
+		PlayerController->SetControlRotation(FRotator(-90.0, StartRotation.Yaw, 0.0));
+		return true;
+	}
+
+	void SetOrthographic(bool bOrthographic, float Width)
+	{
+		if (UCameraComponent* CameraComponent = Camera.Get())
+		{
+			CameraComponent->SetProjectionMode(bOrthographic ? ECameraProjectionMode::Orthographic : ECameraProjectionMode::Perspective);
+			CameraComponent->SetOrthoWidth(Width);
+		}
+		else if (APlayerController* PlayerController = Controller.Get())
+		{
+			if (PlayerController->PlayerCameraManager)
+			{
+				PlayerController->PlayerCameraManager->bIsOrthographic = bOrthographic;
+				PlayerController->PlayerCameraManager->DefaultOrthoWidth = Width;
+			}
+		}
+	}
+
+	void SetOrthographic(bool bOrthographic)
+	{
+		SetOrthographic(bOrthographic, OrthoWidth);
+	}
+
+	void End()
+	{
+		SetOrthographic(bStartOrthographic, StartOrthoWidth);
+
+		APlayerController* PlayerController = Controller.Get();
+		if (PlayerController && PlayerController->GetPawn())
+		{
+			PlayerController->GetPawn()->SetActorLocation(StartLocation, false, nullptr, ETeleportType::TeleportPhysics);
+			PlayerController->SetControlRotation(StartRotation);
+		}
+	}
+
+private:
+	TWeakObjectPtr<APlayerController> Controller;
+	TWeakObjectPtr<UCameraComponent> Camera;
+	FVector StartLocation;
+	FRotator StartRotation;
+	float OrthoWidth = 0.0f;
+	bool bStartOrthographic = false;
+	float StartOrthoWidth = 0.0f;
+};
+
+static void BenchmarkOrtho(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 300;
+	const float Height = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 50000.0f;
+
+	// What a 90 degree perspective camera sees of the ground from that height
+	const float OrthoWidth = (Args.Num() > 2) ? FCString::Atof(*Args[2]) : 2.0f * Height;
+
+	TSharedPtr<FUdsTopDownCamera> Camera = MakeShared<FUdsTopDownCamera>();
+	if (!Camera->Begin(Height, OrthoWidth))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | Needs a player pawn to lift above the site (PIE or game)"));
+		return;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("UnlimitedDetail | Benchmark | Top-down perspective, %.0f above the player"), Height);
+	Camera->SetOrthographic(false);
+	FUdsFrameBenchmark::Start(TEXT("r.Uds.Ortho.FastPath"), { TEXT("1") }, Frames, nullptr, [Camera, Frames, OrthoWidth]()
+	{
+		UE_LOG(LogTemp, Display, TEXT("UnlimitedDetail | Benchmark | Top-down orthographic, %.0f wide, fast path on then off"), OrthoWidth);
+		Camera->SetOrthographic(true);
+		FUdsFrameBenchmark::Start(TEXT("r.Uds.Ortho.FastPath"), { TEXT("1"), TEXT("0") }, Frames, nullptr, [Camera]()
+		{
+			Camera->End();
+		});
+	});
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkOrtho(
+	TEXT("Uds.Benchmark.Ortho"),
+	TEXT("Lifts the player above the site looking straight down and measures a perspective camera, then an orthographic one with udSDK's\n")
+	TEXT("orthographic mode (r.Uds.Ortho.FastPath 1) and without it (0). Compare the ud columns. Optional arguments: frames per run (default 300),\n")
+	TEXT("height (default 50000), ortho width (default twice the height, the ground a 90 degree perspective camera sees)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkOrtho));
+
+// Split-screen views for the parallel view benchmark: adds or removes local players until there are NumPlayers
+static bool SetBenchmarkLocalPlayers(int32 NumPlayers)
+{
+	UWorld* World = (GEngine && GEngine->GameViewport) ? GEngine->GameViewport->GetWorld() : nullptr;
+	UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+	if (!GameInstance)
+		return false;
+
+	while (GameInstance->GetNumLocalPlayers() < NumPlayers)
+	{
+		FString Error;
+		if (!GameInstance->CreateLocalPlayer(-1, Error, true))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | Can't add a split-screen player: %s"), *Error);
+			return false;
+		}
+	}
+
+	while (GameInstance->GetNumLocalPlayers() > FMath::Max(NumPlayers, 1))
+	{
+		GameInstance->RemoveLocalPlayer(GameInstance->GetLocalPlayerByIndex(GameInstance->GetNumLocalPlayers() - 1));
+	}
+
+	return true;
+}
+
+static void BenchmarkParallelViewsStep(int32 NumViews, int32 MaxViews, int32 Frames, int32 OriginalPlayers)
+{
+	if (NumViews > MaxViews || !SetBenchmarkLocalPlayers(NumViews))
+	{
+		SetBenchmarkLocalPlayers(OriginalPlayers);
+		return;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("UnlimitedDetail | Benchmark | %d view(s)"), NumViews);
+	FUdsFrameBenchmark::Start(TEXT("r.Uds.ParallelViews"), { TEXT("0"), TEXT("1"), TEXT("2"), TEXT("3") }, Frames, nullptr,
+		[NumViews, MaxViews, Frames, OriginalPlayers]()
+		{
+			BenchmarkParallelViewsStep(NumViews + 1, MaxViews, Frames, OriginalPlayers);
+		});
+}
+
+static void BenchmarkParallelViews(const TArray<FString>& Args)
+{
+	const int32 Frames = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 300;
+	const int32 MaxViews = FMath::Clamp((Args.Num() > 1) ? FCString::Atoi(*Args[1]) : 4, 1, 4);
+
+	UWorld* World = (GEngine && GEngine->GameViewport) ? GEngine->GameViewport->GetWorld() : nullptr;
+	UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+	if (!GameInstance)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Benchmark | Needs a game instance to add split-screen players to (PIE or game)"));
+		return;
+	}
+
+	BenchmarkParallelViewsStep(1, MaxViews, Frames, GameInstance->GetNumLocalPlayers());
+}
+
+static FAutoConsoleCommand CmdUdsBenchmarkParallelViews(
+	TEXT("Uds.Benchmark.ParallelViews"),
+	TEXT("Adds split-screen players for 1 up to 4 views and, for each view count, measures r.Uds.ParallelViews 0 (serial) and 1 to 3 workers. Watch the game column;\n")
+	TEXT("ud is udSDK time summed over the views, the parallel wall time is in stat UnlimitedDetail. Optional arguments: frames per value (default 300), most views (default 4)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkParallelViews));
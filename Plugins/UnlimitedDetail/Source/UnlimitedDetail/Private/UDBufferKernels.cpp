@@ -0,0 +1,570 @@
+#include "UDBufferKernels.h"
+
+namespace UDBufferKernels
+{
+	// Index of the first written pixel in [Begin, End), or End if there isn't one
+	static int32 FindFirstWritten(const float* pRow, int32 Begin, int32 End)
+	{
+		const VectorRegister4Float Clear = VectorSetFloat1(ClearDepth);
+
+		int32 x = Begin;
+		for (; x + 4 <= End; x += 4)
+		{
+			const int32 Mask = VectorMaskBits(VectorCompareLT(VectorLoad(pRow + x), Clear));
+			if (Mask != 0)
+				return x + FMath::CountTrailingZeros((uint32)Mask);
+		}
+
+		for (; x < End; ++x)
+		{
+			if (pRow[x] < ClearDepth)
+				return x;
+		}
+
+		return End;
+	}
+
+	// Index of the last written pixel in [Begin, End), or Begin - 1 if there isn't one
+	static int32 FindLastWritten(const float* pRow, int32 Begin, int32 End)
+	{
+		const VectorRegister4Float Clear = VectorSetFloat1(ClearDepth);
+
+		int32 x = End;
+		for (; x - 4 >= Begin; x -= 4)
+		{
+			const int32 Mask = VectorMaskBits(VectorCompareLT(VectorLoad(pRow + x - 4), Clear));
+			if (Mask != 0)
+				return x - 4 + (31 - (int32)FMath::CountLeadingZeros((uint32)Mask));
+		}
+
+		for (--x; x >= Begin; --x)
+		{
+			if (pRow[x] < ClearDepth)
+				return x;
+		}
+
+		return Begin - 1;
+	}
+
+	FUDCoverage ComputeCoverage(const float* pDepth, int32 Width, int32 Height)
+	{
+		FUDCoverage Coverage;
+
+		int32 MinX = Width;
+		int32 MaxX = -1;
+		int32 MinY = Height;
+		int32 MaxY = -1;
+
+		for (int32 y = 0; y < Height; ++y)
+		{
+			const float* pRow = pDepth + (SIZE_T)y * Width;
+
+			// Early outs at the first hit, so covered rows only pay for the pixels outside the current bounds
+			const int32 First = FindFirstWritten(pRow, 0, Width);
+			if (First == Width)
+				continue;
+
+			const int32 Last = FindLastWritten(pRow, FMath::Max(First, MaxX + 1), Width);
+
+			MinX = FMath::Min(MinX, First);
+			MaxX = FMath::Max(MaxX, FMath::Max(First, Last));
+			MinY = FMath::Min(MinY, y);
+			MaxY = y;
+		}
+
+		if (MaxY >= 0)
+		{
+			Coverage.bHasCoverage = true;
+			Coverage.Rect = FIntRect(MinX, MinY, MaxX + 1, MaxY + 1);
+		}
+
+		return Coverage;
+	}
+
+	// Bitwise compare, so NaNs and -0 in the depth buffer still count as changes
+	static bool SpanEqual(const uint8* pA, const uint8* pB, int32 NumBytes)
+	{
+		int32 i = 0;
+		for (; i + 16 <= NumBytes; i += 16)
+		{
+			const VectorRegister4Int Equal = VectorIntCompareEQ(VectorIntLoad(pA + i), VectorIntLoad(pB + i));
+			if (VectorMaskBits(VectorCastIntToFloat(Equal)) != 0xF)
+				return false;
+		}
+
+		return FMemory::Memcmp(pA + i, pB + i, NumBytes - i) == 0;
+	}
+
+	static bool TileEqual(const FDirtyPlane* pPlanes, int32 NumPlanes, int32 Width, const FIntRect& Tile)
+	{
+		for (int32 y = Tile.Min.Y; y < Tile.Max.Y; ++y)
+		{
+			for (int32 p = 0; p < NumPlanes; ++p)
+			{
+				const SIZE_T Offset = ((SIZE_T)y * Width + Tile.Min.X) * pPlanes[p].BytesPerPixel;
+				if (!SpanEqual(pPlanes[p].pData + Offset, pPlanes[p].pPrev + Offset, Tile.Width() * pPlanes[p].BytesPerPixel))
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	void ComputeDirtyRects(const FDirtyPlane* pPlanes, int32 NumPlanes, int32 Width, int32 Height, int32 TileSize, int32 MaxRects, TArray<FIntRect>& OutRects)
+	{
+		OutRects.Reset();
+
+		// Rects from the previous band that can still grow downwards
+		int32 FirstOpenRect = 0;
+
+		for (int32 TileY = 0; TileY < Height; TileY += TileSize)
+		{
+			const int32 BandHeight = FMath::Min(TileSize, Height - TileY);
+			const int32 BandFirstRect = OutRects.Num();
+
+			int32 RunStart = -1;
+
+			// One extra iteration past the last tile closes any open run
+			const int32 NumTilesX = FMath::DivideAndRoundUp(Width, TileSize);
+			for (int32 TileIndexX = 0; TileIndexX <= NumTilesX; ++TileIndexX)
+			{
+				const int32 TileX = TileIndexX * TileSize;
+				bool bDirty = false;
+
+				if (TileIndexX < NumTilesX)
+				{
+					const FIntRect Tile(TileX, TileY, FMath::Min(TileX + TileSize, Width), TileY + BandHeight);
+
+					bDirty = !TileEqual(pPlanes, NumPlanes, Width, Tile);
+					if (bDirty)
+					{
+						for (int32 p = 0; p < NumPlanes; ++p)
+						{
+							for (int32 y = Tile.Min.Y; y < Tile.Max.Y; ++y)
+							{
+								const SIZE_T Offset = ((SIZE_T)y * Width + Tile.Min.X) * pPlanes[p].BytesPerPixel;
+								FMemory::Memcpy(pPlanes[p].pPrev + Offset, pPlanes[p].pData + Offset, Tile.Width() * pPlanes[p].BytesPerPixel);
+							}
+						}
+
+						if (RunStart < 0)
+							RunStart = TileX;
+					}
+				}
+
+				if (!bDirty && RunStart >= 0)
+				{
+					const FIntRect Run(RunStart, TileY, FMath::Min(TileX, Width), TileY + BandHeight);
+					RunStart = -1;
+
+					// Extend a rect from the band above if it spans exactly the same columns
+					bool bMerged = false;
+					for (int32 i = FirstOpenRect; i < BandFirstRect; ++i)
+					{
+						FIntRect& Above = OutRects[i];
+						if (Above.Min.X == Run.Min.X && Above.Max.X == Run.Max.X && Above.Max.Y == Run.Min.Y)
+						{
+							Above.Max.Y = Run.Max.Y;
+							bMerged = true;
+							break;
+						}
+					}
+
+					if (!bMerged)
+						OutRects.Add(Run);
+				}
+			}
+
+			// Only rects that ended on this band can be extended by the next one
+			int32 NextOpen = OutRects.Num();
+			for (int32 i = FirstOpenRect; i < OutRects.Num(); ++i)
+			{
+				if (OutRects[i].Max.Y == TileY + BandHeight)
+				{
+					NextOpen = i;
+					break;
+				}
+			}
+			FirstOpenRect = NextOpen;
+		}
+
+		if (OutRects.Num() > MaxRects)
+		{
+			FIntRect Bounds = OutRects[0];
+			for (const FIntRect& Rect : OutRects)
+			{
+				Bounds.Union(Rect);
+			}
+
+			OutRects.Reset();
+			OutRects.Add(Bounds);
+		}
+	}
+
+	// 2^-24, the smallest nonzero half. Reversed Z is near / distance, so that's still a voxel with a 10cm near plane at well over 1000km.
+	static constexpr float MinHalfDepth = 5.96046448e-8f;
+
+	// Four depths to reversed Z halves. 0 is left to pixels udSDK didn't write; anything it did write keeps at least MinHalfDepth
+	// instead of rounding to 0 and reading as empty.
+	static FORCEINLINE void QuantizeDepth(const float* pDepth, uint16* pOut)
+	{
+		const VectorRegister4Float DeviceZ = VectorSubtract(VectorOneFloat(), VectorMin(VectorMax(VectorLoad(pDepth), VectorZeroFloat()), VectorOneFloat()));
+		const VectorRegister4Float Written = VectorCompareGT(DeviceZ, VectorZeroFloat());
+
+		alignas(16) float Clamped[4];
+		VectorStoreAligned(VectorSelect(Written, VectorMax(DeviceZ, VectorSetFloat1(MinHalfDepth)), VectorZeroFloat()), Clamped);
+		FPlatformMath::VectorStoreHalf(pOut, Clamped);
+	}
+
+	static FORCEINLINE uint16 QuantizeDepth(float Depth)
+	{
+		const float DeviceZ = 1.0f - FMath::Clamp(Depth, 0.0f, 1.0f);
+		return (DeviceZ > 0.0f) ? FFloat16(FMath::Max(DeviceZ, MinHalfDepth)).Encoded : 0;
+	}
+
+	static FORCEINLINE uint32 PackColor565(uint32 Color)
+	{
+		// FColor is 0xAARRGGBB as a little endian uint32
+		return ((Color >> 8) & 0xF800) | ((Color >> 5) & 0x07E0) | ((Color >> 3) & 0x001F);
+	}
+
+	void ConvertDepthToHalf(const float* pDepth, uint16* pOut, int32 Count)
+	{
+		int32 i = 0;
+		for (; i + 4 <= Count; i += 4)
+		{
+			QuantizeDepth(pDepth + i, pOut + i);
+		}
+
+		for (; i < Count; ++i)
+		{
+			pOut[i] = QuantizeDepth(pDepth[i]);
+		}
+	}
+
+	void PackColorDepth(const FColor* pColor, const float* pDepth, uint32* pOut, int32 Count)
+	{
+		const uint32* pColorBits = reinterpret_cast<const uint32*>(pColor);
+
+		const VectorRegister4Int RedMask = VectorIntSet1(0xF800);
+		const VectorRegister4Int GreenMask = VectorIntSet1(0x07E0);
+		const VectorRegister4Int BlueMask = VectorIntSet1(0x001F);
+
+		int32 i = 0;
+		for (; i + 4 <= Count; i += 4)
+		{
+			const VectorRegister4Int Color = VectorIntLoad(pColorBits + i);
+
+			VectorRegister4Int Packed = VectorIntAnd(VectorShiftRightImmLogical(Color, 8), RedMask);
+			Packed = VectorIntOr(Packed, VectorIntAnd(VectorShiftRightImmLogical(Color, 5), GreenMask));
+			Packed = VectorIntOr(Packed, VectorIntAnd(VectorShiftRightImmLogical(Color, 3), BlueMask));
+
+			uint16 Depth[4];
+			QuantizeDepth(pDepth + i, Depth);
+			Packed = VectorIntOr(Packed, VectorShiftLeftImm(MakeVectorRegisterInt(Depth[0], Depth[1], Depth[2], Depth[3]), 16));
+
+			VectorIntStore(Packed, pOut + i);
+		}
+
+		for (; i < Count; ++i)
+		{
+			pOut[i] = PackColor565(pColorBits[i]) | ((uint32)QuantizeDepth(pDepth[i]) << 16);
+		}
+	}
+
+	void ReprojectOccluderDepth(const FUDOccluderDepth& Occluders, const FMatrix& ViewProjection, float Bias, int32 Dilation, float* pOutDepth, int32 Width, int32 Height, TArray<float>& Scratch)
+	{
+		// Splat into a grid with one cell per occluder sample (at the current UD resolution), then expand it to pixels
+		const int32 CellX = FMath::DivideAndRoundUp(Width, FMath::Max(Occluders.Size.X, 1));
+		const int32 CellY = FMath::DivideAndRoundUp(Height, FMath::Max(Occluders.Size.Y, 1));
+		const int32 GridX = FMath::DivideAndRoundUp(Width, CellX);
+		const int32 GridY = FMath::DivideAndRoundUp(Height, CellY);
+		const int32 NumCells = GridX * GridY;
+
+		Scratch.SetNumUninitialized(NumCells * 2);
+		float* pGrid = Scratch.GetData();
+		float* pTemp = pGrid + NumCells;
+
+		// Cells no sample lands in stay empty
+		for (int32 i = 0; i < NumCells; ++i)
+		{
+			pGrid[i] = ClearDepth;
+		}
+
+		const FVector2D BlockSize(Occluders.ViewRect.Width() / (double)Occluders.Size.X, Occluders.ViewRect.Height() / (double)Occluders.Size.Y);
+		const FVector2D InvViewSize(1.0 / Occluders.ViewRect.Width(), 1.0 / Occluders.ViewRect.Height());
+
+		for (int32 y = 0; y < Occluders.Size.Y; ++y)
+		{
+			for (int32 x = 0; x < Occluders.Size.X; ++x)
+			{
+				const float DeviceZ = Occluders.DeviceZ[y * Occluders.Size.X + x];
+
+				// Sky
+				if (DeviceZ <= 0.0f)
+					continue;
+
+				const double NdcX = (x + 0.5) * BlockSize.X * InvViewSize.X * 2.0 - 1.0;
+				const double NdcY = 1.0 - (y + 0.5) * BlockSize.Y * InvViewSize.Y * 2.0;
+
+				// W of the unprojected position is 1 / the distance the sample was seen at
+				const FVector4 World = Occluders.InvViewProjection.TransformFVector4(FVector4(NdcX, NdcY, DeviceZ, 1.0));
+				if (World.W <= 0.0)
+					continue;
+
+				const FVector4 Clip = ViewProjection.TransformFVector4(FVector4(World.X / World.W, World.Y / World.W, World.Z / World.W, 1.0));
+				if (Clip.W <= UE_KINDA_SMALL_NUMBER)
+					continue;
+
+				// UD depth for the UD projection is 1 - near / distance, the bias scales the distance
+				const float UdDepth = 1.0f - (1.0f - (float)(Clip.Z / Clip.W)) / (1.0f + Bias);
+				if (UdDepth <= 0.0f || UdDepth >= ClearDepth)
+					continue;
+
+				const double PixelX = (Clip.X / Clip.W * 0.5 + 0.5) * Width;
+				const double PixelY = (0.5 - Clip.Y / Clip.W * 0.5) * Height;
+
+				// Surfaces that came closer cover more cells, splat a footprint so they don't break up into holes
+				const double PrevDistance = 1.0 / World.W;
+				const int32 Footprint = FMath::Clamp(FMath::CeilToInt(PrevDistance / Clip.W), 1, 4);
+
+				const int32 MinX = FMath::FloorToInt(PixelX / CellX) - (Footprint - 1) / 2;
+				const int32 MinY = FMath::FloorToInt(PixelY / CellY) - (Footprint - 1) / 2;
+
+				for (int32 cy = FMath::Max(MinY, 0); cy < FMath::Min(MinY + Footprint, GridY); ++cy)
+				{
+					for (int32 cx = FMath::Max(MinX, 0); cx < FMath::Min(MinX + Footprint, GridX); ++cx)
+					{
+						// Where samples overlap keep the furthest, the conservative choice
+						float& Cell = pGrid[cy * GridX + cx];
+						Cell = (Cell == ClearDepth) ? UdDepth : FMath::Max(Cell, UdDepth);
+					}
+				}
+			}
+		}
+
+		// Separable max filter, empty cells are the furthest value there is so edges and holes erode
+		if (Dilation > 0)
+		{
+			for (int32 cy = 0; cy < GridY; ++cy)
+			{
+				for (int32 cx = 0; cx < GridX; ++cx)
+				{
+					float Furthest = 0.0f;
+					for (int32 i = FMath::Max(cx - Dilation, 0); i <= FMath::Min(cx + Dilation, GridX - 1); ++i)
+					{
+						Furthest = FMath::Max(Furthest, pGrid[cy * GridX + i]);
+					}
+					pTemp[cy * GridX + cx] = Furthest;
+				}
+			}
+
+			for (int32 cy = 0; cy < GridY; ++cy)
+			{
+				for (int32 cx = 0; cx < GridX; ++cx)
+				{
+					float Furthest = 0.0f;
+					for (int32 i = FMath::Max(cy - Dilation, 0); i <= FMath::Min(cy + Dilation, GridY - 1); ++i)
+					{
+						Furthest = FMath::Max(Furthest, pTemp[i * GridX + cx]);
+					}
+					pGrid[cy * GridX + cx] = Furthest;
+				}
+			}
+		}
+
+		for (int32 y = 0; y < Height; ++y)
+		{
+			const float* pGridRow = pGrid + (y / CellY) * GridX;
+			float* pRow = pOutDepth + (SIZE_T)y * Width;
+
+			for (int32 x = 0; x < Width; ++x)
+			{
+				pRow[x] = pGridRow[x / CellX];
+			}
+		}
+	}
+
+	void ResetUnwrittenDepth(const FColor* pColor, float* pDepth, int32 Count)
+	{
+		const uint32* pColorBits = reinterpret_cast<const uint32*>(pColor);
+
+		const VectorRegister4Int AlphaMask = VectorIntSet1(0xFF000000);
+		const VectorRegister4Float Clear = VectorSetFloat1(ClearDepth);
+
+		int32 i = 0;
+		for (; i + 4 <= Count; i += 4)
+		{
+			const VectorRegister4Int Alpha = VectorIntAnd(VectorIntLoad(pColorBits + i), AlphaMask);
+			const VectorRegister4Float Unwritten = VectorCastIntToFloat(VectorIntCompareEQ(Alpha, AlphaMask));
+
+			VectorStore(VectorSelect(Unwritten, Clear, VectorLoad(pDepth + i)), pDepth + i);
+		}
+
+		for (; i < Count; ++i)
+		{
+			if ((pColorBits[i] & 0xFF000000) == 0xFF000000)
+			{
+				pDepth[i] = ClearDepth;
+			}
+		}
+	}
+
+	void InterleaveCheckerboard(const FColor* pHalfColor, const float* pHalfDepth, int32 HalfWidth, int32 HalfHeight, int32 Column, int32 Row, FColor* pColor, float* pDepth, int32 Width)
+	{
+		for (int32 y = 0; y < HalfHeight; ++y)
+		{
+			const int32 Source = y * HalfWidth;
+			const int32 Target = (2 * y + Row) * Width + Column;
+
+			for (int32 x = 0; x < HalfWidth; ++x)
+			{
+				pColor[Target + 2 * x] = pHalfColor[Source + x];
+				pDepth[Target + 2 * x] = pHalfDepth[Source + x];
+			}
+		}
+	}
+
+	// Keeps the nearer of two rows pixel by pixel, four at a time; udSDK depth grows away from the camera
+	static void MergeNearerRow(const uint32* pLayerColor, const float* pLayerDepth, uint32* pColor, float* pDepth, int32 Count)
+	{
+		int32 i = 0;
+		for (; i + 4 <= Count; i += 4)
+		{
+			const VectorRegister4Float LayerDepth = VectorLoad(pLayerDepth + i);
+			const VectorRegister4Float Depth = VectorLoad(pDepth + i);
+			const VectorRegister4Float Nearer = VectorCompareLT(LayerDepth, Depth);
+
+			// Color bits go through the float select untouched, it is a bitwise blend
+			const VectorRegister4Float LayerColor = VectorCastIntToFloat(VectorIntLoad(pLayerColor + i));
+			const VectorRegister4Float Color = VectorCastIntToFloat(VectorIntLoad(pColor + i));
+
+			VectorStore(VectorSelect(Nearer, LayerDepth, Depth), pDepth + i);
+			VectorIntStore(VectorCastFloatToInt(VectorSelect(Nearer, LayerColor, Color)), pColor + i);
+		}
+
+		for (; i < Count; ++i)
+		{
+			if (pLayerDepth[i] < pDepth[i])
+			{
+				pDepth[i] = pLayerDepth[i];
+				pColor[i] = pLayerColor[i];
+			}
+		}
+	}
+
+	void MergeDepthLayer(const FColor* pLayerColor, const float* pLayerDepth, const FIntPoint& LayerSize, FColor* pColor, float* pDepth, int32 Width, int32 Height)
+	{
+		const uint32* pLayerColorBits = reinterpret_cast<const uint32*>(pLayerColor);
+		uint32* pColorBits = reinterpret_cast<uint32*>(pColor);
+
+		if (LayerSize == FIntPoint(Width, Height))
+		{
+			MergeNearerRow(pLayerColorBits, pLayerDepth, pColorBits, pDepth, Width * Height);
+			return;
+		}
+
+		// Layer column per output column, shared by every row; a layer row is gathered once and merged as long as it repeats
+		TArray<int32, TInlineAllocator<4096>> LayerColumns;
+		TArray<uint32, TInlineAllocator<4096>> RowColor;
+		TArray<float, TInlineAllocator<4096>> RowDepth;
+		LayerColumns.SetNumUninitialized(Width);
+		RowColor.SetNumUninitialized(Width);
+		RowDepth.SetNumUninitialized(Width);
+
+		for (int32 x = 0; x < Width; ++x)
+		{
+			LayerColumns[x] = FMath::Min(x * LayerSize.X / Width, LayerSize.X - 1);
+		}
+
+		int32 GatheredRow = -1;
+		for (int32 y = 0; y < Height; ++y)
+		{
+			const int32 LayerRow = FMath::Min(y * LayerSize.Y / Height, LayerSize.Y - 1);
+			if (LayerRow != GatheredRow)
+			{
+				const uint32* pLayerColorRow = pLayerColorBits + (SIZE_T)LayerRow * LayerSize.X;
+				const float* pLayerDepthRow = pLayerDepth + (SIZE_T)LayerRow * LayerSize.X;
+				for (int32 x = 0; x < Width; ++x)
+				{
+					RowColor[x] = pLayerColorRow[LayerColumns[x]];
+					RowDepth[x] = pLayerDepthRow[LayerColumns[x]];
+				}
+				GatheredRow = LayerRow;
+			}
+
+			MergeNearerRow(RowColor.GetData(), RowDepth.GetData(), pColorBits + (SIZE_T)y * Width, pDepth + (SIZE_T)y * Width, Width);
+		}
+	}
+
+	void CompositeFoveated(const FColor* pOuterColor, const float* pOuterDepth, const FIntPoint& OuterSize, const FColor* pInnerColor, const float* pInnerDepth, const FIntRect& InnerRect, int32 BlendPixels, FColor* pColor, float* pDepth, int32 Width, int32 Height)
+	{
+		// Outer column per output column, shared by every row
+		TArray<int32, TInlineAllocator<4096>> OuterColumns;
+		OuterColumns.SetNumUninitialized(Width);
+		for (int32 x = 0; x < Width; ++x)
+		{
+			OuterColumns[x] = FMath::Min(x * OuterSize.X / Width, OuterSize.X - 1);
+		}
+
+		const int32 InnerWidth = InnerRect.Width();
+
+		for (int32 y = 0; y < Height; ++y)
+		{
+			const int32 OuterRow = FMath::Min(y * OuterSize.Y / Height, OuterSize.Y - 1) * OuterSize.X;
+			FColor* pColorRow = pColor + (SIZE_T)y * Width;
+			float* pDepthRow = pDepth + (SIZE_T)y * Width;
+
+			const bool bInnerRow = y >= InnerRect.Min.Y && y < InnerRect.Max.Y;
+			const int32 InnerBegin = bInnerRow ? InnerRect.Min.X : Width;
+			const int32 InnerEnd = bInnerRow ? InnerRect.Max.X : Width;
+
+			for (int32 x = 0; x < InnerBegin; ++x)
+			{
+				pColorRow[x] = pOuterColor[OuterRow + OuterColumns[x]];
+				pDepthRow[x] = pOuterDepth[OuterRow + OuterColumns[x]];
+			}
+
+			if (bInnerRow)
+			{
+				const int32 InnerRow = (y - InnerRect.Min.Y) * InnerWidth - InnerRect.Min.X;
+				const int32 EdgeY = FMath::Min(y - InnerRect.Min.Y, InnerRect.Max.Y - 1 - y);
+
+				for (int32 x = InnerBegin; x < InnerEnd; ++x)
+				{
+					const FColor& Inner = pInnerColor[InnerRow + x];
+					const float InnerDepth = pInnerDepth[InnerRow + x];
+
+					const int32 Edge = FMath::Min3(EdgeY, x - InnerRect.Min.X, InnerRect.Max.X - 1 - x);
+					if (Edge >= BlendPixels)
+					{
+						pColorRow[x] = Inner;
+						pDepthRow[x] = InnerDepth;
+						continue;
+					}
+
+					const FColor& Outer = pOuterColor[OuterRow + OuterColumns[x]];
+					const float OuterDepth = pOuterDepth[OuterRow + OuterColumns[x]];
+					const float Weight = FMath::SmoothStep(0.0f, 1.0f, (Edge + 0.5f) / BlendPixels);
+
+					const bool bInner = Weight >= 0.5f;
+					pColorRow[x] = bInner ? Inner : Outer;
+					pDepthRow[x] = bInner ? InnerDepth : OuterDepth;
+
+					if (InnerDepth < ClearDepth && OuterDepth < ClearDepth)
+					{
+						pColorRow[x].R = (uint8)FMath::RoundToInt(FMath::Lerp((float)Outer.R, (float)Inner.R, Weight));
+						pColorRow[x].G = (uint8)FMath::RoundToInt(FMath::Lerp((float)Outer.G, (float)Inner.G, Weight));
+						pColorRow[x].B = (uint8)FMath::RoundToInt(FMath::Lerp((float)Outer.B, (float)Inner.B, Weight));
+					}
+				}
+			}
+
+			for (int32 x = InnerEnd; x < Width; ++x)
+			{
+				pColorRow[x] = pOuterColor[OuterRow + OuterColumns[x]];
+				pDepthRow[x] = pOuterDepth[OuterRow + OuterColumns[x]];
+			}
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UDDefine.h"
+
+// CPU kernels run over the UD color/depth buffers between udRenderContext_Render and the texture upload
+namespace UDBufferKernels
+{
+	// Depth value udSDK writes to pixels that no voxel touched
+	constexpr float ClearDepth = 1.0f;
+
+	// Finds the bounding rect of all pixels with depth < ClearDepth
+	FUDCoverage ComputeCoverage(const float* pDepth, int32 Width, int32 Height);
+
+	// One image compared by ComputeDirtyRects, both buffers are tightly packed Width * Height pixels
+	struct FDirtyPlane
+	{
+		const uint8* pData;
+		uint8* pPrev;
+		int32 BytesPerPixel;
+	};
+
+	// Compares every plane against its previously uploaded copy in TileSize x TileSize tiles.
+	// Changed tiles are copied into the previous buffers and returned as rects, adjacent tiles merged; if that
+	// produces more than MaxRects the result collapses to their bounding rect.
+	void ComputeDirtyRects(const FDirtyPlane* pPlanes, int32 NumPlanes, int32 Width, int32 Height, int32 TileSize, int32 MaxRects, TArray<FIntRect>& OutRects);
+
+	// Clamps udSDK depth to [0, 1] and converts it to half floats in UE's reversed Z convention (1 - depth, 0 is empty);
+	// the conversion is free here and saves it in every shader that reads the depth. Halves keep their precision relative
+	// to the value, which reversed Z needs far away; written pixels never round to the empty 0.
+	void ConvertDepthToHalf(const float* pDepth, uint16* pOut, int32 Count);
+
+	// Color udSDK clears to; voxel shaders return 0x00RRGGBB, or a velocity tag up to UDS_MAX_MOVING_INSTANCES in alpha,
+	// so an alpha of 0xFF means udSDK didn't write the pixel
+	constexpr uint32 ClearColor = 0xFF000000;
+
+	// Forward splats a previous frame's furthest scene depth into a UD depth buffer for the current view, for
+	// udRCF_PreserveBuffers. Every sample is pushed Bias (a fraction of its distance) further away and the result is
+	// eroded by Dilation cells towards the far plane, so a seeded pixel is never in front of the scene it came from.
+	// ViewProjection is the one udSDK renders with, forward Z (see GetUdsForwardZProjection).
+	void ReprojectOccluderDepth(const FUDOccluderDepth& Occluders, const FMatrix& ViewProjection, float Bias, int32 Dilation, float* pOutDepth, int32 Width, int32 Height, TArray<float>& Scratch);
+
+	// Resets the depth of every pixel still at ClearColor (not written by udSDK) to ClearDepth
+	void ResetUnwrittenDepth(const FColor* pColor, float* pDepth, int32 Count);
+
+	// Scatters a half width, half height render into every other pixel of every other row of a full size buffer,
+	// starting at (Column, Row); two of these with opposite columns fill one half of a checkerboard
+	void InterleaveCheckerboard(const FColor* pHalfColor, const float* pHalfDepth, int32 HalfWidth, int32 HalfHeight, int32 Column, int32 Row, FColor* pColor, float* pDepth, int32 Width);
+
+	// Fills a full size buffer from a foveated render: the outer render, covering the whole view at reduced resolution, is point
+	// sampled everywhere outside InnerRect, and the full resolution inner render fades in over BlendPixels inside its edge.
+	// Color blends where both renders wrote the pixel; depth and alpha come from whichever side weighs more, never averaged across surfaces.
+	void CompositeFoveated(const FColor* pOuterColor, const float* pOuterDepth, const FIntPoint& OuterSize, const FColor* pInnerColor, const float* pInnerDepth, const FIntRect& InnerRect, int32 BlendPixels, FColor* pColor, float* pDepth, int32 Width, int32 Height);
+
+	// Depth merges a layer rendered on its own, at LayerSize, into a full size buffer: each pixel takes the layer's point sampled
+	// color and depth where they are nearer than its own. Color is taken whole, velocity tag alpha included.
+	void MergeDepthLayer(const FColor* pLayerColor, const float* pLayerDepth, const FIntPoint& LayerSize, FColor* pColor, float* pDepth, int32 Width, int32 Height);
+
+	// Packs each pixel as R5G6B5 color in the low 16 bits and reversed Z half depth (see ConvertDepthToHalf) in the high 16 bits
+	void PackColorDepth(const FColor* pColor, const float* pDepth, uint32* pOut, int32 Count);
+}
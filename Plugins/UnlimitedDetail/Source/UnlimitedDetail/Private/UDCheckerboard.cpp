@@ -0,0 +1,211 @@
+#include "UDCheckerboard.h"
+#include "Subpasses/UdsData.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+#include "SceneView.h"
+
+static int32 GUdsCheckerboard = 0;
+static FAutoConsoleVariableRef CVarUdsCheckerboard(
+	TEXT("r.Uds.Checkerboard"),
+	GUdsCheckerboard,
+	TEXT("Renders half the UD pixels each frame in a checkerboard, alternating with the other half the next frame, and rebuilds\n")
+	TEXT("the full image on the GPU from both halves, validating the older one with UD depth. Ignored with r.Uds.Temporal. 1 on, 0 off (default)"),
+	ECVF_Default);
+
+static float GUdsCheckerboardDepthTolerance = 0.05f;
+static FAutoConsoleVariableRef CVarUdsCheckerboardDepthTolerance(
+	TEXT("r.Uds.Checkerboard.DepthTolerance"),
+	GUdsCheckerboardDepthTolerance,
+	TEXT("How far, as a fraction, a previous half-frame sample's depth may lie outside its current neighbours' before it is rejected (default 0.05)"),
+	ECVF_RenderThreadSafe);
+
+static int32 GUdsCheckerboardReference = 0;
+static FAutoConsoleVariableRef CVarUdsCheckerboardReference(
+	TEXT("r.Uds.Checkerboard.Reference"),
+	GUdsCheckerboardReference,
+	TEXT("Also renders every checkerboard frame at full resolution and scores the reconstruction against it, for Uds.Benchmark.CheckerboardQuality.\n")
+	TEXT("Costs a full UD render per frame. 1 on, 0 off (default)"),
+	ECVF_Default);
+
+DECLARE_GPU_STAT(UnlimitedDetailCheckerboard)
+
+///
+/// COMPUTE SHADER
+///
+class FUdsCheckerboardReconstructCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsCheckerboardReconstructCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsCheckerboardReconstructCS, FGlobalShader);
+
+	class FOutputFormatDim : SHADER_PERMUTATION_ENUM_CLASS("UDS_OUTPUT_FORMAT", EUDOutputFormat);
+	using FPermutationDomain = TShaderPermutationDomain<FOutputFormatDim>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdColorTexture)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdDepthTexture)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<uint>, UdPackedTexture)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, RWUdColor)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, RWUdDepth)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<uint>, RWUdPacked)
+		SHADER_PARAMETER(FMatrix44f, PrevClipToClip)
+		SHADER_PARAMETER(FUintVector2, Size)
+		SHADER_PARAMETER(uint32, Parity)
+		SHADER_PARAMETER(uint32, bHistoryValid)
+		SHADER_PARAMETER(float, DepthTolerance)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEX"), FComputeShaderUtils::kGolden2DGroupSize);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEY"), FComputeShaderUtils::kGolden2DGroupSize);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsCheckerboardReconstructCS, "/Plugins/UnlimitedDetail/Private/Uds_Checkerboard.usf", "ReconstructCS", SF_Compute);
+
+bool IsUdsCheckerboardEnabled()
+{
+	return GUdsCheckerboard > 0;
+}
+
+bool IsUdsCheckerboardReferenceEnabled()
+{
+	return GUdsCheckerboardReference > 0;
+}
+
+FUDCheckerboardScoring::FUDCheckerboardScoring()
+{
+}
+
+FUDCheckerboardScoring::~FUDCheckerboardScoring()
+{
+}
+
+FUDCheckerboardQuality FUDCheckerboardScoring::ConsumeQuality()
+{
+	FScopeLock ScopeLock(&QualityMutex);
+
+	const FUDCheckerboardQuality Result = Quality;
+	Quality = FUDCheckerboardQuality();
+	return Result;
+}
+
+// Color PSNR over the whole image; pixels UD didn't write are black in both
+void FUDCheckerboardScoring::Score_RenderThread()
+{
+	for (FReadback& Entry : Readbacks)
+	{
+		if (!Entry.bPending || !Entry.Readback->IsReady())
+			continue;
+
+		int32 RowPitchInPixels = 0;
+		const FColor* pData = static_cast<const FColor*>(Entry.Readback->Lock(RowPitchInPixels));
+		if (pData)
+		{
+			const FColor* pReference = Entry.Reference->GetData();
+			double SquaredError = 0.0;
+
+			for (int32 y = 0; y < Entry.Size.Y; ++y)
+			{
+				for (int32 x = 0; x < Entry.Size.X; ++x)
+				{
+					// The texture holds udSDK's bytes as uploaded, the readback lines up with the reference byte for byte
+					const FColor& Reconstructed = pData[y * RowPitchInPixels + x];
+					const FColor& Reference = pReference[y * Entry.Size.X + x];
+
+					const int32 DR = (int32)Reconstructed.R - Reference.R;
+					const int32 DG = (int32)Reconstructed.G - Reference.G;
+					const int32 DB = (int32)Reconstructed.B - Reference.B;
+					SquaredError += DR * DR + DG * DG + DB * DB;
+				}
+			}
+
+			const double MSE = FMath::Max(SquaredError / (3.0 * Entry.Size.X * Entry.Size.Y), 1e-6);
+			const double PSNR = 10.0 * FMath::LogX(10.0, 255.0 * 255.0 / MSE);
+
+			FScopeLock ScopeLock(&QualityMutex);
+			Quality.MinPSNR = (Quality.NumFrames == 0) ? PSNR : FMath::Min(Quality.MinPSNR, PSNR);
+			Quality.PSNRSum += PSNR;
+			++Quality.NumFrames;
+		}
+		Entry.Readback->Unlock();
+		Entry.bPending = false;
+		Entry.Reference.Reset();
+	}
+}
+
+void FUDCheckerboardScoring::Capture_RenderThread(FRDGBuilder& GraphBuilder, FRDGTextureRef Color, const TSharedPtr<const TArray<FColor>, ESPMode::ThreadSafe>& Reference, const FIntPoint& Size)
+{
+	for (FReadback& Entry : Readbacks)
+	{
+		if (Entry.bPending)
+			continue;
+
+		if (!Entry.Readback.IsValid())
+		{
+			Entry.Readback = MakeUnique<FRHIGPUTextureReadback>(TEXT("Uds.CheckerboardReadback"));
+		}
+
+		AddEnqueueCopyPass(GraphBuilder, Entry.Readback.Get(), Color);
+		Entry.Reference = Reference;
+		Entry.Size = Size;
+		Entry.bPending = true;
+		break;
+	}
+}
+
+void AddUdsCheckerboardPasses(FRDGBuilder& GraphBuilder, const FSceneView& View, FUdsData& Data, FUDCheckerboardScoring& Scoring)
+{
+	check(Data.UdColorRDGTexture);
+
+	Scoring.Score_RenderThread();
+
+	RDG_GPU_STAT_SCOPE(GraphBuilder, UnlimitedDetailCheckerboard);
+
+	const FIntPoint Size = Data.UdColorRDGTexture->Desc.Extent;
+	const bool bPacked = Data.UdOutputFormat == EUDOutputFormat::Packed;
+
+	// Same formats as the upload, every pass reading UD decodes the rebuilt image unchanged
+	FRDGTextureRef OutputColor = GraphBuilder.CreateTexture(Data.UdColorRDGTexture->Desc, TEXT("Uds.CheckerboardColor"));
+	FRDGTextureRef OutputDepth = bPacked ? nullptr : GraphBuilder.CreateTexture(Data.UdDepthRDGTexture->Desc, TEXT("Uds.CheckerboardDepth"));
+
+	FUdsCheckerboardReconstructCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsCheckerboardReconstructCS::FParameters>();
+	if (bPacked)
+	{
+		PassParameters->UdPackedTexture = Data.UdColorRDGTexture;
+		PassParameters->RWUdPacked = GraphBuilder.CreateUAV(OutputColor);
+	}
+	else
+	{
+		PassParameters->UdColorTexture = Data.UdColorRDGTexture;
+		PassParameters->UdDepthTexture = Data.UdDepthRDGTexture;
+		PassParameters->RWUdColor = GraphBuilder.CreateUAV(OutputColor);
+		PassParameters->RWUdDepth = GraphBuilder.CreateUAV(OutputDepth);
+	}
+	PassParameters->PrevClipToClip = FMatrix44f(Data.UdCheckerboard.PrevClipToClip);
+	PassParameters->Size = FUintVector2(Size.X, Size.Y);
+	PassParameters->Parity = Data.UdCheckerboard.Parity;
+	PassParameters->bHistoryValid = Data.UdCheckerboard.bHistoryValid ? 1 : 0;
+	PassParameters->DepthTolerance = FMath::Max(GUdsCheckerboardDepthTolerance, 0.0f);
+
+	FUdsCheckerboardReconstructCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FUdsCheckerboardReconstructCS::FOutputFormatDim>(Data.UdOutputFormat);
+
+	TShaderMapRef<FUdsCheckerboardReconstructCS> ComputeShader(GetGlobalShaderMap(View.GetFeatureLevel()), PermutationVector);
+	FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("UdsCheckerboard %dx%d", Size.X, Size.Y), ComputeShader, PassParameters,
+		FComputeShaderUtils::GetGroupCount(Size, FComputeShaderUtils::kGolden2DGroupSize));
+
+	Data.UdColorRDGTexture = OutputColor;
+	Data.UdDepthRDGTexture = OutputDepth;
+
+	// Scoring needs color in its own plane
+	if (Data.UdCheckerboardReference.IsValid() && !bPacked && Data.UdCheckerboardReference->Num() == Size.X * Size.Y)
+	{
+		Scoring.Capture_RenderThread(GraphBuilder, OutputColor, Data.UdCheckerboardReference, Size);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "RenderGraphBuilder.h"
+#include "UDDefine.h"
+
+struct FUdsData;
+class FSceneView;
+class FRHIGPUTextureReadback;
+
+// Reconstructions in flight to the CPU for scoring at once, more are skipped
+#define UDS_CHECKERBOARD_READBACKS 4
+
+// Value of r.Uds.Checkerboard, read on the game thread when a view's UD capture is set up
+bool IsUdsCheckerboardEnabled();
+
+// Value of r.Uds.Checkerboard.Reference: a full resolution reference is rendered alongside every checkerboard frame
+bool IsUdsCheckerboardReferenceEnabled();
+
+// Reconstructed checkerboard frames read back and scored against their full resolution references, r.Uds.Checkerboard.Reference.
+// Owned by the scene view extension, the readbacks go with it when the subsystem exits.
+class FUDCheckerboardScoring
+{
+public:
+	FUDCheckerboardScoring();
+	~FUDCheckerboardScoring();
+
+	// Render thread: scores the readbacks that have landed
+	void Score_RenderThread();
+
+	// Render thread: queues a reconstruction's color for readback, skipped while every readback is still in flight
+	void Capture_RenderThread(FRDGBuilder& GraphBuilder, FRDGTextureRef Color, const TSharedPtr<const TArray<FColor>, ESPMode::ThreadSafe>& Reference, const FIntPoint& Size);
+
+	// PSNR accumulated since the last call
+	FUDCheckerboardQuality ConsumeQuality();
+
+private:
+	struct FReadback
+	{
+		TUniquePtr<FRHIGPUTextureReadback> Readback;
+		TSharedPtr<const TArray<FColor>, ESPMode::ThreadSafe> Reference;
+		FIntPoint Size;
+		bool bPending = false;
+	};
+
+	FReadback Readbacks[UDS_CHECKERBOARD_READBACKS];
+
+	FCriticalSection QualityMutex;
+	FUDCheckerboardQuality Quality;
+};
+
+// Rebuilds the full UD image from this frame's half and the previous one, replacing the view's UD RDG textures.
+// With a reference image, the result is also handed to Scoring, see UUDSubsystem::ConsumeCheckerboardQuality.
+void AddUdsCheckerboardPasses(FRDGBuilder& GraphBuilder, const FSceneView& View, FUdsData& Data, FUDCheckerboardScoring& Scoring);
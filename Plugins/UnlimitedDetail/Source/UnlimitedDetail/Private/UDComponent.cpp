@@ -2,6 +2,7 @@
 #include "Engine/World.h"
 #include "UDDefine.h"
 #include "UDSubsystem.h"
+#include "UDLayers.h"
 
 /** Represents a UArrowComponent to the scene manager. */
 class FPointCloudSceneProxy final : public FPrimitiveSceneProxy
@@ -19,6 +20,8 @@ public:
 		bWillEverBeLit = false;
 		instance = -1;
 		bShouldNotifyOnWorldAddRemove = true;
+		Layer = GetUdsComponentLayer(*Component);
+		bDynamic = Component->bDynamic;
 	}
 
 	virtual ~FPointCloudSceneProxy()
@@ -63,7 +66,7 @@ public:
 		check(instance == -1);
 
 		UUDSubsystem *MySubsystem = GEngine->GetEngineSubsystem<UUDSubsystem>();
-		instance = MySubsystem->QueueInstance(myRoot->PointCloudHandle, GetLocalToWorld(), &GetScene());
+		instance = MySubsystem->QueueInstance(myRoot->PointCloudHandle, GetLocalToWorld(), &GetScene(), Layer, bDynamic);
 
 		SetForceHidden(false);
 		return false;
@@ -86,7 +89,7 @@ public:
 
 		if (instance == -1)
 		{
-			instance = MySubsystem->QueueInstance(myRoot->PointCloudHandle, GetLocalToWorld(), &GetScene());
+			instance = MySubsystem->QueueInstance(myRoot->PointCloudHandle, GetLocalToWorld(), &GetScene(), Layer, bDynamic);
 		}
 		else
 		{
@@ -107,6 +110,8 @@ public:
 private:
 	UUDComponent* myRoot = nullptr;
 	int64_t instance; //TODO: Find we need multiple of these
+	EUDRenderLayer Layer; // From the component's tags, see r.Uds.Layers
+	bool bDynamic; // See r.Uds.StaticCache
 };
 
 
@@ -135,7 +140,7 @@ void UUDComponent::RefreshPointCloud()
 
 void UUDComponent::LoadPointCloud()
 {
-	if (PointCloudHandle)
+	if (PointCloudHandle || bLoadRequested)
 		return;
 
 	UUDSubsystem* MySubsystem = GEngine->GetEngineSubsystem<UUDSubsystem>();
@@ -146,14 +151,43 @@ void UUDComponent::LoadPointCloud()
 	if (Url.IsEmpty())
 		return;
 
-	PointCloudHandle = MySubsystem->Load(GetUrl());
+	// The first point cloud logs in, the handle comes back once that's done
+	bLoadRequested = true;
+	const FString RequestedUrl = GetUrl();
+	MySubsystem->RequestLoad(RequestedUrl, FUDOnPointCloudLoaded::CreateWeakLambda(this, [this, RequestedUrl](FUDPointCloudHandle* Handle)
+	{
+		OnPointCloudLoaded(RequestedUrl, Handle);
+	}));
+}
+
+void UUDComponent::OnPointCloudLoaded(const FString& RequestedUrl, FUDPointCloudHandle* Handle)
+{
+	// Unloaded or pointed somewhere else while it waited
+	if (!bLoadRequested || PointCloudHandle || RequestedUrl != Url)
+	{
+		if (Handle)
+		{
+			GEngine->GetEngineSubsystem<UUDSubsystem>()->Remove(Handle);
+		}
+		return;
+	}
+
+	bLoadRequested = false;
+	PointCloudHandle = Handle;
 
 	if (PointCloudHandle)
+	{
 		UE_LOG(LogTemp, Display, TEXT("UnlimitedDetail | Component %s | Load PCI | %p | %s"), *GetName(), PointCloudHandle, *PointCloudHandle->URL);
+
+		// The proxy was made without it, a new one queues the instance
+		MarkRenderStateDirty();
+	}
 }
 
 void UUDComponent::UnloadPointCloud()
 {
+	bLoadRequested = false;
+
 	if (!PointCloudHandle)
 		return;
 
@@ -174,16 +208,14 @@ void UUDComponent::BeginPlay()
 
 void UUDComponent::BeginDestroy()
 {
-	if (PointCloudHandle)
-		UnloadPointCloud();
+	UnloadPointCloud();
 
 	Super::BeginDestroy();
 }
 
 void UUDComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	if (PointCloudHandle)
-		UnloadPointCloud();
+	UnloadPointCloud();
 
 	Super::EndPlay(EndPlayReason);
 }
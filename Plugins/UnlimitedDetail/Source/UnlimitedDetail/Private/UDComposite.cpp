@@ -1,4 +1,5 @@
 #include "UDComposite.h"
+#include "UDDefine.h"
 
 #include "Subpasses/UdsSubpassFirst.h"
 #include "Subpasses/UdsSubpassComposite.h"
@@ -12,7 +13,11 @@
 
 DECLARE_GPU_STAT(UnlimitedDetailCompositeResolutionPass)
 
-FUDComposite::FUDComposite(EUdsMode InMode, TArray<TSharedPtr<FUdsData>> InViewData) : Mode(InMode) , ViewData(InViewData)
+// Should stay flat while the same views are being rendered, a climbing value means composite state is leaking on the render path
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Composite View States"), STAT_UdsCompositeViewStates, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Composite Subpasses"), STAT_UdsCompositeSubpasses, STATGROUP_UnlimitedDetail);
+
+FUdsCompositeState::FUdsCompositeState(EUdsMode InMode) : Mode(InMode)
 {
 	if (Mode != EUdsMode::None)
 	{
@@ -20,11 +25,14 @@ FUDComposite::FUDComposite(EUdsMode InMode, TArray<TSharedPtr<FUdsData>> InViewD
 		// subpasses will run in the order in which they are registered
 		// ensure this subpass always runs first
 		RegisterSubpass<FUdsSubpassFirst>();
-		
+
 		RegisterSubpass<FUdsSubpassComposite>();
 
 		// ensure this subpass always runs last.
 		RegisterSubpass<FUdsSubpassLast>();
+
+		INC_DWORD_STAT_BY(STAT_UdsCompositeSubpasses, FUdsubpasses.Num());
+		NumAllocations += FUdsubpasses.Num();
 	}
 
 	else
@@ -33,29 +41,113 @@ FUDComposite::FUDComposite(EUdsMode InMode, TArray<TSharedPtr<FUdsData>> InViewD
 	}
 }
 
-ISpatialUpscaler* FUDComposite::Fork_GameThread(const class FSceneViewFamily& ViewFamily) const
+FUdsCompositeState::~FUdsCompositeState()
 {
-	// FSceneTextures::InitializeViewFamily(GraphBuilder, *(FViewFamilyInfo*)View.Family);
-	
-	// ViewFamily.Views[0]
-	//UE_LOG(LogTemp, Warning, TEXT("Game thread fork running"));
-	// the object we return here will get deleted by UE4 when the scene view tears down, so we need to instantiate a new one every frame.
-	return new FUDComposite(Mode, ViewData);
+	DEC_DWORD_STAT_BY(STAT_UdsCompositeSubpasses, FUdsubpasses.Num());
+	DEC_DWORD_STAT_BY(STAT_UdsCompositeViewStates, ViewStates.Num());
+
+	for (FUdsSubpass* Subpass : FUdsubpasses)
+	{
+		delete Subpass;
+	}
+	FUdsubpasses.Reset();
 }
 
-FScreenPassTexture FUDComposite::AddPasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs) const
+uint32 FUdsCompositeState::GetViewKey(const FSceneView& View, int32 ViewIndex)
+{
+	// Views without a persistent state (e.g. some scene captures) fall back to the target their family renders to and their index in it,
+	// so two such captures don't share a key. The top bit keeps them apart from the state keys, which count up from 1.
+	if (View.State)
+	{
+		return View.State->GetViewKey();
+	}
+	return 0x80000000u | (HashCombine(PointerHash(View.Family->RenderTarget), (uint32)ViewIndex) & 0x7FFFFFFFu);
+}
+
+FUdsData* FUdsCompositeState::BeginViewFrame_GameThread(const FSceneView& View, int32 ViewIndex)
+{
+	check(IsInGameThread());
+
+	const uint32 FrameNumber = View.Family->FrameNumber;
+	const uint32 Key = GetViewKey(View, ViewIndex);
+
+	FScopeLock ScopeLock(&ViewStatesMutex);
+
+	TUniquePtr<FViewState>& ViewState = ViewStates.FindOrAdd(Key);
+	if (!ViewState.IsValid())
+	{
+		ViewState = MakeUnique<FViewState>();
+		INC_DWORD_STAT(STAT_UdsCompositeViewStates);
+		++NumAllocations;
+	}
+
+	ViewState->LastUsedFrame = FrameNumber;
+
+	// Reset the slot in place; everything in it is per-frame (RDG references are only valid for the graph that produced them)
+	FUdsData& Data = ViewState->Frames[FrameNumber % UDS_FRAME_SLOTS];
+	Data = FUdsData();
+	Data.FrameNumber = FrameNumber;
+
+	return &Data;
+}
+
+void FUdsCompositeState::EndFrame_GameThread(uint32 FrameNumber)
+{
+	check(IsInGameThread());
+
+	FScopeLock ScopeLock(&ViewStatesMutex);
+
+	for (auto It = ViewStates.CreateIterator(); It; ++It)
+	{
+		if (FrameNumber - It.Value()->LastUsedFrame > UDS_VIEW_STATE_TIMEOUT)
+		{
+			It.RemoveCurrent();
+			DEC_DWORD_STAT(STAT_UdsCompositeViewStates);
+		}
+	}
+}
+
+FUdsData* FUdsCompositeState::FindViewData_RenderThread(const FSceneView& View)
+{
+	for (int i = 0; i < View.Family->Views.Num(); i++)
+	{
+		if (View.Family->Views[i] == &View)
+		{
+			FScopeLock ScopeLock(&ViewStatesMutex);
+
+			TUniquePtr<FViewState>* ViewState = ViewStates.Find(GetViewKey(View, i));
+			if (!ViewState)
+				return nullptr;
+
+			FUdsData& Data = (*ViewState)->Frames[View.Family->FrameNumber % UDS_FRAME_SLOTS];
+			return (Data.FrameNumber == View.Family->FrameNumber) ? &Data : nullptr;
+		}
+	}
+	return nullptr;
+}
+
+FScreenPassTexture FUdsCompositeState::AddPasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, const ISpatialUpscaler::FInputs& PassInputs)
 {
 	//UE_LOG(LogTemp, Warning, TEXT("Add passes running"));
-	
+
 	RDG_GPU_STAT_SCOPE(GraphBuilder, UnlimitedDetailCompositeResolutionPass);
 	check(PassInputs.SceneColor.IsValid());
 
-	
-	
-	TSharedPtr<FUdsData> Data = GetDataForView(View);
+	FUdsData* Data = FindViewData_RenderThread(View);
+	if (!Data)
+	{
+		// No UD capture for this view this frame, just forward scene color
+		if (PassInputs.OverrideOutput.IsValid())
+		{
+			AddDrawTexturePass(GraphBuilder, View, PassInputs.SceneColor, PassInputs.OverrideOutput);
+			return PassInputs.OverrideOutput;
+		}
+		return PassInputs.SceneColor;
+	}
+
 	for (FUdsSubpass* Subpass : FUdsubpasses)
 	{
-		Subpass->SetData(Data.Get());
+		Subpass->SetData(Data);
 	}
 
 	if (!Data->bInitialized)
@@ -78,14 +170,18 @@ FScreenPassTexture FUDComposite::AddPasses(FRDGBuilder& GraphBuilder, const FVie
 	return MoveTemp(FinalOutput);
 }
 
-TSharedPtr<FUdsData> FUDComposite::GetDataForView(const FViewInfo& View) const
+FUDComposite::FUDComposite(TSharedRef<FUdsCompositeState, ESPMode::ThreadSafe> InState) : State(InState)
 {
-	for (int i = 0; i < View.Family->Views.Num(); i++)
-	{
-		if (View.Family->Views[i] == &View)
-		{
-			return ViewData[i];
-		}
-	}
-	return nullptr;
-}
\ No newline at end of file
+}
+
+ISpatialUpscaler* FUDComposite::Fork_GameThread(const class FSceneViewFamily& ViewFamily) const
+{
+	// the object we return here will get deleted by UE when the scene view tears down, so a new handle is required every frame.
+	// It only holds a reference to the persistent state, the subpasses and view data are not recreated.
+	return new FUDComposite(State);
+}
+
+FScreenPassTexture FUDComposite::AddPasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs) const
+{
+	return State->AddPasses(GraphBuilder, View, PassInputs);
+}
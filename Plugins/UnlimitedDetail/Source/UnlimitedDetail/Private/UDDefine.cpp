@@ -1,2 +1,6 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 #pragma once
+
+#include "UDDefine.h"
+
+DEFINE_LOG_CATEGORY(LogUnlimitedDetail);
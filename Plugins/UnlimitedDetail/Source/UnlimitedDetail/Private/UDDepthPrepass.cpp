@@ -0,0 +1,278 @@
+#include "UDDepthPrepass.h"
+#include "Subpasses/UdsData.h"
+#include "PixelShaderUtils.h"
+#include "RenderGraphUtils.h"
+
+#include "Runtime/Renderer/Private/SceneRendering.h"
+
+static int32 GUdsDepthPrepass = 0;
+static FAutoConsoleVariableRef CVarUdsDepthPrepass(
+	TEXT("r.Uds.DepthPrepass"),
+	GUdsDepthPrepass,
+	TEXT("Writes UD into the scene before the base pass instead of only compositing it after post processing.\n")
+	TEXT(" 0: off, UD is composited after post processing (default)\n")
+	TEXT(" 1: UD depth is written into scene depth, meshes behind UD are rejected by the base pass; color is still composited\n")
+	TEXT(" 2: as 1, and UD color is written into the GBuffer as unlit so it is fogged and sorted with translucency; no composite"),
+	ECVF_Default);
+
+static int32 GUdsVelocity = 1;
+static FAutoConsoleVariableRef CVarUdsVelocity(
+	TEXT("r.Uds.Velocity"),
+	GUdsVelocity,
+	TEXT("Writes motion vectors for UD instances that moved, so TSR / TAA can reproject them. Needs r.Uds.DepthPrepass or r.Uds.Temporal\n")
+	TEXT("and a color plane with alpha (r.Uds.OutputFormat 0 or 1). 1 on (default), 0 off"),
+	ECVF_Default);
+
+DECLARE_GPU_STAT(UnlimitedDetailDepthPrepass)
+DECLARE_GPU_STAT(UnlimitedDetailVelocity)
+
+BEGIN_SHADER_PARAMETER_STRUCT(FUdsPrepassParameters, )
+	SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdColorTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdDepthTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D<uint>, UdPackedTexture)
+	SHADER_PARAMETER(FVector2f, SceneViewRectMin)
+	SHADER_PARAMETER(FVector2f, SceneToUdScale)
+	SHADER_PARAMETER(FVector2f, SceneJitter)
+	SHADER_PARAMETER(FVector2f, UdJitter)
+	SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<float4x4>, InstanceToPrevClip)
+	SHADER_PARAMETER(FMatrix44f, TranslatedWorldToClipNoAA)
+	SHADER_PARAMETER(uint32, NumMovingInstances)
+END_SHADER_PARAMETER_STRUCT()
+
+// Matches UDS_PREPASS_OUTPUT_* in Uds_DepthPrepass.usf
+enum class EUdsPrepassOutput : uint8
+{
+	Depth,
+	GBuffer,
+	SceneColor,
+	Velocity,
+
+	MAX
+};
+
+///
+/// PIXEL SHADER
+///
+class FUdsDepthPrepassPS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsDepthPrepassPS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsDepthPrepassPS, FGlobalShader);
+
+	class FOutputFormatDim : SHADER_PERMUTATION_ENUM_CLASS("UDS_OUTPUT_FORMAT", EUDOutputFormat);
+	class FPrepassOutputDim : SHADER_PERMUTATION_ENUM_CLASS("UDS_PREPASS_OUTPUT", EUdsPrepassOutput);
+	using FPermutationDomain = TShaderPermutationDomain<FOutputFormatDim, FPrepassOutputDim>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FUdsPrepassParameters, Prepass)
+		RENDER_TARGET_BINDING_SLOTS()
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		const FPermutationDomain PermutationVector(Parameters.PermutationId);
+
+		// Packed color has no alpha to carry the velocity tag
+		if (PermutationVector.Get<FPrepassOutputDim>() == EUdsPrepassOutput::Velocity && PermutationVector.Get<FOutputFormatDim>() == EUDOutputFormat::Packed)
+			return false;
+
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsDepthPrepassPS, "/Plugins/UnlimitedDetail/Private/Uds_DepthPrepass.usf", "MainPS", SF_Pixel);
+
+EUDDepthPrepass GetUdsDepthPrepassMode()
+{
+	return (EUDDepthPrepass)FMath::Clamp(GUdsDepthPrepass, 0, (int32)EUDDepthPrepass::MAX - 1);
+}
+
+bool IsUdsVelocityEnabled()
+{
+	return GUdsVelocity > 0;
+}
+
+// UD renders at the unscaled view size, the prepass runs at the internal resolution in the view rect.
+// Returns the part of the view rect UD wrote to.
+static FIntRect SetupPrepassParameters(const FViewInfo& View, const FUdsData& Data, FUdsPrepassParameters& OutParameters)
+{
+	const FIntRect ViewRect = View.ViewRect;
+	const FIntPoint UdSize = Data.UdColorTexture->GetSizeXY();
+	const FVector2f SceneToUdScale(UdSize.X / (float)ViewRect.Width(), UdSize.Y / (float)ViewRect.Height());
+
+	OutParameters.View = View.ViewUniformBuffer;
+	if (Data.UdOutputFormat == EUDOutputFormat::Packed)
+	{
+		OutParameters.UdPackedTexture = Data.UdColorRDGTexture;
+	}
+	else
+	{
+		OutParameters.UdColorTexture = Data.UdColorRDGTexture;
+		OutParameters.UdDepthTexture = Data.UdDepthRDGTexture;
+	}
+	OutParameters.SceneViewRectMin = FVector2f(ViewRect.Min.X, ViewRect.Min.Y);
+	OutParameters.SceneToUdScale = SceneToUdScale;
+
+	// A temporal UD render is jittered, possibly out of step with the view; other renders are sampled at pixel centers
+	if (Data.bUdTemporal)
+	{
+		OutParameters.SceneJitter = FVector2f(View.TemporalJitterPixels);
+		OutParameters.UdJitter = Data.UdJitter;
+	}
+	else
+	{
+		OutParameters.SceneJitter = FVector2f::ZeroVector;
+		OutParameters.UdJitter = FVector2f::ZeroVector;
+	}
+
+	FIntRect Rect(
+		ViewRect.Min.X + FMath::FloorToInt(Data.UdCoverage.Rect.Min.X / SceneToUdScale.X),
+		ViewRect.Min.Y + FMath::FloorToInt(Data.UdCoverage.Rect.Min.Y / SceneToUdScale.Y),
+		ViewRect.Min.X + FMath::CeilToInt(Data.UdCoverage.Rect.Max.X / SceneToUdScale.X),
+		ViewRect.Min.Y + FMath::CeilToInt(Data.UdCoverage.Rect.Max.Y / SceneToUdScale.Y));
+	Rect.Clip(ViewRect);
+
+	return Rect;
+}
+
+static TShaderMapRef<FUdsDepthPrepassPS> GetPrepassShader(const FViewInfo& View, const FUdsData& Data, EUdsPrepassOutput Output)
+{
+	FUdsDepthPrepassPS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FUdsDepthPrepassPS::FOutputFormatDim>(Data.UdOutputFormat);
+	PermutationVector.Set<FUdsDepthPrepassPS::FPrepassOutputDim>(Output);
+
+	return TShaderMapRef<FUdsDepthPrepassPS>(View.ShaderMap, PermutationVector);
+}
+
+void AddUdsDepthPrepass(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& Data, FRDGTextureRef SceneDepthTexture)
+{
+	RDG_GPU_STAT_SCOPE(GraphBuilder, UnlimitedDetailDepthPrepass);
+
+	FUdsDepthPrepassPS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsDepthPrepassPS::FParameters>();
+	const FIntRect Rect = SetupPrepassParameters(View, Data, PassParameters->Prepass);
+
+	if (Rect.IsEmpty())
+		return;
+
+	PassParameters->RenderTargets.DepthStencil = FDepthStencilBinding(SceneDepthTexture, ERenderTargetLoadAction::ELoad, FExclusiveDepthStencil::DepthWrite_StencilNop);
+
+	FPixelShaderUtils::AddFullscreenPass(GraphBuilder, View.ShaderMap,
+		RDG_EVENT_NAME("UdsDepthPrepass %dx%d", Rect.Width(), Rect.Height()),
+		GetPrepassShader(View, Data, EUdsPrepassOutput::Depth), PassParameters, Rect,
+		nullptr, nullptr,
+		TStaticDepthStencilState<true, CF_DepthNearOrEqual>::GetRHI());
+}
+
+void AddUdsGBufferPass(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& Data, const FRenderTargetBindingSlots& BasePassRenderTargets)
+{
+	RDG_GPU_STAT_SCOPE(GraphBuilder, UnlimitedDetailDepthPrepass);
+
+	// Expects the default deferred layout: scene color, GBuffer A, B and C in the first four slots
+	for (int32 i = 0; i < 4; ++i)
+	{
+		if (!BasePassRenderTargets[i].GetTexture())
+		{
+			// The layout won't change while the project runs, once is enough
+			static bool bWarned = false;
+			if (!bWarned)
+			{
+				UE_LOG(LogUnlimitedDetail, Warning, TEXT("Base pass targets don't match the expected GBuffer layout, UD GBuffer writes are skipped"));
+				bWarned = true;
+			}
+			return;
+		}
+	}
+
+	FUdsDepthPrepassPS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsDepthPrepassPS::FParameters>();
+	const FIntRect Rect = SetupPrepassParameters(View, Data, PassParameters->Prepass);
+
+	if (Rect.IsEmpty())
+		return;
+
+	for (int32 i = 0; i < 4; ++i)
+	{
+		PassParameters->RenderTargets[i] = FRenderTargetBinding(BasePassRenderTargets[i].GetTexture(), ERenderTargetLoadAction::ELoad);
+	}
+	PassParameters->RenderTargets.DepthStencil = FDepthStencilBinding(BasePassRenderTargets.DepthStencil.GetTexture(), ERenderTargetLoadAction::ELoad, FExclusiveDepthStencil::DepthRead_StencilNop);
+
+	// The shader outputs the same depth the prepass wrote, so an equal test keeps only pixels no mesh was drawn in front of
+	FPixelShaderUtils::AddFullscreenPass(GraphBuilder, View.ShaderMap,
+		RDG_EVENT_NAME("UdsGBuffer %dx%d", Rect.Width(), Rect.Height()),
+		GetPrepassShader(View, Data, EUdsPrepassOutput::GBuffer), PassParameters, Rect,
+		nullptr, nullptr,
+		TStaticDepthStencilState<false, CF_Equal>::GetRHI());
+}
+
+void AddUdsSceneColorPass(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& Data, FRDGTextureRef SceneColorTexture, FRDGTextureRef SceneDepthTexture)
+{
+	RDG_GPU_STAT_SCOPE(GraphBuilder, UnlimitedDetailDepthPrepass);
+
+	FUdsDepthPrepassPS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsDepthPrepassPS::FParameters>();
+	const FIntRect Rect = SetupPrepassParameters(View, Data, PassParameters->Prepass);
+
+	if (Rect.IsEmpty())
+		return;
+
+	PassParameters->RenderTargets[0] = FRenderTargetBinding(SceneColorTexture, ERenderTargetLoadAction::ELoad);
+	PassParameters->RenderTargets.DepthStencil = FDepthStencilBinding(SceneDepthTexture, ERenderTargetLoadAction::ELoad, FExclusiveDepthStencil::DepthRead_StencilNop);
+
+	// Scene depth already holds UD from the prepass, where a mesh ended up in front the test fails
+	FPixelShaderUtils::AddFullscreenPass(GraphBuilder, View.ShaderMap,
+		RDG_EVENT_NAME("UdsSceneColor %dx%d", Rect.Width(), Rect.Height()),
+		GetPrepassShader(View, Data, EUdsPrepassOutput::SceneColor), PassParameters, Rect,
+		nullptr, nullptr,
+		TStaticDepthStencilState<false, CF_DepthNearOrEqual>::GetRHI());
+}
+
+void AddUdsVelocityPass(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& Data, FRDGTextureRef VelocityTexture, FRDGTextureRef SceneDepthTexture)
+{
+	if (Data.UdOutputFormat == EUDOutputFormat::Packed)
+		return;
+
+	RDG_GPU_STAT_SCOPE(GraphBuilder, UnlimitedDetailVelocity);
+
+	FUdsDepthPrepassPS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsDepthPrepassPS::FParameters>();
+	const FIntRect Rect = SetupPrepassParameters(View, Data, PassParameters->Prepass);
+
+	if (Rect.IsEmpty())
+		return;
+
+	// Both ends are unjittered, a pixel's velocity is the motion of the surface it sampled.
+	// Each moved instance goes from this frame's translated world, through its local space, to last frame's clip space.
+	const FViewMatrices& PrevViewMatrices = View.PrevViewInfo.ViewMatrices;
+	const FMatrix TranslatedToWorld = FTranslationMatrix(-View.ViewMatrices.GetPreViewTranslation());
+	const FMatrix PrevViewProjection = PrevViewMatrices.GetViewMatrix() * PrevViewMatrices.GetProjectionNoAAMatrix();
+
+	TArray<FMatrix44f, TInlineAllocator<UDS_MAX_MOVING_INSTANCES>> InstanceToPrevClip;
+	for (const FUDInstanceMotion& Motion : Data.UdInstanceMotion)
+	{
+		InstanceToPrevClip.Add(FMatrix44f(TranslatedToWorld * Motion.Transform.Inverse() * Motion.PrevTransform * PrevViewProjection));
+	}
+
+	// Never an empty buffer
+	if (InstanceToPrevClip.Num() == 0)
+	{
+		InstanceToPrevClip.Add(FMatrix44f::Identity);
+	}
+
+	// The initial data is copied by the graph
+	FRDGBufferRef InstanceBuffer = CreateStructuredBuffer(GraphBuilder, TEXT("Uds.InstanceToPrevClip"), sizeof(FMatrix44f), InstanceToPrevClip.Num(),
+		InstanceToPrevClip.GetData(), InstanceToPrevClip.Num() * sizeof(FMatrix44f));
+
+	PassParameters->Prepass.InstanceToPrevClip = GraphBuilder.CreateSRV(InstanceBuffer);
+	PassParameters->Prepass.TranslatedWorldToClipNoAA = FMatrix44f(View.ViewMatrices.GetTranslatedViewMatrix() * View.ViewMatrices.GetProjectionNoAAMatrix());
+	PassParameters->Prepass.NumMovingInstances = Data.UdInstanceMotion.Num();
+
+	// Nothing may have drawn velocity yet this frame; the renderer loads it from here on
+	const ERenderTargetLoadAction LoadAction = HasBeenProduced(VelocityTexture) ? ERenderTargetLoadAction::ELoad : ERenderTargetLoadAction::EClear;
+	PassParameters->RenderTargets[0] = FRenderTargetBinding(VelocityTexture, LoadAction);
+	PassParameters->RenderTargets.DepthStencil = FDepthStencilBinding(SceneDepthTexture, ERenderTargetLoadAction::ELoad, FExclusiveDepthStencil::DepthRead_StencilNop);
+
+	// Scene depth holds UD from the prepass, an equal test leaves pixels where a mesh is in front to the mesh's own velocity
+	FPixelShaderUtils::AddFullscreenPass(GraphBuilder, View.ShaderMap,
+		RDG_EVENT_NAME("UdsVelocity %dx%d (%d moved)", Rect.Width(), Rect.Height(), Data.UdInstanceMotion.Num()),
+		GetPrepassShader(View, Data, EUdsPrepassOutput::Velocity), PassParameters, Rect,
+		nullptr, nullptr,
+		TStaticDepthStencilState<false, CF_Equal>::GetRHI());
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "RenderGraphBuilder.h"
+#include "UDDefine.h"
+
+struct FUdsData;
+class FViewInfo;
+
+// Value of r.Uds.DepthPrepass, read on the game thread when a view's UD capture is set up
+EUDDepthPrepass GetUdsDepthPrepassMode();
+
+// Writes UD depth into scene depth before the base pass, so meshes hidden behind UD fail the depth test and
+// everything after the base pass (fog, translucency, SSAO) sees UD as scene geometry
+void AddUdsDepthPrepass(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& Data, FRDGTextureRef SceneDepthTexture);
+
+// Writes UD color as an unlit surface into scene color and GBuffer A-C after the base pass.
+// Only pixels where UD depth is still the nearest surface are touched.
+void AddUdsGBufferPass(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& Data, const FRenderTargetBindingSlots& BasePassRenderTargets);
+
+// Writes UD color into scene color before post processing, for r.Uds.Temporal; TSR / TAA then upsample it with the rest of the frame.
+// Expects the prepass to have put UD depth into scene depth.
+void AddUdsSceneColorPass(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& Data, FRDGTextureRef SceneColorTexture, FRDGTextureRef SceneDepthTexture);
+
+// Value of r.Uds.Velocity, read on the game thread when instances are tagged for the velocity pass
+bool IsUdsVelocityEnabled();
+
+// Writes velocity for UD pixels: instances that moved since the previous frame are reprojected through their previous transform,
+// the rest are cleared so TSR / TAA derive camera motion from depth.
+// Expects the prepass to have put UD depth into scene depth; runs before the base pass so the renderer's own velocity passes load it.
+void AddUdsVelocityPass(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& Data, FRDGTextureRef VelocityTexture, FRDGTextureRef SceneDepthTexture);
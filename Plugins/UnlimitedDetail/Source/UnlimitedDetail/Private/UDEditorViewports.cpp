@@ -0,0 +1,101 @@
+#include "UDEditorViewports.h"
+#include "UDSubsystem.h"
+#include "SceneView.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Framework/Docking/TabManager.h"
+#include "Widgets/SWindow.h"
+
+#if WITH_EDITOR
+#include "LevelEditorViewport.h"
+#endif
+
+static int32 GUdsEditorViewportPolicy = 1;
+static FAutoConsoleVariableRef CVarUdsEditorViewportPolicy(
+	TEXT("r.Uds.Editor.ViewportPolicy"),
+	GUdsEditorViewportPolicy,
+	TEXT("How the level editor's viewports render UD.\n")
+	TEXT(" 0: every viewport whenever it draws, each resizing the main target to its own size\n")
+	TEXT(" 1: the focused viewport at full rate; the others on targets of their own at r.Uds.Editor.ScreenPercentage, re-rendered only\n")
+	TEXT("    when their camera or the UD instances changed or they are still streaming, and at most every r.Uds.Editor.Interval frames (default)\n")
+	TEXT(" 2: the focused viewport at full rate; the others at full resolution, re-rendered only when their camera or the UD instances changed\n")
+	TEXT("    or they are still streaming"),
+	ECVF_Default);
+
+static float GUdsEditorScreenPercentage = 50.0f;
+static FAutoConsoleVariableRef CVarUdsEditorScreenPercentage(
+	TEXT("r.Uds.Editor.ScreenPercentage"),
+	GUdsEditorScreenPercentage,
+	TEXT("Resolution of an unfocused editor viewport's UD as a percentage of the viewport's, r.Uds.Editor.ViewportPolicy 1 (default 50)"),
+	ECVF_Default);
+
+static int32 GUdsEditorInterval = 8;
+static FAutoConsoleVariableRef CVarUdsEditorInterval(
+	TEXT("r.Uds.Editor.Interval"),
+	GUdsEditorInterval,
+	TEXT("Fewest frames between two UD renders of an unfocused editor viewport, r.Uds.Editor.ViewportPolicy 1 (default 8)"),
+	ECVF_Default);
+
+static int32 GUdsEditorPauseInBackground = 1;
+static FAutoConsoleVariableRef CVarUdsEditorPauseInBackground(
+	TEXT("r.Uds.Editor.PauseInBackground"),
+	GUdsEditorPauseInBackground,
+	TEXT("While the editor is in the background or minimized its viewports and scene captures keep their last UD image and render none,\n")
+	TEXT("so nothing new is streamed either. Game views (PIE) are left alone. 1 on (default), 0 off"),
+	ECVF_Default);
+
+EUDEditorViewportPolicy GetUdsEditorViewportPolicy()
+{
+	return (EUDEditorViewportPolicy)FMath::Clamp(GUdsEditorViewportPolicy, 0, (int32)EUDEditorViewportPolicy::MAX - 1);
+}
+
+bool IsUdsEditorViewport(const FSceneView& View)
+{
+#if WITH_EDITOR
+	return GIsEditor && !View.bIsGameView && !View.bIsSceneCapture && !View.bIsReflectionCapture && !View.bIsPlanarReflection;
+#else
+	return false;
+#endif
+}
+
+bool IsUdsFocusedEditorViewport(const FSceneView& View)
+{
+#if WITH_EDITOR
+	// The family renders into the viewport itself, that's how it is told apart from the others
+	return GCurrentLevelEditingViewportClient && GCurrentLevelEditingViewportClient->Viewport &&
+		View.Family->RenderTarget == GCurrentLevelEditingViewportClient->Viewport;
+#else
+	return false;
+#endif
+}
+
+bool IsUdsEditorPaused()
+{
+#if WITH_EDITOR
+	if (!GIsEditor || GUdsEditorPauseInBackground <= 0 || !FSlateApplication::IsInitialized())
+	{
+		return false;
+	}
+
+	if (!FSlateApplication::Get().IsActive())
+	{
+		return true;
+	}
+
+	const TSharedPtr<SWindow> RootWindow = FGlobalTabmanager::Get()->GetRootWindow();
+	return RootWindow.IsValid() && RootWindow->IsWindowMinimized();
+#else
+	return false;
+#endif
+}
+
+FUDThrottle GetUdsEditorViewportThrottle()
+{
+	FUDThrottle Throttle;
+	if (GetUdsEditorViewportPolicy() == EUDEditorViewportPolicy::Throttled)
+	{
+		Throttle.ResolutionFraction = FMath::Clamp(GUdsEditorScreenPercentage, 10.0f, 100.0f) / 100.0f;
+		Throttle.Interval = FMath::Max(GUdsEditorInterval, 1);
+	}
+	Throttle.bPaused = IsUdsEditorPaused();
+	return Throttle;
+}
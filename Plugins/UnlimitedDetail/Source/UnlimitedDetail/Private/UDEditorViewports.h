@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSceneView;
+struct FUDThrottle;
+
+// How level editor viewports share UD, see r.Uds.Editor.ViewportPolicy
+enum class EUDEditorViewportPolicy : uint8
+{
+	All,		// Every viewport renders UD whenever it draws
+	Throttled,	// The focused viewport at full rate, the others on reduced targets re-rendered only when changed, at most every r.Uds.Editor.Interval frames
+	OnChange,	// The focused viewport at full rate, the others at full resolution but only when their camera or the UD instances changed
+
+	MAX
+};
+
+EUDEditorViewportPolicy GetUdsEditorViewportPolicy();
+
+// A level editor (or other non-game, non-capture) viewport; always false outside the editor
+bool IsUdsEditorViewport(const FSceneView& View);
+
+// The level viewport last clicked into, the one the user works in
+bool IsUdsFocusedEditorViewport(const FSceneView& View);
+
+// The editor window is in the background or minimized and r.Uds.Editor.PauseInBackground stops UD rendering, and with it streaming
+bool IsUdsEditorPaused();
+
+// How an unfocused editor viewport renders under the current policy
+FUDThrottle GetUdsEditorViewportThrottle();
@@ -0,0 +1,114 @@
+#include "UDFoveated.h"
+#include "SceneView.h"
+#include "StereoRendering.h"
+#include "EyeTrackerFunctionLibrary.h"
+#include "EyeTrackerTypes.h"
+
+static int32 GUdsFoveated = 0;
+static FAutoConsoleVariableRef CVarUdsFoveated(
+	TEXT("r.Uds.Foveated"),
+	GUdsFoveated,
+	TEXT("Renders UD as a full resolution inner target around the gaze or lens centre and a reduced resolution outer target covering\n")
+	TEXT("the whole view, blended together before upload. Ignored with r.Uds.Temporal and r.Uds.Checkerboard.\n")
+	TEXT(" 0: off (default)\n")
+	TEXT(" 1: stereo eye views only (VR, HoloLens)\n")
+	TEXT(" 2: every view"),
+	ECVF_Default);
+
+static float GUdsFoveatedInnerFraction = 0.4f;
+static FAutoConsoleVariableRef CVarUdsFoveatedInnerFraction(
+	TEXT("r.Uds.Foveated.InnerFraction"),
+	GUdsFoveatedInnerFraction,
+	TEXT("Width and height of the full resolution inner target as a fraction of the view's (default 0.4)"),
+	ECVF_Default);
+
+static float GUdsFoveatedOuterScale = 0.5f;
+static FAutoConsoleVariableRef CVarUdsFoveatedOuterScale(
+	TEXT("r.Uds.Foveated.OuterScale"),
+	GUdsFoveatedOuterScale,
+	TEXT("Resolution scale of the outer target on each axis, 0.5 is a quarter of the pixels (default 0.5)"),
+	ECVF_Default);
+
+static int32 GUdsFoveatedBlendPixels = 16;
+static FAutoConsoleVariableRef CVarUdsFoveatedBlendPixels(
+	TEXT("r.Uds.Foveated.BlendPixels"),
+	GUdsFoveatedBlendPixels,
+	TEXT("Pixels along the inside edge of the inner target over which it fades into the outer one (default 16)"),
+	ECVF_Default);
+
+static int32 GUdsFoveatedGaze = 1;
+static FAutoConsoleVariableRef CVarUdsFoveatedGaze(
+	TEXT("r.Uds.Foveated.Gaze"),
+	GUdsFoveatedGaze,
+	TEXT("Follows the gaze with the inner target when an eye tracker reports one, otherwise it stays on the lens centre. 1 on (default), 0 off"),
+	ECVF_Default);
+
+bool IsUdsFoveatedEnabled(const FSceneView& View)
+{
+	return GUdsFoveated >= 2 || (GUdsFoveated == 1 && IStereoRendering::IsStereoEyeView(View));
+}
+
+FIntPoint GetUdsFoveatedInnerSize(const FIntPoint& Size)
+{
+	const float Fraction = FMath::Clamp(GUdsFoveatedInnerFraction, 0.1f, 1.0f);
+	return FIntPoint(
+		FMath::Clamp(FMath::CeilToInt(Size.X * Fraction), 1, Size.X),
+		FMath::Clamp(FMath::CeilToInt(Size.Y * Fraction), 1, Size.Y));
+}
+
+FIntPoint GetUdsFoveatedOuterSize(const FIntPoint& Size)
+{
+	const float Scale = FMath::Clamp(GUdsFoveatedOuterScale, 0.1f, 1.0f);
+	return FIntPoint(
+		FMath::Max(FMath::CeilToInt(Size.X * Scale), 1),
+		FMath::Max(FMath::CeilToInt(Size.Y * Scale), 1));
+}
+
+int32 GetUdsFoveatedBlendPixels()
+{
+	return FMath::Max(GUdsFoveatedBlendPixels, 0);
+}
+
+FIntRect GetUdsFoveatedInnerRect(const FSceneView& View, const FMatrix& Projection, const FIntPoint& Size)
+{
+	// A point straight ahead in view space
+	FVector4 Clip = Projection.TransformFVector4(FVector4(0.0, 0.0, 1.0, 1.0));
+
+	FEyeTrackerGazeData GazeData;
+	if (GUdsFoveatedGaze > 0 && UEyeTrackerFunctionLibrary::GetGazeData(GazeData, nullptr) && GazeData.ConfidenceValue > 0.5f)
+	{
+		const FMatrix ViewProjection = View.ViewMatrices.GetViewMatrix() * Projection;
+		const FVector4 GazeClip = ViewProjection.TransformFVector4(FVector4(GazeData.GazeOrigin + GazeData.GazeDirection * 10000.0, 1.0));
+		if (GazeClip.W > 0.0)
+		{
+			Clip = GazeClip;
+		}
+	}
+
+	const FIntPoint InnerSize = GetUdsFoveatedInnerSize(Size);
+	const FVector2D Center = Clip.W > 0.0 ? FVector2D(Clip.X / Clip.W, Clip.Y / Clip.W) : FVector2D::ZeroVector;
+
+	// Clip space Y points up
+	const FIntPoint Min(
+		FMath::Clamp(FMath::RoundToInt((Center.X * 0.5 + 0.5) * Size.X - InnerSize.X * 0.5), 0, Size.X - InnerSize.X),
+		FMath::Clamp(FMath::RoundToInt((0.5 - Center.Y * 0.5) * Size.Y - InnerSize.Y * 0.5), 0, Size.Y - InnerSize.Y));
+
+	return FIntRect(Min, Min + InnerSize);
+}
+
+FMatrix GetUdsSubFrustumProjection(const FMatrix& Projection, const FIntRect& Rect, const FIntPoint& Size)
+{
+	// Scales clip space about the rect's centre so the rect fills it: x' = Scale * (x - Center * w)
+	const FVector2D Scale((double)Size.X / Rect.Width(), (double)Size.Y / Rect.Height());
+	const FVector2D Center(
+		(Rect.Min.X + Rect.Width() * 0.5) * 2.0 / Size.X - 1.0,
+		1.0 - (Rect.Min.Y + Rect.Height() * 0.5) * 2.0 / Size.Y);
+
+	FMatrix Result = Projection;
+	for (int32 Row = 0; Row < 4; ++Row)
+	{
+		Result.M[Row][0] = Scale.X * (Projection.M[Row][0] - Center.X * Projection.M[Row][3]);
+		Result.M[Row][1] = Scale.Y * (Projection.M[Row][1] - Center.Y * Projection.M[Row][3]);
+	}
+	return Result;
+}
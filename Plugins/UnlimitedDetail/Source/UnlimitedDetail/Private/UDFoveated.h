@@ -0,0 +1,22 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSceneView;
+
+// r.Uds.Foveated applies to this view: it is a stereo eye, or r.Uds.Foveated is 2. Read on the game thread when a view's UD capture is set up.
+bool IsUdsFoveatedEnabled(const FSceneView& View);
+
+// Size of the full resolution inner target for a Size render, and of the reduced resolution outer one covering the whole view
+FIntPoint GetUdsFoveatedInnerSize(const FIntPoint& Size);
+FIntPoint GetUdsFoveatedOuterSize(const FIntPoint& Size);
+
+// Width, in full resolution pixels along the inside of the inner rect, over which the composite fades from outer to inner
+int32 GetUdsFoveatedBlendPixels();
+
+// Where the inner target goes in a Size render: centered on the gaze when an eye tracker has one and r.Uds.Foveated.Gaze is on,
+// otherwise on the lens centre, where the view direction lands under the (possibly off-axis) eye projection
+FIntRect GetUdsFoveatedInnerRect(const FSceneView& View, const FMatrix& Projection, const FIntPoint& Size);
+
+// Projection covering only Rect of a Size target, so a Rect sized render lines up pixel for pixel with that part of the full one
+FMatrix GetUdsSubFrustumProjection(const FMatrix& Projection, const FIntRect& Rect, const FIntPoint& Size);
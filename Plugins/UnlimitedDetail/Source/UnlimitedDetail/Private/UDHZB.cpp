@@ -0,0 +1,197 @@
+#include "UDHZB.h"
+#include "Subpasses/UdsData.h"
+#include "RenderGraphUtils.h"
+#include <atomic>
+
+#include "Runtime/Renderer/Private/SceneRendering.h"
+#include "Runtime/Renderer/Private/ScenePrivate.h"
+
+static int32 GUdsHZB = 0;
+static FAutoConsoleVariableRef CVarUdsHZB(
+	TEXT("r.Uds.HZB"),
+	GUdsHZB,
+	TEXT("Merges UD depth into the furthest HZB so point clouds act as occluders for GPU occlusion culling (Nanite, r.InstanceCulling.OcclusionCull).\n")
+	TEXT("CPU primitive occlusion tests scene depth, use r.Uds.DepthPrepass for UD to take part in it. 1 on, 0 off (default)"),
+	ECVF_RenderThreadSafe);
+
+DECLARE_GPU_STAT(UnlimitedDetailHZB)
+
+// In the view frustum but not drawn, by occlusion or distance; compare with r.Uds.HZB / r.Uds.DepthPrepass off for the primitives UD culled
+DECLARE_DWORD_COUNTER_STAT(TEXT("Culled Primitives"), STAT_UdsCulledPrimitives, STATGROUP_UnlimitedDetail);
+
+static std::atomic<uint32> GUdsLastCulledPrimitives(0);
+static std::atomic<bool> GUdsCountCulledPrimitives(false);
+
+///
+/// COMPUTE SHADERS
+///
+class FUdsHZBMergeCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsHZBMergeCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsHZBMergeCS, FGlobalShader);
+
+	class FOutputFormatDim : SHADER_PERMUTATION_ENUM_CLASS("UDS_OUTPUT_FORMAT", EUDOutputFormat);
+	using FPermutationDomain = TShaderPermutationDomain<FOutputFormatDim>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdColorTexture)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdDepthTexture)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<uint>, UdPackedTexture)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float>, ParentTexture)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, OutputTexture)
+		SHADER_PARAMETER(FIntPoint, OutputSize)
+		SHADER_PARAMETER(FIntPoint, UdSize)
+		SHADER_PARAMETER(FVector2f, HZBTexelToUd)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEX"), FComputeShaderUtils::kGolden2DGroupSize);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEY"), FComputeShaderUtils::kGolden2DGroupSize);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsHZBMergeCS, "/Plugins/UnlimitedDetail/Private/Uds_HZB.usf", "MergeCS", SF_Compute);
+
+class FUdsHZBReduceCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsHZBReduceCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsHZBReduceCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture2D<float>, ParentMip)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, OutputTexture)
+		SHADER_PARAMETER(FIntPoint, OutputSize)
+		SHADER_PARAMETER(FIntPoint, ParentSize)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEX"), FComputeShaderUtils::kGolden2DGroupSize);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEY"), FComputeShaderUtils::kGolden2DGroupSize);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsHZBReduceCS, "/Plugins/UnlimitedDetail/Private/Uds_HZB.usf", "ReduceCS", SF_Compute);
+
+bool IsUdsHZBEnabled()
+{
+	return GUdsHZB > 0;
+}
+
+void AddUdsHZBMergePasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& Data)
+{
+	FRDGTextureRef HZB = View.HZB;
+	if (!HZB)
+		return;
+
+	RDG_GPU_STAT_SCOPE(GraphBuilder, UnlimitedDetailHZB);
+	RDG_EVENT_SCOPE(GraphBuilder, "UdsHZBMerge");
+
+	const FIntPoint Mip0Size = HZB->Desc.Extent;
+	const FIntPoint UdSize = Data.UdColorTexture->GetSizeXY();
+
+	// Mip 0 is merged from a copy of itself, the mip chain below it is then rebuilt from the merged result
+	FRDGTextureRef Mip0Copy = GraphBuilder.CreateTexture(FRDGTextureDesc::Create2D(Mip0Size, HZB->Desc.Format, FClearValueBinding::None, TexCreate_ShaderResource), TEXT("Uds.HZBMip0"));
+	{
+		FRHICopyTextureInfo CopyInfo;
+		CopyInfo.Size = FIntVector(Mip0Size.X, Mip0Size.Y, 1);
+		AddCopyTexturePass(GraphBuilder, HZB, Mip0Copy, CopyInfo);
+	}
+
+	{
+		FUdsHZBMergeCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsHZBMergeCS::FParameters>();
+		if (Data.UdOutputFormat == EUDOutputFormat::Packed)
+		{
+			PassParameters->UdPackedTexture = Data.UdColorRDGTexture;
+		}
+		else
+		{
+			PassParameters->UdColorTexture = Data.UdColorRDGTexture;
+			PassParameters->UdDepthTexture = Data.UdDepthRDGTexture;
+		}
+		PassParameters->ParentTexture = Mip0Copy;
+		PassParameters->OutputTexture = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(HZB, 0));
+		PassParameters->OutputSize = Mip0Size;
+		PassParameters->UdSize = UdSize;
+
+		// Each mip 0 texel is the furthest of 2x2 pixels of the view rect, UD renders at the unscaled view size
+		PassParameters->HZBTexelToUd = FVector2f(2.0f * UdSize.X / View.ViewRect.Width(), 2.0f * UdSize.Y / View.ViewRect.Height());
+
+		FUdsHZBMergeCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FUdsHZBMergeCS::FOutputFormatDim>(Data.UdOutputFormat);
+		TShaderMapRef<FUdsHZBMergeCS> ComputeShader(View.ShaderMap, PermutationVector);
+
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Merge %dx%d", Mip0Size.X, Mip0Size.Y), ComputeShader, PassParameters,
+			FComputeShaderUtils::GetGroupCount(Mip0Size, FComputeShaderUtils::kGolden2DGroupSize));
+	}
+
+	TShaderMapRef<FUdsHZBReduceCS> ReduceShader(View.ShaderMap);
+
+	for (int32 Mip = 1; Mip < (int32)HZB->Desc.NumMips; ++Mip)
+	{
+		const FIntPoint ParentSize(FMath::Max(Mip0Size.X >> (Mip - 1), 1), FMath::Max(Mip0Size.Y >> (Mip - 1), 1));
+		const FIntPoint OutputSize(FMath::Max(Mip0Size.X >> Mip, 1), FMath::Max(Mip0Size.Y >> Mip, 1));
+
+		FUdsHZBReduceCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsHZBReduceCS::FParameters>();
+		PassParameters->ParentMip = GraphBuilder.CreateSRV(FRDGTextureSRVDesc::CreateForMipLevel(HZB, Mip - 1));
+		PassParameters->OutputTexture = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(HZB, Mip));
+		PassParameters->OutputSize = OutputSize;
+		PassParameters->ParentSize = ParentSize;
+
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Reduce Mip%d %dx%d", Mip, OutputSize.X, OutputSize.Y), ReduceShader, PassParameters,
+			FComputeShaderUtils::GetGroupCount(OutputSize, FComputeShaderUtils::kGolden2DGroupSize));
+	}
+}
+
+void UpdateUdsCulledPrimitives(const FViewInfo& View)
+{
+	bool bCount = GUdsCountCulledPrimitives;
+#if STATS
+	bCount |= FThreadStats::IsCollectingData(GET_STATID(STAT_UdsCulledPrimitives));
+#endif
+	const FScene* Scene = View.Family->Scene ? View.Family->Scene->GetRenderScene() : nullptr;
+	if (!bCount || !Scene)
+	{
+		return;
+	}
+
+	// Visibility keeps no frustum-only result, so the frustum test is redone here
+	uint32 NumCulled = 0;
+	for (int32 i = 0; i < Scene->PrimitiveBounds.Num(); ++i)
+	{
+		const FBoxSphereBounds& Bounds = Scene->PrimitiveBounds[i].BoxSphereBounds;
+		if (!View.PrimitiveVisibilityMap[i] && View.ViewFrustum.IntersectBox(Bounds.Origin, Bounds.BoxExtent))
+		{
+			++NumCulled;
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_UdsCulledPrimitives, NumCulled);
+
+	if (View.Family->Views[0] == &View)
+	{
+		GUdsLastCulledPrimitives = 0;
+	}
+	GUdsLastCulledPrimitives += NumCulled;
+}
+
+void SetUdsCountCulledPrimitives(bool bEnable)
+{
+	GUdsCountCulledPrimitives = bEnable;
+}
+
+uint32 GetUdsLastCulledPrimitives()
+{
+	return GUdsLastCulledPrimitives;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "RenderGraphBuilder.h"
+
+struct FUdsData;
+class FViewInfo;
+
+// Value of r.Uds.HZB
+bool IsUdsHZBEnabled();
+
+// Merges UD depth into the view's furthest HZB so UD occludes like scene geometry. Call after the HZB is built; the
+// merged HZB becomes next frame's PrevViewInfo.HZB, which Nanite and GPU instance culling test against.
+void AddUdsHZBMergePasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FUdsData& Data);
+
+// Updates the culled primitive counters from the view's CPU visibility, call once the visibility is final. It walks every
+// primitive in the scene, so it only counts while stat UnlimitedDetail is on or SetUdsCountCulledPrimitives asked for it.
+void UpdateUdsCulledPrimitives(const FViewInfo& View);
+void SetUdsCountCulledPrimitives(bool bEnable);
+
+// Culled primitives summed over the views of the last family rendered
+uint32 GetUdsLastCulledPrimitives();
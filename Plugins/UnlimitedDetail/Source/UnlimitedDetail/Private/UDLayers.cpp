@@ -0,0 +1,59 @@
+#include "UDLayers.h"
+#include "Components/ActorComponent.h"
+
+static int32 GUdsLayers = 0;
+static FAutoConsoleVariableRef CVarUdsLayers(
+	TEXT("r.Uds.Layers"),
+	GUdsLayers,
+	TEXT("Splits UD instances into a near and a far layer. The far layer is rendered by its own udRenderContext on a task worker at\n")
+	TEXT("r.Uds.Layers.FarScale, alongside the main render of the near layer, and depth merged into it before upload. Components tagged\n")
+	TEXT("UdsFarLayer or UdsNearLayer stay in that layer, the rest are far beyond r.Uds.Layers.FarDistance.\n")
+	TEXT("Ignored with r.Uds.Checkerboard, r.Uds.Foveated and r.Uds.Stereo. 1 on, 0 off (default)"),
+	ECVF_Default);
+
+static float GUdsLayersFarDistance = 100000.0f;
+static FAutoConsoleVariableRef CVarUdsLayersFarDistance(
+	TEXT("r.Uds.Layers.FarDistance"),
+	GUdsLayersFarDistance,
+	TEXT("Distance from the camera to an untagged instance's origin beyond which it renders in the far layer, in world units (default 100000)"),
+	ECVF_Default);
+
+static float GUdsLayersFarScale = 0.5f;
+static FAutoConsoleVariableRef CVarUdsLayersFarScale(
+	TEXT("r.Uds.Layers.FarScale"),
+	GUdsLayersFarScale,
+	TEXT("Resolution scale of the far layer on each axis, 0.5 is a quarter of the pixels (default 0.5)"),
+	ECVF_Default);
+
+static const FName UdsNearLayerTag(TEXT("UdsNearLayer"));
+static const FName UdsFarLayerTag(TEXT("UdsFarLayer"));
+
+bool IsUdsLayersEnabled()
+{
+	return GUdsLayers > 0;
+}
+
+FIntPoint GetUdsFarLayerSize(const FIntPoint& Size)
+{
+	const float Scale = FMath::Clamp(GUdsLayersFarScale, 0.1f, 1.0f);
+	return FIntPoint(FMath::Max(FMath::CeilToInt(Size.X * Scale), 1), FMath::Max(FMath::CeilToInt(Size.Y * Scale), 1));
+}
+
+EUDRenderLayer GetUdsComponentLayer(const UActorComponent& Component)
+{
+	if (Component.ComponentHasTag(UdsFarLayerTag))
+		return EUDRenderLayer::Far;
+
+	if (Component.ComponentHasTag(UdsNearLayerTag))
+		return EUDRenderLayer::Near;
+
+	return EUDRenderLayer::Auto;
+}
+
+bool IsUdsFarLayerInstance(EUDRenderLayer Layer, const FVector& Origin, const FVector& ViewOrigin)
+{
+	if (Layer != EUDRenderLayer::Auto)
+		return Layer == EUDRenderLayer::Far;
+
+	return FVector::DistSquared(Origin, ViewOrigin) > FMath::Square((double)GUdsLayersFarDistance);
+}
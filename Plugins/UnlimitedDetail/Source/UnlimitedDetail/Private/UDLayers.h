@@ -0,0 +1,18 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UDDefine.h"
+
+class UActorComponent;
+
+// r.Uds.Layers is on. Read on the game thread when a view's UD capture is set up.
+bool IsUdsLayersEnabled();
+
+// Size of the far layer's render for a Size main view
+FIntPoint GetUdsFarLayerSize(const FIntPoint& Size);
+
+// Layer a component's instances are pinned to by its UdsNearLayer / UdsFarLayer tag, Auto without either
+EUDRenderLayer GetUdsComponentLayer(const UActorComponent& Component);
+
+// Whether an instance in Layer, placed at Origin, renders in the far layer of a view at ViewOrigin
+bool IsUdsFarLayerInstance(EUDRenderLayer Layer, const FVector& Origin, const FVector& ViewOrigin);
@@ -0,0 +1,189 @@
+#include "UDOccluderDepth.h"
+#include "UDComposite.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+
+#include "Runtime/Renderer/Private/SceneRendering.h"
+
+static int32 GUdsOccluderDepth = 0;
+static FAutoConsoleVariableRef CVarUdsOccluderDepth(
+	TEXT("r.Uds.OccluderDepth"),
+	GUdsOccluderDepth,
+	TEXT("Seeds the UD depth buffer with the previous frame's scene depth, reprojected, and renders with udRCF_PreserveBuffers\n")
+	TEXT("so udSDK skips voxels hidden behind meshes. Needs a full depth prepass (r.EarlyZPass). 1 on, 0 off (default)"),
+	ECVF_RenderThreadSafe);
+
+static int32 GUdsOccluderDepthDownsample = 4;
+static FAutoConsoleVariableRef CVarUdsOccluderDepthDownsample(
+	TEXT("r.Uds.OccluderDepth.Downsample"),
+	GUdsOccluderDepthDownsample,
+	TEXT("Scene depth is read back at 1 / this resolution, keeping the furthest depth of each block (default 4)"),
+	ECVF_RenderThreadSafe);
+
+static int32 GUdsOccluderDepthMaxAge = 3;
+static FAutoConsoleVariableRef CVarUdsOccluderDepthMaxAge(
+	TEXT("r.Uds.OccluderDepth.MaxAge"),
+	GUdsOccluderDepthMaxAge,
+	TEXT("Oldest readback, in frames, that is still reprojected (default 3)"),
+	ECVF_RenderThreadSafe);
+
+DECLARE_GPU_STAT(UnlimitedDetailOccluderDepth)
+
+///
+/// COMPUTE SHADER
+///
+class FUdsOccluderDepthDownsampleCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsOccluderDepthDownsampleCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsOccluderDepthDownsampleCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float>, SceneDepthTexture)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, OutputTexture)
+		SHADER_PARAMETER(FIntPoint, OutputSize)
+		SHADER_PARAMETER(FIntPoint, ViewRectMin)
+		SHADER_PARAMETER(FIntPoint, ViewRectMax)
+		SHADER_PARAMETER(int32, Downsample)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEX"), FComputeShaderUtils::kGolden2DGroupSize);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEY"), FComputeShaderUtils::kGolden2DGroupSize);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsOccluderDepthDownsampleCS, "/Plugins/UnlimitedDetail/Private/Uds_OccluderDepth.usf", "DownsampleCS", SF_Compute);
+
+FUDOccluderDepthHistory::FUDOccluderDepthHistory()
+{
+}
+
+FUDOccluderDepthHistory::~FUDOccluderDepthHistory()
+{
+}
+
+bool FUDOccluderDepthHistory::IsEnabled()
+{
+	return GUdsOccluderDepth > 0;
+}
+
+void FUDOccluderDepthHistory::PublishReadbacks_RenderThread(uint32 FrameNumber)
+{
+	for (FReadback& Entry : Readbacks)
+	{
+		if (!Entry.bPending || !Entry.Readback->IsReady())
+			continue;
+
+		TSharedPtr<FUDOccluderDepth, ESPMode::ThreadSafe> Depth = MakeShared<FUDOccluderDepth, ESPMode::ThreadSafe>(Entry.Info);
+		Depth->DeviceZ.SetNumUninitialized(Depth->Size.X * Depth->Size.Y);
+
+		int32 RowPitchInPixels = 0;
+		const float* pData = static_cast<const float*>(Entry.Readback->Lock(RowPitchInPixels));
+		if (pData)
+		{
+			for (int32 y = 0; y < Depth->Size.Y; ++y)
+			{
+				FMemory::Memcpy(Depth->DeviceZ.GetData() + y * Depth->Size.X, pData + y * RowPitchInPixels, Depth->Size.X * sizeof(float));
+			}
+		}
+		Entry.Readback->Unlock();
+		Entry.bPending = false;
+
+		if (pData)
+		{
+			FScopeLock ScopeLock(&OccluderDepthMutex);
+
+			// Readbacks can finish out of order, never replace a newer one
+			TSharedPtr<const FUDOccluderDepth, ESPMode::ThreadSafe>& Latest = OccluderDepth.FindOrAdd(Entry.ViewKey);
+			if (!Latest.IsValid() || (int32)(Depth->FrameNumber - Latest->FrameNumber) > 0)
+			{
+				Latest = Depth;
+			}
+		}
+	}
+
+	// Views that stopped rendering, like closed editor viewports and scene captures that went away
+	FScopeLock ScopeLock(&OccluderDepthMutex);
+	for (auto It = OccluderDepth.CreateIterator(); It; ++It)
+	{
+		if ((int32)(FrameNumber - It.Value()->FrameNumber) > UDS_VIEW_STATE_TIMEOUT)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FUDOccluderDepthHistory::Capture_RenderThread(FRDGBuilder& GraphBuilder, const FViewInfo& View, uint32 ViewKey)
+{
+	check(IsInRenderingThread());
+
+	PublishReadbacks_RenderThread(View.Family->FrameNumber);
+
+	FRDGTextureRef SceneDepth = View.GetSceneTextures().Depth.Target;
+	if (!SceneDepth || SceneDepth->Desc.NumSamples > 1)
+		return;
+
+	FReadback* Entry = nullptr;
+	for (FReadback& Candidate : Readbacks)
+	{
+		if (!Candidate.bPending)
+		{
+			Entry = &Candidate;
+			break;
+		}
+	}
+
+	if (!Entry)
+		return;
+
+	RDG_GPU_STAT_SCOPE(GraphBuilder, UnlimitedDetailOccluderDepth);
+
+	const int32 Downsample = FMath::Max(GUdsOccluderDepthDownsample, 1);
+	const FIntPoint OutputSize = FIntPoint::DivideAndRoundUp(View.ViewRect.Size(), Downsample);
+
+	FRDGTextureRef Output = GraphBuilder.CreateTexture(FRDGTextureDesc::Create2D(OutputSize, PF_R32_FLOAT, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV), TEXT("Uds.OccluderDepth"));
+
+	FUdsOccluderDepthDownsampleCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsOccluderDepthDownsampleCS::FParameters>();
+	PassParameters->SceneDepthTexture = SceneDepth;
+	PassParameters->OutputTexture = GraphBuilder.CreateUAV(Output);
+	PassParameters->OutputSize = OutputSize;
+	PassParameters->ViewRectMin = View.ViewRect.Min;
+	PassParameters->ViewRectMax = View.ViewRect.Max;
+	PassParameters->Downsample = Downsample;
+
+	TShaderMapRef<FUdsOccluderDepthDownsampleCS> ComputeShader(View.ShaderMap);
+	FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("UdsOccluderDepth %dx%d", OutputSize.X, OutputSize.Y), ComputeShader, PassParameters,
+		FComputeShaderUtils::GetGroupCount(OutputSize, FComputeShaderUtils::kGolden2DGroupSize));
+
+	if (!Entry->Readback.IsValid())
+	{
+		Entry->Readback = MakeUnique<FRHIGPUTextureReadback>(TEXT("Uds.OccluderDepthReadback"));
+	}
+
+	AddEnqueueCopyPass(GraphBuilder, Entry->Readback.Get(), Output);
+
+	Entry->Info.Size = OutputSize;
+	Entry->Info.ViewRect = View.ViewRect;
+	// Scene depth was rendered jittered with TAA and TSR, but is reprojected as if it were at pixel centres like the UD render it seeds
+	Entry->Info.InvViewProjection = View.ViewMatrices.ComputeInvProjectionNoAAMatrix() * View.ViewMatrices.GetInvViewMatrix();
+	Entry->Info.FrameNumber = View.Family->FrameNumber;
+	Entry->ViewKey = ViewKey;
+	Entry->bPending = true;
+}
+
+TSharedPtr<const FUDOccluderDepth, ESPMode::ThreadSafe> FUDOccluderDepthHistory::GetOccluderDepth_GameThread(uint32 ViewKey, uint32 FrameNumber) const
+{
+	FScopeLock ScopeLock(&OccluderDepthMutex);
+
+	const TSharedPtr<const FUDOccluderDepth, ESPMode::ThreadSafe>* Depth = OccluderDepth.Find(ViewKey);
+	if (!Depth || FrameNumber - (*Depth)->FrameNumber > (uint32)FMath::Max(GUdsOccluderDepthMaxAge, 0))
+		return nullptr;
+
+	return *Depth;
+}
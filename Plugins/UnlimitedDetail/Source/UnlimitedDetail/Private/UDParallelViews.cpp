@@ -0,0 +1,22 @@
+#include "UDParallelViews.h"
+#include "Async/TaskGraphInterfaces.h"
+
+static int32 GUdsParallelViews = 0;
+static FAutoConsoleVariableRef CVarUdsParallelViews(
+	TEXT("r.Uds.ParallelViews"),
+	GUdsParallelViews,
+	TEXT("Renders the views of a family after the first (split-screen, multiple monitors) on task workers, each with its own udRenderContext\n")
+	TEXT("and target, while the game thread renders the first. The value is the most workers used at once, capped to leave the game and render\n")
+	TEXT("threads a core each; -1 uses that cap. Ignored with r.Uds.Temporal, r.Uds.Checkerboard, r.Uds.RenderRate and r.Uds.Progressive.\n")
+	TEXT("0 renders views one after another (default)"),
+	ECVF_Default);
+
+int32 GetUdsParallelViewWorkers()
+{
+	if (GUdsParallelViews == 0)
+		return 0;
+
+	// udSDK renders are heavy and long, workers beyond this start taking time from the game and render threads
+	const int32 MaxWorkers = FMath::Max(FTaskGraphInterface::Get().GetNumWorkerThreads() - 2, 1);
+	return GUdsParallelViews < 0 ? MaxWorkers : FMath::Min(GUdsParallelViews, MaxWorkers);
+}
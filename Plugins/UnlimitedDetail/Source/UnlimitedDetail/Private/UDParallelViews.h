@@ -0,0 +1,6 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Workers r.Uds.ParallelViews allows to render views 1 and up of a family, 0 when views are captured one after another
+int32 GetUdsParallelViewWorkers();
@@ -0,0 +1,195 @@
+#include "UDReprojection.h"
+#include "Subpasses/UdsData.h"
+#include "RenderGraphUtils.h"
+#include "SceneView.h"
+
+static float GUdsRenderRate = 0.0f;
+static FAutoConsoleVariableRef CVarUdsRenderRate(
+	TEXT("r.Uds.RenderRate"),
+	GUdsRenderRate,
+	TEXT("Renders UD this many times per second on a background task instead of every frame; in between, the last image is\n")
+	TEXT("reprojected to the current camera on the GPU. Moving instances only update at this rate. 0 renders every frame (default)"),
+	ECVF_Default);
+
+static int32 GUdsRenderRateHoleFill = 1;
+static FAutoConsoleVariableRef CVarUdsRenderRateHoleFill(
+	TEXT("r.Uds.RenderRate.HoleFill"),
+	GUdsRenderRateHoleFill,
+	TEXT("Pixels the reprojection leaves empty take the furthest surface within this many pixels, 0 leaves them empty (default 1)"),
+	ECVF_RenderThreadSafe);
+
+DECLARE_GPU_STAT(UnlimitedDetailReprojection)
+
+BEGIN_SHADER_PARAMETER_STRUCT(FUdsReprojectParameters, )
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdColorTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, UdDepthTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D<uint>, UdPackedTexture)
+	SHADER_PARAMETER(FMatrix44f, SourceClipToClip)
+	SHADER_PARAMETER(FUintVector2, Size)
+	SHADER_PARAMETER(uint32, HoleFillRadius)
+END_SHADER_PARAMETER_STRUCT()
+
+///
+/// COMPUTE SHADERS
+///
+class FUdsReprojectShader : public FGlobalShader
+{
+public:
+	class FOutputFormatDim : SHADER_PERMUTATION_ENUM_CLASS("UDS_OUTPUT_FORMAT", EUDOutputFormat);
+	using FPermutationDomain = TShaderPermutationDomain<FOutputFormatDim>;
+
+	FUdsReprojectShader() = default;
+	FUdsReprojectShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer) {}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEX"), FComputeShaderUtils::kGolden2DGroupSize);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEY"), FComputeShaderUtils::kGolden2DGroupSize);
+	}
+};
+
+class FUdsReprojectSplatDepthCS : public FUdsReprojectShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsReprojectSplatDepthCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsReprojectSplatDepthCS, FUdsReprojectShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FUdsReprojectParameters, Reproject)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<uint>, RWSplatDepth)
+	END_SHADER_PARAMETER_STRUCT()
+};
+
+class FUdsReprojectSplatSourceCS : public FUdsReprojectShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsReprojectSplatSourceCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsReprojectSplatSourceCS, FUdsReprojectShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FUdsReprojectParameters, Reproject)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<uint>, SplatDepth)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<uint>, RWSplatSource)
+	END_SHADER_PARAMETER_STRUCT()
+};
+
+class FUdsReprojectResolveCS : public FUdsReprojectShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsReprojectResolveCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsReprojectResolveCS, FUdsReprojectShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FUdsReprojectParameters, Reproject)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<uint>, SplatDepth)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<uint>, SplatSource)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, RWUdColor)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, RWUdDepth)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<uint>, RWUdPacked)
+	END_SHADER_PARAMETER_STRUCT()
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsReprojectSplatDepthCS, "/Plugins/UnlimitedDetail/Private/Uds_Reproject.usf", "SplatDepthCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FUdsReprojectSplatSourceCS, "/Plugins/UnlimitedDetail/Private/Uds_Reproject.usf", "SplatSourceCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FUdsReprojectResolveCS, "/Plugins/UnlimitedDetail/Private/Uds_Reproject.usf", "ResolveCS", SF_Compute);
+
+bool IsUdsRenderDecoupled()
+{
+	return GUdsRenderRate > 0.0f;
+}
+
+float GetUdsRenderRate()
+{
+	return FMath::Max(GUdsRenderRate, 1.0f);
+}
+
+FMatrix GetUdsReprojectionClipToClip(const FMatrix& SourceViewProjection, const FMatrix& ViewProjection)
+{
+	return SourceViewProjection.Inverse() * ViewProjection;
+}
+
+void AddUdsReprojectionPasses(FRDGBuilder& GraphBuilder, const FSceneView& View, FUdsData& Data)
+{
+	check(Data.UdColorRDGTexture);
+
+	RDG_GPU_STAT_SCOPE(GraphBuilder, UnlimitedDetailReprojection);
+	RDG_EVENT_SCOPE(GraphBuilder, "UdsReprojection");
+
+	const FIntPoint Size = Data.UdColorRDGTexture->Desc.Extent;
+	const bool bPacked = Data.UdOutputFormat == EUDOutputFormat::Packed;
+	FGlobalShaderMap* ShaderMap = GetGlobalShaderMap(View.GetFeatureLevel());
+
+	FUdsReprojectShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FUdsReprojectShader::FOutputFormatDim>(Data.UdOutputFormat);
+
+	FUdsReprojectParameters Reproject;
+	if (bPacked)
+	{
+		Reproject.UdPackedTexture = Data.UdColorRDGTexture;
+	}
+	else
+	{
+		Reproject.UdColorTexture = Data.UdColorRDGTexture;
+		Reproject.UdDepthTexture = Data.UdDepthRDGTexture;
+	}
+	Reproject.SourceClipToClip = FMatrix44f(Data.UdReprojection.SourceClipToClip);
+	Reproject.Size = FUintVector2(Size.X, Size.Y);
+	Reproject.HoleFillRadius = FMath::Clamp(GUdsRenderRateHoleFill, 0, 4);
+
+	const FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(Size, FComputeShaderUtils::kGolden2DGroupSize);
+
+	FRDGTextureDesc SplatDesc = FRDGTextureDesc::Create2D(Size, PF_R32_UINT, FClearValueBinding::Black, TexCreate_ShaderResource | TexCreate_UAV);
+	FRDGTextureRef SplatDepth = GraphBuilder.CreateTexture(SplatDesc, TEXT("Uds.ReprojectSplatDepth"));
+	FRDGTextureRef SplatSource = GraphBuilder.CreateTexture(SplatDesc, TEXT("Uds.ReprojectSplatSource"));
+
+	AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(SplatDepth), 0u);
+
+	{
+		FUdsReprojectSplatDepthCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsReprojectSplatDepthCS::FParameters>();
+		PassParameters->Reproject = Reproject;
+		PassParameters->RWSplatDepth = GraphBuilder.CreateUAV(SplatDepth);
+
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("SplatDepth %dx%d", Size.X, Size.Y),
+			TShaderMapRef<FUdsReprojectSplatDepthCS>(ShaderMap, PermutationVector), PassParameters, GroupCount);
+	}
+
+	{
+		FUdsReprojectSplatSourceCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsReprojectSplatSourceCS::FParameters>();
+		PassParameters->Reproject = Reproject;
+		PassParameters->SplatDepth = SplatDepth;
+		PassParameters->RWSplatSource = GraphBuilder.CreateUAV(SplatSource);
+
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("SplatSource"),
+			TShaderMapRef<FUdsReprojectSplatSourceCS>(ShaderMap, PermutationVector), PassParameters, GroupCount);
+	}
+
+	// Same formats as the upload, every pass reading UD decodes the warped image unchanged
+	FRDGTextureRef OutputColor = GraphBuilder.CreateTexture(Data.UdColorRDGTexture->Desc, TEXT("Uds.ReprojectedColor"));
+	FRDGTextureRef OutputDepth = bPacked ? nullptr : GraphBuilder.CreateTexture(Data.UdDepthRDGTexture->Desc, TEXT("Uds.ReprojectedDepth"));
+
+	{
+		FUdsReprojectResolveCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsReprojectResolveCS::FParameters>();
+		PassParameters->Reproject = Reproject;
+		PassParameters->SplatDepth = SplatDepth;
+		PassParameters->SplatSource = SplatSource;
+		if (bPacked)
+		{
+			PassParameters->RWUdPacked = GraphBuilder.CreateUAV(OutputColor);
+		}
+		else
+		{
+			PassParameters->RWUdColor = GraphBuilder.CreateUAV(OutputColor);
+			PassParameters->RWUdDepth = GraphBuilder.CreateUAV(OutputDepth);
+		}
+
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Resolve"),
+			TShaderMapRef<FUdsReprojectResolveCS>(ShaderMap, PermutationVector), PassParameters, GroupCount);
+	}
+
+	Data.UdColorRDGTexture = OutputColor;
+	Data.UdDepthRDGTexture = OutputDepth;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "RenderGraphBuilder.h"
+
+struct FUdsData;
+class FSceneView;
+
+// r.Uds.RenderRate is above 0: udSDK renders at that rate on a background task and the last image is reprojected in between
+bool IsUdsRenderDecoupled();
+
+// Renders per second with r.Uds.RenderRate, only meaningful when IsUdsRenderDecoupled
+float GetUdsRenderRate();
+
+// FUDReprojection::SourceClipToClip, from the clip space of the camera the image was rendered for to this frame's.
+// Both view projections are UE's reversed Z rather than what udSDK was given, the shaders decode UD depth to UE's device Z first.
+FMatrix GetUdsReprojectionClipToClip(const FMatrix& SourceViewProjection, const FMatrix& ViewProjection);
+
+// Forward warps the UD textures from the camera they were rendered for to this frame's, with hole filling.
+// Replaces the view's UD RDG textures with the warped ones, every later pass reads those.
+void AddUdsReprojectionPasses(FRDGBuilder& GraphBuilder, const FSceneView& View, FUdsData& Data);
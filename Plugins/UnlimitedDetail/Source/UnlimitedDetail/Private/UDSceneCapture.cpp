@@ -0,0 +1,50 @@
+#include "UDSceneCapture.h"
+#include "UDSubsystem.h"
+#include "UDEditorViewports.h"
+
+static int32 GUdsSceneCapture = 1;
+static FAutoConsoleVariableRef CVarUdsSceneCapture(
+	TEXT("r.Uds.SceneCapture"),
+	GUdsSceneCapture,
+	TEXT("UD in scene captures (minimaps, in-world monitors, planar reflections).\n")
+	TEXT(" 0: off, captures show no UD\n")
+	TEXT(" 1: each capture has a target of its own at r.Uds.SceneCapture.ScreenPercentage, re-rendered only when its camera or the UD\n")
+	TEXT("    instances changed or it is still streaming, at most every r.Uds.SceneCapture.Interval frames and r.Uds.SceneCapture.MaxPerFrame captures a frame (default)\n")
+	TEXT(" 2: captured like any other view, through the main target, which is resized to each capture in turn"),
+	ECVF_Default);
+
+static float GUdsSceneCaptureScreenPercentage = 50.0f;
+static FAutoConsoleVariableRef CVarUdsSceneCaptureScreenPercentage(
+	TEXT("r.Uds.SceneCapture.ScreenPercentage"),
+	GUdsSceneCaptureScreenPercentage,
+	TEXT("Resolution of a capture's UD target as a percentage of the capture's (default 50)"),
+	ECVF_Default);
+
+static int32 GUdsSceneCaptureInterval = 4;
+static FAutoConsoleVariableRef CVarUdsSceneCaptureInterval(
+	TEXT("r.Uds.SceneCapture.Interval"),
+	GUdsSceneCaptureInterval,
+	TEXT("Fewest frames between two UD renders of one scene capture; in between it shows its last image (default 4)"),
+	ECVF_Default);
+
+static int32 GUdsSceneCaptureMaxPerFrame = 2;
+static FAutoConsoleVariableRef CVarUdsSceneCaptureMaxPerFrame(
+	TEXT("r.Uds.SceneCapture.MaxPerFrame"),
+	GUdsSceneCaptureMaxPerFrame,
+	TEXT("Most scene capture UD renders in one frame, counting unfocused editor viewports rendered before them; the rest wait for a later one (default 2)"),
+	ECVF_Default);
+
+EUDSceneCaptureMode GetUdsSceneCaptureMode()
+{
+	return (EUDSceneCaptureMode)FMath::Clamp(GUdsSceneCapture, 0, (int32)EUDSceneCaptureMode::MAX - 1);
+}
+
+FUDThrottle GetUdsSceneCaptureThrottle()
+{
+	FUDThrottle Throttle;
+	Throttle.ResolutionFraction = FMath::Clamp(GUdsSceneCaptureScreenPercentage, 10.0f, 100.0f) / 100.0f;
+	Throttle.Interval = FMath::Max(GUdsSceneCaptureInterval, 1);
+	Throttle.MaxPerFrame = FMath::Max(GUdsSceneCaptureMaxPerFrame, 1);
+	Throttle.bPaused = IsUdsEditorPaused();
+	return Throttle;
+}
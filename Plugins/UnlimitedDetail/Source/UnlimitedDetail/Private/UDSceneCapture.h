@@ -0,0 +1,20 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FUDThrottle;
+
+// How scene capture views (USceneCaptureComponent2D, planar reflections, render-to-texture) get their UD, see r.Uds.SceneCapture
+enum class EUDSceneCaptureMode : uint8
+{
+	Off,		// No UD in captures
+	Throttled,	// A reduced resolution target per capture, re-rendered only when it changed and at most every r.Uds.SceneCapture.Interval frames
+	Shared,		// Captured like any other view, into the main target
+
+	MAX
+};
+
+EUDSceneCaptureMode GetUdsSceneCaptureMode();
+
+// Resolution, interval and per frame budget of a capture's throttled target
+FUDThrottle GetUdsSceneCaptureThrottle();
@@ -3,14 +3,36 @@
 #include "GlobalShader.h"
 #include "SceneView.h"
 #include "PixelShaderUtils.h"
+#include "RenderGraphUtils.h"
 
 #include "UDComposite.h"
+#include "UDDepthPrepass.h"
+#include "UDHZB.h"
+#include "UDOccluderDepth.h"
+#include "UDTemporal.h"
+#include "UDReprojection.h"
+#include "UDCheckerboard.h"
+#include "UDSceneCapture.h"
+#include "UDEditorViewports.h"
 #include "PostProcess/SceneRenderTargets.h"
+#include "Runtime/Renderer/Private/SceneRendering.h"
 
 FUDSceneViewExtension::FUDSceneViewExtension(const FAutoRegister& AutoRegister) :
 	FSceneViewExtensionBase(AutoRegister)
 {	
+	CompositeState = MakeShared<FUdsCompositeState, ESPMode::ThreadSafe>(EUdsMode::PostProcessingOnly);
+	OccluderDepthHistory = MakeShared<FUDOccluderDepthHistory, ESPMode::ThreadSafe>();
+	CheckerboardScoring = MakeShared<FUDCheckerboardScoring, ESPMode::ThreadSafe>();
+}
+
+FUDCheckerboardQuality FUDSceneViewExtension::ConsumeCheckerboardQuality()
+{
+	return CheckerboardScoring->ConsumeQuality();
+}
 
+uint32 FUDSceneViewExtension::GetNumCompositeAllocations() const
+{
+	return CompositeState->GetNumAllocations();
 }
 
 
@@ -38,9 +60,49 @@ void FUDSceneViewExtension::BeginRenderViewFamily(FSceneViewFamily& InViewFamily
 		return;
 	}
 
+	// Minimaps, in-world monitors and reflections; by default on throttled targets of their own rather than the main one
+	const bool bSceneCapture = InViewFamily.Views[0] && InViewFamily.Views[0]->bIsSceneCapture;
+	const EUDSceneCaptureMode SceneCaptureMode = bSceneCapture ? GetUdsSceneCaptureMode() : EUDSceneCaptureMode::Shared;
+	if (SceneCaptureMode == EUDSceneCaptureMode::Off)
+	{
+		return;
+	}
+
+	// Likewise the level editor's viewports other than the focused one, which keeps the main target to itself
+	const bool bEditorViewport = InViewFamily.Views[0] && IsUdsEditorViewport(*InViewFamily.Views[0]);
+	const bool bEditorPolicy = bEditorViewport && GetUdsEditorViewportPolicy() != EUDEditorViewportPolicy::All;
+	const bool bFocusedEditorViewport = bEditorPolicy && IsUdsFocusedEditorViewport(*InViewFamily.Views[0]);
+	const bool bThrottledEditorViewport = bEditorPolicy && !bFocusedEditorViewport;
+
+	// With the editor in the background nothing is rendered, every view composites whatever image its target already holds
+	const bool bEditorPaused = (bSceneCapture || bEditorViewport) && IsUdsEditorPaused();
+
 	if (InViewFamily.GetFeatureLevel() >= ERHIFeatureLevel::SM5)
 	{
-		TArray<TSharedPtr<FUdsData>> ViewData;
+		bool bAnyCoverage = false;
+		const bool bTemporal = IsUdsTemporalEnabled();
+		EUDDepthPrepass DepthPrepass = GetUdsDepthPrepassMode();
+
+		// TSR / TAA reproject UD pixels with scene depth, so it has to be in there
+		if (bTemporal && DepthPrepass == EUDDepthPrepass::Off)
+		{
+			DepthPrepass = EUDDepthPrepass::Depth;
+		}
+
+		const bool bThrottled = SceneCaptureMode == EUDSceneCaptureMode::Throttled || bThrottledEditorViewport;
+		const FUDThrottle Throttle = bThrottledEditorViewport ? GetUdsEditorViewportThrottle() : GetUdsSceneCaptureThrottle();
+
+		// Both eyes in one capture, the second reusing the first's traversal
+		const bool bStereoPair = !bThrottled && InViewFamily.Views.Num() == 2 && InViewFamily.Views[0] && InViewFamily.Views[1] &&
+			MySubsystem->CanCaptureStereo(*InViewFamily.Views[0], *InViewFamily.Views[1]);
+
+		// Otherwise every view after the first renders on a worker while the first is captured here
+		const bool bParallel = !bThrottled && !bStereoPair && MySubsystem->CanCaptureParallel(InViewFamily);
+		TArray<TPair<int32, FUdsData*>, TInlineAllocator<4>> ParallelViews;
+		if (bParallel && !bEditorPaused)
+		{
+			MySubsystem->BeginParallelCapture(InViewFamily);
+		}
 
 		for (int i = 0; i < InViewFamily.Views.Num(); i++)
 		{
@@ -48,16 +110,205 @@ void FUDSceneViewExtension::BeginRenderViewFamily(FSceneViewFamily& InViewFamily
 
 			if (ensure(InView))
 			{
-				FUdsData* Data = new FUdsData();
-				MySubsystem->CaptureUDSImage(*InView);
-				Data->UdColorTexture = MySubsystem->GetColorTexture();
-				Data->UdDepthTexture = MySubsystem->GetDepthTexture();
+				FUdsData* Data = CompositeState->BeginViewFrame_GameThread(*InView, i);
+
+				TSharedPtr<const FUDOccluderDepth, ESPMode::ThreadSafe> OccluderDepth;
+				if (FUDOccluderDepthHistory::IsEnabled())
+				{
+					OccluderDepth = OccluderDepthHistory->GetOccluderDepth_GameThread(FUdsCompositeState::GetViewKey(*InView, i), InViewFamily.FrameNumber);
+				}
+
+				if (bThrottled)
+				{
+					// Its own target, holding the last image until the view changes and its turn comes round
+					const uint32 ViewKey = FUdsCompositeState::GetViewKey(*InView, i);
+					const FUDViewTarget* Target = MySubsystem->CaptureThrottledView(*InView, ViewKey, Throttle);
+					if (Target)
+					{
+						Data->UdColorTexture = Target->ColorTexture;
+						Data->UdDepthTexture = Target->DepthTexture;
+						Data->UdUpload = MySubsystem->TakeThrottledUpload(ViewKey);
+						Data->UdOutputFormat = Target->Format;
+						Data->UdCoverage = Target->Coverage;
+						Data->UdDepthPrepass = DepthPrepass;
+
+						// Rendered unjittered, but with r.Uds.Temporal there's no composite after TSR, it has to go into scene color too
+						Data->bUdTemporal = bTemporal;
+						Data->UdJitter = FVector2f::ZeroVector;
+
+						bAnyCoverage |= Target->ColorTexture.IsValid() && Data->UdCoverage.bHasCoverage;
+					}
+					continue;
+				}
+
+				// The second eye of a stereo pair was captured along with the first, into textures of its own
+				const bool bStereoEye = bStereoPair && i == 1;
+				if (bParallel && i > 0)
+				{
+					// Picked up once the workers are done, after view 0
+					ParallelViews.Emplace(i, Data);
+					continue;
+				}
+				else if (!bStereoEye && !bEditorPaused)
+				{
+					MySubsystem->CaptureUDSImage(*InView, OccluderDepth.Get(), bStereoPair ? InViewFamily.Views[1] : nullptr);
+				}
+
+				Data->UdColorTexture = bStereoEye ? MySubsystem->GetStereoColorTexture() : MySubsystem->GetColorTexture();
+				Data->UdDepthTexture = bStereoEye ? MySubsystem->GetStereoDepthTexture() : MySubsystem->GetDepthTexture();
+				Data->UdUpload = bStereoEye ? MySubsystem->TakeStereoUpload() : MySubsystem->TakeUpload();
+				Data->UdOutputFormat = MySubsystem->GetOutputFormat();
+				Data->UdCoverage = bStereoEye ? MySubsystem->GetStereoCoverage() : MySubsystem->GetCoverage();
+				Data->UdDepthPrepass = DepthPrepass;
+				Data->bUdTemporal = bTemporal;
+				Data->UdJitter = MySubsystem->GetJitter();
+				Data->UdInstanceMotion = MySubsystem->GetInstanceMotion();
+				Data->UdReprojection = MySubsystem->GetReprojection();
+				Data->UdCheckerboard = MySubsystem->GetCheckerboard();
+				Data->UdCheckerboardReference = MySubsystem->GetCheckerboardReference();
+
+				bAnyCoverage |= MySubsystem->IsValid() && Data->UdCoverage.bHasCoverage;
+			}
+		}
+
+		// Waited for whichever views made it through the loop, the workers render every view after the first regardless
+		if (bParallel)
+		{
+			if (!bEditorPaused)
+			{
+				MySubsystem->FinishParallelCapture();
+			}
+
+			for (const TPair<int32, FUdsData*>& ParallelView : ParallelViews)
+			{
+				FUdsData* Data = ParallelView.Value;
+				const FUDViewTarget* Target = MySubsystem->GetParallelView(ParallelView.Key);
+				if (!Target)
+					continue;
+
+				Data->UdColorTexture = Target->ColorTexture;
+				Data->UdDepthTexture = Target->DepthTexture;
+				Data->UdUpload = MySubsystem->TakeParallelUpload(ParallelView.Key);
+				Data->UdOutputFormat = Target->Format;
+				Data->UdCoverage = Target->Coverage;
+				Data->UdDepthPrepass = DepthPrepass;
+				Data->bUdTemporal = bTemporal;
+				Data->UdJitter = FVector2f::ZeroVector;
+
+				bAnyCoverage |= Target->ColorTexture.IsValid() && Data->UdCoverage.bHasCoverage;
+			}
+		}
+
+		// Don't install the composite at all when every UD instance is off-screen, culled or empty, or when UD already went into the scene before post processing
+		if (bAnyCoverage && DepthPrepass != EUDDepthPrepass::GBuffer && !bTemporal)
+			InViewFamily.SetSecondarySpatialUpscalerInterface(new FUDComposite(CompositeState.ToSharedRef()));
+
+		CompositeState->EndFrame_GameThread(InViewFamily.FrameNumber);
+	}
+}
+
+void FUDSceneViewExtension::PreRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily)
+{
+	RenderingViewFamily = &InViewFamily;
+
+	// Uploads go in first and in view order, every pass that reads the UD textures later in the frame is then ordered after them by RDG
+	for (const FSceneView* View : InViewFamily.Views)
+	{
+		FUdsData* Data = CompositeState->FindViewData_RenderThread(*View);
+		if (!Data)
+			continue;
+
+		FUDTextureUploader::AddUploadPasses(GraphBuilder, Data->UdUpload);
+		Data->UdUpload.Reset();
+
+		if (Data->UdColorTexture.IsValid())
+		{
+			Data->UdColorRDGTexture = FUDTextureUploader::RegisterTexture(GraphBuilder, Data->UdColorTexture);
+		}
+		if (Data->UdDepthTexture.IsValid())
+		{
+			Data->UdDepthRDGTexture = FUDTextureUploader::RegisterTexture(GraphBuilder, Data->UdDepthTexture);
+		}
 
-				ViewData.Add(TSharedPtr<FUdsData>(Data));
+		// With checkerboard rendering half the pixels are from the previous frame, rebuilt before anything reads them
+		if (Data->UdCheckerboard.bEnabled && Data->UdColorRDGTexture)
+		{
+			AddUdsCheckerboardPasses(GraphBuilder, *View, *Data, *CheckerboardScoring);
+		}
 
-				if (MySubsystem->IsValid())
-					InViewFamily.SetSecondarySpatialUpscalerInterface(new FUDComposite(EUdsMode::PostProcessingOnly, ViewData));
+		// With a decoupled render rate the textures hold an older camera's image, everything after sees it warped to this one
+		if (Data->UdReprojection.bEnabled && Data->UdColorRDGTexture)
+		{
+			AddUdsReprojectionPasses(GraphBuilder, *View, *Data);
+		}
+	}
+}
+
+void FUDSceneViewExtension::PreRenderBasePass_RenderThread(FRDGBuilder& GraphBuilder, bool bDepthBufferIsPopulated)
+{
+	if (!RenderingViewFamily)
+		return;
+
+	for (int32 i = 0; i < RenderingViewFamily->Views.Num(); ++i)
+	{
+		const FSceneView* View = RenderingViewFamily->Views[i];
+
+		// Views handed to the extensions by the deferred renderer are always FViewInfo
+		const FViewInfo& ViewInfo = static_cast<const FViewInfo&>(*View);
+		const FUdsData* Data = CompositeState->FindViewData_RenderThread(*View);
+
+		// Visibility is final by now
+		UpdateUdsCulledPrimitives(ViewInfo);
+
+		// Read back before UD depth goes in, UD shouldn't occlude itself next frame
+		if (bDepthBufferIsPopulated && FUDOccluderDepthHistory::IsEnabled())
+		{
+			OccluderDepthHistory->Capture_RenderThread(GraphBuilder, ViewInfo, FUdsCompositeState::GetViewKey(*View, i));
+		}
+
+		if (Data && Data->UdDepthPrepass != EUDDepthPrepass::Off && Data->UdCoverage.bHasCoverage && Data->UdColorRDGTexture)
+		{
+			AddUdsDepthPrepass(GraphBuilder, ViewInfo, *Data, ViewInfo.GetSceneTextures().Depth.Target);
+
+			// Needed for instances that moved, or to clear what meshes now hidden behind UD wrote in the depth pass
+			FRDGTextureRef VelocityTexture = ViewInfo.GetSceneTextures().Velocity;
+			if (IsUdsVelocityEnabled() && VelocityTexture && (Data->UdInstanceMotion.Num() > 0 || HasBeenProduced(VelocityTexture)))
+			{
+				AddUdsVelocityPass(GraphBuilder, ViewInfo, *Data, VelocityTexture, ViewInfo.GetSceneTextures().Depth.Target);
 			}
 		}
 	}
 }
+
+void FUDSceneViewExtension::PostRenderBasePassDeferred_RenderThread(FRDGBuilder& GraphBuilder, FSceneView& InView, const FRenderTargetBindingSlots& RenderTargets, TRDGUniformBufferRef<FSceneTextureUniformParameters> SceneTextures)
+{
+	const FUdsData* Data = CompositeState->FindViewData_RenderThread(InView);
+
+	if (Data && Data->UdDepthPrepass == EUDDepthPrepass::GBuffer && Data->UdCoverage.bHasCoverage && Data->UdColorRDGTexture)
+	{
+		AddUdsGBufferPass(GraphBuilder, static_cast<const FViewInfo&>(InView), *Data, RenderTargets);
+	}
+}
+
+void FUDSceneViewExtension::PrePostProcessPass_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& View, const FPostProcessingInputs& Inputs)
+{
+	const FUdsData* Data = CompositeState->FindViewData_RenderThread(View);
+
+	// Last chance to be in scene color before TSR / TAA; the GBuffer mode has already put it there
+	if (Data && Data->bUdTemporal && Data->UdDepthPrepass == EUDDepthPrepass::Depth && Data->UdCoverage.bHasCoverage && Data->UdColorRDGTexture)
+	{
+		const FViewInfo& ViewInfo = static_cast<const FViewInfo&>(View);
+		AddUdsSceneColorPass(GraphBuilder, ViewInfo, *Data, Inputs.SceneTextures->GetParameters()->SceneColorTexture, ViewInfo.GetSceneTextures().Depth.Target);
+	}
+
+	// The HZB is complete by now; merging here means it is UD aware when it's carried into next frame's culling
+	if (Data && IsUdsHZBEnabled() && Data->UdCoverage.bHasCoverage && Data->UdColorRDGTexture)
+	{
+		AddUdsHZBMergePasses(GraphBuilder, static_cast<const FViewInfo&>(View), *Data);
+	}
+}
+
+void FUDSceneViewExtension::PostRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily)
+{
+	RenderingViewFamily = nullptr;
+}
@@ -0,0 +1,18 @@
+#include "UDStaticCache.h"
+
+static int32 GUdsStaticCache = 0;
+static FAutoConsoleVariableRef CVarUdsStaticCache(
+	TEXT("r.Uds.StaticCache"),
+	GUdsStaticCache,
+	TEXT("Keeps the render of the static UD instances (components without Dynamic set) while the camera, render size and static instances\n")
+	TEXT("stay the same; each frame starts from that copy and renders only the dynamic instances over it with udRCF_PreserveBuffers.\n")
+	TEXT("The copy is made on the second frame they hold, with udRCF_BlockingStreaming so it isn't stuck at the LOD streamed so far.\n")
+	TEXT("Never hits with r.Uds.Temporal, whose jitter moves the camera every frame. Ignored with r.Uds.Checkerboard, r.Uds.Foveated,\n")
+	TEXT("r.Uds.Stereo, r.Uds.Layers and r.Uds.Tiles; turns off r.Uds.OccluderDepth, cached depth can't depend on the scene's.\n")
+	TEXT("1 on, 0 off (default)"),
+	ECVF_Default);
+
+bool IsUdsStaticCacheEnabled()
+{
+	return GUdsStaticCache > 0;
+}
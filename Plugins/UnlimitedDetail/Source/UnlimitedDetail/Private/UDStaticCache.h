@@ -0,0 +1,6 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// r.Uds.StaticCache is on. Read on the game thread when a view's UD capture is set up.
+bool IsUdsStaticCacheEnabled();
@@ -0,0 +1,36 @@
+#include "UDStereo.h"
+#include "SceneView.h"
+#include "StereoRendering.h"
+
+static int32 GUdsStereo = 0;
+static FAutoConsoleVariableRef CVarUdsStereo(
+	TEXT("r.Uds.Stereo"),
+	GUdsStereo,
+	TEXT("Renders both eyes of a stereo frame in one capture, each into its own target and textures; the second eye reuses the first\n")
+	TEXT("eye's octree traversal with udRCF_NoTraversal. Ignored with r.Uds.Temporal, r.Uds.Checkerboard, r.Uds.Foveated and r.Uds.RenderRate.\n")
+	TEXT(" 0: off, every eye is a full traversal and render of its own (default)\n")
+	TEXT(" 1: the second eye reuses the first eye's traversal\n")
+	TEXT(" 2: as 1, with the first eye's traversal widened by r.Uds.Stereo.TraversalMargin to cover the second eye's frustum too"),
+	ECVF_Default);
+
+static float GUdsStereoTraversalMargin = 10.0f;
+static FAutoConsoleVariableRef CVarUdsStereoTraversalMargin(
+	TEXT("r.Uds.Stereo.TraversalMargin"),
+	GUdsStereoTraversalMargin,
+	TEXT("With r.Uds.Stereo 2, how far the first eye's traversal reaches past its right edge, as a percentage of its width (default 10)"),
+	ECVF_Default);
+
+bool IsUdsStereoPair(const FSceneView& First, const FSceneView& Second)
+{
+	return GUdsStereo > 0 &&
+		IStereoRendering::IsAPrimaryView(First) && IStereoRendering::IsASecondaryView(Second) &&
+		First.UnconstrainedViewRect.Size() == Second.UnconstrainedViewRect.Size();
+}
+
+int32 GetUdsStereoTraversalMargin(int32 Width)
+{
+	if (GUdsStereo < 2)
+		return 0;
+
+	return FMath::CeilToInt(Width * FMath::Clamp(GUdsStereoTraversalMargin, 0.0f, 100.0f) / 100.0f);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSceneView;
+
+// r.Uds.Stereo is on and First and Second are the two eyes of one stereo frame, at the same size. Read on the game thread.
+bool IsUdsStereoPair(const FSceneView& First, const FSceneView& Second);
+
+// Columns the first eye's render is widened by towards the second, so one traversal covers both frustums; 0 unless r.Uds.Stereo is 2
+int32 GetUdsStereoTraversalMargin(int32 Width);
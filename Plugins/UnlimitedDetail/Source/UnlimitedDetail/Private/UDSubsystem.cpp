@@ -6,8 +6,21 @@
 #include "UDSettings.h"
 #include "UDSceneViewExtension.h"
 #include "UDDefine.h"
+#include "UDBufferKernels.h"
+#include "UDTemporal.h"
+#include "UDDepthPrepass.h"
+#include "UDReprojection.h"
+#include "UDCheckerboard.h"
+#include "UDFoveated.h"
+#include "UDStereo.h"
+#include "UDParallelViews.h"
+#include "UDTiles.h"
+#include "UDLayers.h"
+#include "UDStaticCache.h"
+#include "UDComposite.h"
 #include "udContext.h"
 #include "Misc/MessageDialog.h"
+#include "Async/Async.h"
 
 uint32_t vcVoxelShader_Black(udPointCloud* /*pPointCloud*/, const udVoxelID* /*pVoxelID*/, const void* pUserData)
 {
@@ -22,6 +35,108 @@ uint32_t vcVoxelShader_Colour(udPointCloud* pPointCloud, const udVoxelID* pVoxel
 	return (0xffffff & color);
 }
 
+// Puts the instance's velocity tag in the alpha of whatever color its own shader picked
+uint32_t vcVoxelShader_Motion(udPointCloud* pPointCloud, const udVoxelID* pVoxelID, const void* pUserData)
+{
+	const FUDMotionVoxelShader* pMotion = (const FUDMotionVoxelShader*)pUserData;
+
+	return (0xffffff & pMotion->pVoxelShader(pPointCloud, pVoxelID, pMotion->pVoxelUserData)) | (pMotion->Tag << 24);
+}
+
+static int32 GUdsOutputFormat = 0;
+static FAutoConsoleVariableRef CVarUdsOutputFormat(
+	TEXT("r.Uds.OutputFormat"),
+	GUdsOutputFormat,
+	TEXT("Format the UD output is uploaded in.\n")
+	TEXT(" 0: R8G8B8A8 color + R32 float depth, 8 bytes per pixel (default)\n")
+	TEXT(" 1: R8G8B8A8 color + half float reversed Z depth, 6 bytes per pixel\n")
+	TEXT(" 2: R5G6B5 color and half float reversed Z depth packed in one texture, 4 bytes per pixel"),
+	ECVF_Default);
+
+static float GUdsLoginRetrySeconds = 30.0f;
+static FAutoConsoleVariableRef CVarUdsLoginRetrySeconds(
+	TEXT("r.Uds.Login.RetrySeconds"),
+	GUdsLoginRetrySeconds,
+	TEXT("After a failed login, for how long loads are turned down before the next one logs in again.\n")
+	TEXT("0 tries again on the next load, below 0 never tries again until Exit or LoginFunction (default 30)"),
+	ECVF_Default);
+
+static float GUdsScreenPercentage = 100.0f;
+static FAutoConsoleVariableRef CVarUdsScreenPercentage(
+	TEXT("r.Uds.ScreenPercentage"),
+	GUdsScreenPercentage,
+	TEXT("Resolution UD renders at, as a percentage of the view; the composite upsamples it to the output (default 100)"),
+	ECVF_Default);
+
+static int32 GUdsProgressive = 0;
+static FAutoConsoleVariableRef CVarUdsProgressive(
+	TEXT("r.Uds.Progressive"),
+	GUdsProgressive,
+	TEXT("While the camera and UD instances are still, UD starts at r.Uds.Progressive.StartPercentage with udRCF_2PixelOpt and\n")
+	TEXT("sharpens over r.Uds.Progressive.Steps frames to full quality; any movement starts over. 1 on, 0 off (default)"),
+	ECVF_Default);
+
+static float GUdsProgressiveStartPercentage = 25.0f;
+static FAutoConsoleVariableRef CVarUdsProgressiveStartPercentage(
+	TEXT("r.Uds.Progressive.StartPercentage"),
+	GUdsProgressiveStartPercentage,
+	TEXT("Resolution of the first progressive frame, as a percentage of the UD render size (default 25)"),
+	ECVF_Default);
+
+static int32 GUdsProgressiveSteps = 4;
+static FAutoConsoleVariableRef CVarUdsProgressiveSteps(
+	TEXT("r.Uds.Progressive.Steps"),
+	GUdsProgressiveSteps,
+	TEXT("Frames from the first progressive frame to full quality, the resolution grows linearly in between (default 4)"),
+	ECVF_Default);
+
+static int32 GUdsOrthoFastPath = 1;
+static FAutoConsoleVariableRef CVarUdsOrthoFastPath(
+	TEXT("r.Uds.Ortho.FastPath"),
+	GUdsOrthoFastPath,
+	TEXT("Lets udSDK render orthographic views (top and side editor viewports, ortho scene captures) in its high-performance orthographic mode.\n")
+	TEXT("0 renders them through the general path with udRCF_DisableOrthographic, for comparison. 1 on (default), 0 off"),
+	ECVF_Default);
+
+static float GUdsOccluderDepthBias = 0.01f;
+static FAutoConsoleVariableRef CVarUdsOccluderDepthBias(
+	TEXT("r.Uds.OccluderDepth.Bias"),
+	GUdsOccluderDepthBias,
+	TEXT("Reprojected scene depth is pushed this fraction of its distance further away before UD renders against it (default 0.01)"),
+	ECVF_Default);
+
+static int32 GUdsOccluderDepthDilation = 1;
+static FAutoConsoleVariableRef CVarUdsOccluderDepthDilation(
+	TEXT("r.Uds.OccluderDepth.Dilation"),
+	GUdsOccluderDepthDilation,
+	TEXT("Reprojected scene depth is eroded towards the far plane by this many readback texels, covering edges that moved since it was read (default 1)"),
+	ECVF_Default);
+
+DECLARE_CYCLE_STAT(TEXT("Reproject Occluder Depth"), STAT_UdsReprojectOccluders, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("udRenderContext_Render"), STAT_UdsRender, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("udRenderContext_Render (Stereo Eye)"), STAT_UdsRenderStereo, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("udRenderContext_Render (Parallel View)"), STAT_UdsRenderParallel, STATGROUP_UnlimitedDetail);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Parallel Views Wall Time (ms)"), STAT_UdsParallelWallMs, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("udRenderContext_Render (Tile)"), STAT_UdsRenderTile, STATGROUP_UnlimitedDetail);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Tile Imbalance (slowest / mean)"), STAT_UdsTileImbalance, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("udRenderContext_Render (Far Layer)"), STAT_UdsRenderFarLayer, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("Layer Depth Merge"), STAT_UdsLayerMerge, STATGROUP_UnlimitedDetail);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Near Layer Render (ms)"), STAT_UdsNearLayerMs, STATGROUP_UnlimitedDetail);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Far Layer Render (ms)"), STAT_UdsFarLayerMs, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Near Layer Instances"), STAT_UdsNearLayerInstances, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Far Layer Instances"), STAT_UdsFarLayerInstances, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("udRenderContext_Render (Static)"), STAT_UdsRenderStatic, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("udRenderContext_Render (Dynamic)"), STAT_UdsRenderDynamic, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("Static Cache Copy"), STAT_UdsStaticCacheCopy, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Static Cache Hit"), STAT_UdsStaticCacheHit, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Instances"), STAT_UdsDynamicInstances, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("udRenderContext_Render (Throttled)"), STAT_UdsRenderThrottled, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Throttled Renders"), STAT_UdsThrottledRenders, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Throttled Targets"), STAT_UdsThrottledTargets, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("Compute Coverage"), STAT_UdsComputeCoverage, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("Foveated Composite"), STAT_UdsFoveatedComposite, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Progressive Step"), STAT_UdsProgressiveStep, STATGROUP_UnlimitedDetail);
+
 void FuncMat2Array(double* array, const FMatrix& Mat)
 {
 	for (int i = 0; i < 4; ++i)
@@ -46,8 +161,8 @@ UUDSubsystem::~UUDSubsystem()
 
 void UUDSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
+	// No login yet: it is a network round trip, and maps without point clouds never need one. The first RequestLoad starts it.
 	UE_LOG(LogTemp, Display, TEXT("UnlimitedDetail | INIT SUBSYSTEM"));
-	LoginFunction();
 }
 
 void UUDSubsystem::Deinitialize()
@@ -94,6 +209,12 @@ int UUDSubsystem::LoginFunction()
 		return error;
 	}
 
+	if (LoginState == EUDLoginState::LoggingIn)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | Already logging in!"));
+		return error;
+	}
+
 	// Initialize login related data
 	// Will fail if logins are not entered into the UI etc
 	error = (udError)Init(); // Maybe fix this cast?
@@ -116,47 +237,205 @@ int UUDSubsystem::LoginFunction()
 		return udE_Failure;
 	}
 
+	error = (udError)Connect(ServerUrl, APIKey, &pContext, &pRenderer);
+	if (error != udE_Success)
+	{
+		FString message = FString::Printf(TEXT("udContext_ConnectWithKey (Error: %s)"), GetError(error));
+		FMessageDialog::Debugf(FText::FromString(message));
+		return error;
+	}
+
+	LoginState = EUDLoginState::LoggedIn;
+
+	if (!ViewExtension)
+	{
+		ViewExtension = FSceneViewExtensions::NewExtension<FUDSceneViewExtension>();
+	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | The ViewExtension object already exists"));
+	}
+	
+	return error;
+}
+
+int UUDSubsystem::Connect(const FString& InServerUrl, const FString& InAPIKey, struct udContext** ppOutContext, struct udRenderContext** ppOutRenderer)
+{
 	const FString ApplicationVersion = "0.0";
 	const FString ApplicationName = "UE5_Client";
 
-	error = udContext_ConnectWithKey(&pContext, TCHAR_TO_UTF8(*ServerUrl), TCHAR_TO_UTF8(*ApplicationName), TCHAR_TO_UTF8(*ApplicationVersion), TCHAR_TO_UTF8(*APIKey));
+	enum udError error = udContext_ConnectWithKey(ppOutContext, TCHAR_TO_UTF8(*InServerUrl), TCHAR_TO_UTF8(*ApplicationName), TCHAR_TO_UTF8(*ApplicationVersion), TCHAR_TO_UTF8(*InAPIKey));
 	if (error != udE_Success)
 	{
-		FString message = FString::Printf(TEXT("udContext_ConnectWithKey (Error: %s)"), GetError(error));
-		FMessageDialog::Debugf(FText::FromString(message));
 		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udContext_ConnectWithKey (Error: %s)"), GetError(error));
 		return error;
 	}
 
-	error = udRenderContext_Create(pContext, &pRenderer);
+	error = udRenderContext_Create(*ppOutContext, ppOutRenderer);
 	if (error != udE_Success)
 	{
 		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderContext_Create (Error: %s)"), GetError(error));
-		return error;
+		udContext_Disconnect(ppOutContext, true);
 	}
 
-	if (!ViewExtension)
+	return error;
+}
+
+void UUDSubsystem::BeginLogin()
+{
+	check(IsInGameThread());
+
+	if (LoginState != EUDLoginState::LoggedOut || HasSession())
 	{
-		ViewExtension = FSceneViewExtensions::NewExtension<FUDSceneViewExtension>();
+		return;
+	}
+
+	if (Init() != udE_Success)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | Initialization failed! Check the server and APIKey in the project settings."));
+		LoginState = EUDLoginState::Failed;
+		LoginFailedSeconds = FPlatformTime::Seconds();
+		return;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("UnlimitedDetail | Connecting to Server: '%s'"), *ServerUrl);
+	LoginState = EUDLoginState::LoggingIn;
+
+	// Nothing waits for the task. The subsystem may be gone, or have exited, by the time the game thread gets to the result: the generation
+	// tells a current login from one an Exit gave up on, and a result nobody takes disconnects itself.
+	TWeakObjectPtr<UUDSubsystem> WeakThis(this);
+	const uint32 Generation = ++LoginGeneration;
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis, Generation, InServerUrl = ServerUrl, InAPIKey = APIKey]()
+	{
+		TSharedPtr<FUDLoginResult, ESPMode::ThreadSafe> Result = MakeShared<FUDLoginResult, ESPMode::ThreadSafe>();
+		Result->Error = Connect(InServerUrl, InAPIKey, &Result->pContext, &Result->pRenderer);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Generation, Result]()
+		{
+			if (UUDSubsystem* Subsystem = WeakThis.Get())
+			{
+				Subsystem->FinishLogin(Generation, *Result);
+			}
+		});
+	}, UE::Tasks::ETaskPriority::BackgroundNormal);
+}
+
+FUDLoginResult::~FUDLoginResult()
+{
+	if (pRenderer)
+	{
+		udRenderContext_Destroy(&pRenderer);
+	}
+	if (pContext)
+	{
+		udContext_Disconnect(&pContext, true);
+	}
+}
+
+void UUDSubsystem::FinishLogin(uint32 Generation, FUDLoginResult& Result)
+{
+	// An Exit since, and maybe a new login after it; this one is undone along with Result
+	if (Generation != LoginGeneration || LoginState != EUDLoginState::LoggingIn)
+	{
+		return;
+	}
+
+	if (Result.Error == udE_Success)
+	{
+		pContext = Result.pContext;
+		pRenderer = Result.pRenderer;
+		Result.pContext = nullptr;
+		Result.pRenderer = nullptr;
+		LoginState = EUDLoginState::LoggedIn;
+
+		if (!ViewExtension)
+		{
+			ViewExtension = FSceneViewExtensions::NewExtension<FUDSceneViewExtension>();
+		}
 	}
 	else
 	{
-		UE_LOG(LogTemp, Warning, TEXT("UnlimitedDetail | The ViewExtension object already exists"));
+		LoginState = EUDLoginState::Failed;
+		LoginFailedSeconds = FPlatformTime::Seconds();
 	}
-	
-	return error;
+
+	// Loads can queue more loads from their callbacks, those go straight through now
+	TArray<TPair<FString, FUDOnPointCloudLoaded>> Loads = MoveTemp(PendingLoads);
+	UE_LOG(LogTemp, Display, TEXT("UnlimitedDetail | Login %s, %d queued loads"), (Result.Error == udE_Success) ? TEXT("done") : TEXT("failed"), Loads.Num());
+
+	for (TPair<FString, FUDOnPointCloudLoaded>& Request : Loads)
+	{
+		FUDPointCloudHandle* Handle = HasSession() ? Load(Request.Key) : nullptr;
+		if (!Request.Value.ExecuteIfBound(Handle) && Handle)
+		{
+			// Nobody left to take it
+			Remove(Handle);
+		}
+	}
+}
+
+void UUDSubsystem::RequestLoad(const FString& URL, FUDOnPointCloudLoaded OnLoaded)
+{
+	check(IsInGameThread());
+
+	if (HasSession())
+	{
+		OnLoaded.ExecuteIfBound(Load(URL));
+		return;
+	}
+
+	// A failed login turns loads down for r.Uds.Login.RetrySeconds, then the next one logs in again
+	if (LoginState == EUDLoginState::Failed)
+	{
+		if (GUdsLoginRetrySeconds < 0.0f || FPlatformTime::Seconds() - LoginFailedSeconds < GUdsLoginRetrySeconds)
+		{
+			OnLoaded.ExecuteIfBound(nullptr);
+			return;
+		}
+		LoginState = EUDLoginState::LoggedOut;
+	}
+
+	PendingLoads.Emplace(URL, MoveTemp(OnLoaded));
+	BeginLogin();
+}
+
+FUDCheckerboardQuality UUDSubsystem::ConsumeCheckerboardQuality()
+{
+	return ViewExtension ? ViewExtension->ConsumeCheckerboardQuality() : FUDCheckerboardQuality();
+}
+
+uint32 UUDSubsystem::GetNumCompositeAllocations() const
+{
+	return ViewExtension ? ViewExtension->GetNumCompositeAllocations() : 0;
 }
 
 void UUDSubsystem::Exit()
 {
+	// Takes the occluder depth and checkerboard scoring readbacks with it
 	ViewExtension = nullptr;
 
+	// A login still running isn't waited for, its result is dropped when it comes in and disconnects itself. Loads queued on it fail
+	// now, so their requesters stop waiting for them.
+	++LoginGeneration;
+
+	// Failed while the callbacks run, a load they ask for again is turned down rather than starting a new login, whatever the retry interval
+	LoginState = EUDLoginState::Failed;
+	LoginFailedSeconds = TNumericLimits<double>::Max();
+	TArray<TPair<FString, FUDOnPointCloudLoaded>> Loads = MoveTemp(PendingLoads);
+	for (TPair<FString, FUDOnPointCloudLoaded>& Request : Loads)
+	{
+		Request.Value.ExecuteIfBound(nullptr);
+	}
+	LoginState = EUDLoginState::LoggedOut;
+
 	ServerUrl = ""; // udcloud.com
 	APIKey = "";
 
 	Width = 0;
 	Height = 0;
 
+	WaitForRender();
+
 	FScopeLock ScopeLock(&DataMutex);
 	for (auto inst : AssetsMap)
 	{
@@ -165,10 +444,35 @@ void UUDSubsystem::Exit()
 
 	RenderInstanceHandles.Reset();
 	AssetsMap.Reset();
+	bStaticChanged = true;
 
 	udRenderTarget_Destroy(&pRenderView);
+	udRenderTarget_Destroy(&pCheckerboardViews[0]);
+	udRenderTarget_Destroy(&pCheckerboardViews[1]);
+	udRenderTarget_Destroy(&pFoveatedViews[0]);
+	udRenderTarget_Destroy(&pFoveatedViews[1]);
+	DestroyStereoEye();
+	DestroyTiles();
+	DestroyFarLayer();
+
+	for (TUniquePtr<FUDViewTarget>& Target : ParallelViews)
+	{
+		DestroyViewTarget(*Target);
+	}
+	ParallelViews.Reset();
+
+	for (TPair<uint32, TUniquePtr<FUDThrottledTarget>>& Capture : ThrottledViews)
+	{
+		DestroyViewTarget(Capture.Value->Target);
+	}
+	ThrottledViews.Reset();
+	if (pThrottledRenderer)
+	{
+		udRenderContext_Destroy(&pThrottledRenderer);
+	}
+
 	udRenderContext_Destroy(&pRenderer);
-	udContext_Disconnect(&pContext, false);
+	udContext_Disconnect(&pContext, true);
 }
 
 FUDPointCloudHandle* UUDSubsystem::Load(FString URL)
@@ -261,6 +565,9 @@ void UUDSubsystem::Remove(FUDPointCloudHandle* PCI)
 
 		if (Asset->RefCount == 0)
 		{
+			// A background render may still be reading the point cloud
+			WaitForRender();
+
 			for (int i = RenderInstanceHandles.Num() - 1; i >= 0; --i)
 			{
 				if (RenderInstanceHandles[i].RenderInstance.pPointCloud == PCI->PointCloud)
@@ -289,7 +596,7 @@ bool UUDSubsystem::Find(FString URL)
 }
 
 
-int64_t UUDSubsystem::QueueInstance(FUDPointCloudHandle *PCI, const FMatrix &InMatrix, FSceneInterface *Scene)
+int64_t UUDSubsystem::QueueInstance(FUDPointCloudHandle *PCI, const FMatrix &InMatrix, FSceneInterface *Scene, EUDRenderLayer Layer, bool bDynamic)
 {
 	if (!PCI || !PCI->bIsLoaded || !PCI->PointCloud)
 	{
@@ -301,6 +608,8 @@ int64_t UUDSubsystem::QueueInstance(FUDPointCloudHandle *PCI, const FMatrix &InM
 	FUDPointCloudInstanceHandle RenderInstance = {};
 	RenderInstance.id = (NextID++);
 	RenderInstance.Scene = Scene;
+	RenderInstance.Layer = Layer;
+	RenderInstance.bDynamic = bDynamic;
 
 	RenderInstance.RenderInstance.pPointCloud = PCI->PointCloud;
 	RenderInstance.RenderInstance.pVoxelShader = PCI->VoxelShaderFunc;
@@ -313,20 +622,33 @@ int64_t UUDSubsystem::QueueInstance(FUDPointCloudHandle *PCI, const FMatrix &InM
 		RenderInstance.RenderInstance.matrix[3 + i * 4] = InMatrix.M[i][3];
 	}
 
+	RenderInstance.Transform = InMatrix;
+	RenderInstance.FrameTransform = InMatrix;
+	RenderInstance.PrevFrameTransform = InMatrix;
+	RenderInstance.TransformFrame = 0;
+
 	RenderInstanceHandles.Push(RenderInstance);
+	bSceneChanged = true;
+	++SceneRevision;
+	bStaticChanged |= !bDynamic;
 
 	return RenderInstance.id;
 }
 
 bool UUDSubsystem::RemoveInstance(int64_t id)
 {
+	FScopeLock ScopeLock(&DataMutex);
+
 	//TODO: Binary search this instead
 	for (int i = 0; i < RenderInstanceHandles.Num(); ++i)
 	{
 		if (RenderInstanceHandles[i].id != id)
 			continue;
 
+		bStaticChanged |= !RenderInstanceHandles[i].bDynamic;
 		RenderInstanceHandles.RemoveAt(i);
+		bSceneChanged = true;
+		++SceneRevision;
 		return true;
 	}
 
@@ -350,6 +672,11 @@ bool UUDSubsystem::UpdateInstance(int64_t id, const FMatrix &InMatrix)
 			RenderInstanceHandles[i].RenderInstance.matrix[2 + j * 4] = InMatrix.M[j][2];
 			RenderInstanceHandles[i].RenderInstance.matrix[3 + j * 4] = InMatrix.M[j][3];
 		}
+		const bool bMoved = !RenderInstanceHandles[i].Transform.Equals(InMatrix, 0.0);
+		bSceneChanged |= bMoved;
+		SceneRevision += bMoved ? 1 : 0;
+		bStaticChanged |= bMoved && !RenderInstanceHandles[i].bDynamic;
+		RenderInstanceHandles[i].Transform = InMatrix;
 
 		return true;
 	}
@@ -357,11 +684,20 @@ bool UUDSubsystem::UpdateInstance(int64_t id, const FMatrix &InMatrix)
 	return false;
 }
 
+bool UUDSubsystem::CanCaptureStereo(const FSceneView& View, const FSceneView& StereoView) const
+{
+	return IsUdsStereoPair(View, StereoView) && !IsUdsTemporalEnabled() && !IsUdsCheckerboardEnabled() && !IsUdsFoveatedEnabled(View) && !IsUdsRenderDecoupled();
+}
+
 // The main function for rendering out UD images
-int UUDSubsystem::CaptureUDSImage(const FSceneView& View)
+int UUDSubsystem::CaptureUDSImage(const FSceneView& View, const FUDOccluderDepth* pOccluderDepth, const FSceneView* pStereoView)
 {
 	// prep an empty error
 	enum udError error = udE_Failure;
+
+	Coverage = FUDCoverage();
+	StereoEye.Coverage = FUDCoverage();
+	InstanceMotion.Reset();
 	
 	if (!HasSession())
 	{
@@ -381,6 +717,37 @@ int UUDSubsystem::CaptureUDSImage(const FSceneView& View)
 	// auto vartest = View.UnconstrainedViewRect.Width();
 	int32 nWidth = View.UnconstrainedViewRect.Width();
 	int32 nHeight = View.UnconstrainedViewRect.Height();
+
+	// Temporal mode renders at the internal resolution and leaves upsampling to TSR / TAA
+	const bool bTemporal = IsUdsTemporalEnabled();
+	if (bTemporal)
+	{
+		const FIntPoint RenderSize = GetUdsTemporalRenderSize(View);
+		nWidth = RenderSize.X;
+		nHeight = RenderSize.Y;
+	}
+
+	float ResolutionFraction = FMath::Clamp(GUdsScreenPercentage, 10.0f, 100.0f) / 100.0f;
+	ResolutionFraction *= UpdateProgressive(View, FIntPoint(nWidth, nHeight));
+	if (ResolutionFraction < 1.0f)
+	{
+		nWidth = FMath::Max(FMath::CeilToInt(nWidth * ResolutionFraction), 1);
+		nHeight = FMath::Max(FMath::CeilToInt(nHeight * ResolutionFraction), 1);
+	}
+
+	// Both halves of the checkerboard are half width and half height; it jitters the projection itself, so not with temporal
+	const bool bUseCheckerboard = IsUdsCheckerboardEnabled() && !bTemporal;
+	if (bUseCheckerboard)
+	{
+		nWidth = Align(nWidth, 2);
+		nHeight = Align(nHeight, 2);
+	}
+
+	// Foveation brings its own sub-frustum projections, so neither with temporal nor checkerboard
+	const bool bUseFoveated = IsUdsFoveatedEnabled(View) && !bTemporal && !bUseCheckerboard;
+
+	// Stereo shares the traversal between two plain renders, none of the modes above
+	const bool bUseStereo = pStereoView && CanCaptureStereo(View, *pStereoView);
 	
 	// Return early if we have really invalid values?
 	if (nWidth <= 0 || nHeight <= 0)
@@ -398,185 +765,1334 @@ int UUDSubsystem::CaptureUDSImage(const FSceneView& View)
 		return udE_Failure;
 	}
 
-	error = (udError)RecreateUDView(nWidth, nHeight, View.FOV);
+	error = (udError)RecreateUDView(nWidth, nHeight, bUseCheckerboard, bUseFoveated);
 	if (error != udE_Success)
 	{
 		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | RecreateUDView error : %s"), GetError(error));
 		return error;
 	}
 
-	FuncMat2Array(ProjArray, ProjectionMatrix);
-	FuncMat2Array(ViewArray, View.ViewMatrices.GetViewMatrix());
+	error = (udError)RecreateStereoEye(bUseStereo, bUseStereo ? GetUdsStereoTraversalMargin(Width) : 0);
+	if (error != udE_Success)
+	{
+		return error;
+	}
 
+	// Tiles split the one full view projection, the modes rendering targets of their own aren't split; nor are they layered
+	error = (udError)RecreateTiles((bCheckerboard || bFoveated || bStereo) ? 1 : GetUdsTileCount());
+	if (error != udE_Success)
 	{
-		FScopeLock ScopeLockInst(&DataMutex);
+		return error;
+	}
 
-		error = udRenderTarget_SetTargets(pRenderView, ColorBulkData.GetData(), 0xFF000000, DepthBulkData.GetData());
-		if (error != udE_Success)
-		{
-			UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_SetTargets error : %s"), GetError(error));
-			return error;
-		}
+	error = (udError)RecreateFarLayer(IsUdsLayersEnabled() && !bCheckerboard && !bFoveated && !bStereo);
+	if (error != udE_Success)
+	{
+		return error;
+	}
 
-		error = udRenderTarget_SetMatrix(pRenderView, udRTM_Projection, ProjArray);
-		error = udRenderTarget_SetMatrix(pRenderView, udRTM_View, ViewArray);
-		
-		if (error != udE_Success)
-		{
-			UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_SetMatrix error : %s"), GetError(error));
-			return error;
-		}
+	// The static cache is a plain full view render
+	const bool bUseStaticCache = IsUdsStaticCacheEnabled() && !bCheckerboard && !bFoveated && !bStereo && !bLayers && Tiles.Num() == 0;
+	if (bUseStaticCache != bStaticCache)
+	{
+		// A background render may be reading the cache
+		WaitForRender();
+		bStaticCache = bUseStaticCache;
+		bStaticCacheValid = false;
+		StaticCacheColor.Empty();
+		StaticCacheDepth.Empty();
+	}
 
-		udRenderPicking picking = {};
+	// The view's own projection: off centre, asymmetric (stereo eyes) and orthographic (top and side editor viewports, ortho captures) alike.
+	// UE's are reversed Z, perspective ones with an infinite far plane; it stays that way for every matrix UE side shaders use (reprojection,
+	// checkerboard history) and only what is handed to udSDK goes through GetUdsForwardZProjection. udSDK picks its orthographic mode from
+	// the matrix, see r.Uds.Ortho.FastPath.
+	FMatrix UdProjection = View.ViewMatrices.GetProjectionNoAAMatrix();
+	Jitter = FVector2f::ZeroVector;
+	if (bTemporal)
+	{
+		Jitter = GetUdsTemporalJitter(View.Family->FrameNumber);
+		ApplyUdsTemporalJitter(UdProjection, Jitter, FIntPoint(Width, Height));
+	}
 
-		udRenderSettings renderOptions;
-		memset(&renderOptions, 0, sizeof(udRenderSettings));
-		
-		renderOptions.pPick = &picking;
-		renderOptions.pFilter = nullptr;
-		renderOptions.pointMode = udRCPM_Rectangles;
-		
-		TArray<udRenderInstance> RenderInstances;
+	// The half and foveated targets can't be seeded from occluder depth, and pixels from the previous checkerboard half carry last frame's velocity tags.
+	// A stereo traversal can't be culled by one eye's occluders either, and cached static depth can't depend on the scene's.
+	if (bCheckerboard || bFoveated || bStereo || bStaticCache)
+	{
+		pOccluderDepth = nullptr;
+	}
 
-		for (int i = 0; i < RenderInstanceHandles.Num(); ++i)
-		{
-			if (RenderInstanceHandles[i].Scene == View.Family->Scene)
-			{
-				RenderInstances.Add(RenderInstanceHandles[i].RenderInstance);
-			}
-		}
+	if (IsUdsRenderDecoupled())
+	{
+		error = (udError)CaptureDecoupled(View, UdProjection, pOccluderDepth);
+		AddFrameRenderSeconds(View, LastRenderSeconds);
+		return error;
+	}
 
-		error = udRenderContext_Render(pRenderer, pRenderView, RenderInstances.GetData(), RenderInstances.Num(), &renderOptions);
-		if (error != udE_Success)
-		{
-			UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderContext_Render error : %s"), GetError(error));
-			return error;
-		}
+	// Decoupling may have just been turned off
+	WaitForRender();
+	Reprojection = FUDReprojection();
+
+	PrepareRender(View, UdProjection, pOccluderDepth, IsUdsVelocityEnabled() && !bCheckerboard);
 
-		// TODO - Add picking back in
-		if (picking.hit)
+	if (bStereo)
+	{
+		FuncMat2Array(StereoEye.ViewArray, pStereoView->ViewMatrices.GetViewMatrix());
+		FuncMat2Array(StereoEye.ProjArray, GetUdsForwardZProjection(pStereoView->ViewMatrices.GetProjectionNoAAMatrix()));
+
+		// The second eye sits to the right, its frustum reaches further that way
+		if (StereoEye.Margin > 0)
 		{
-		//	SetSelectedByModelIndex(picking.modelIndex, true);
+			FuncMat2Array(StereoEye.WideProjArray, GetUdsForwardZProjection(GetUdsSubFrustumProjection(UdProjection, FIntRect(0, 0, Width + StereoEye.Margin, Height), FIntPoint(Width, Height))));
 		}
 	}
 
+	error = (udError)RenderImage();
+	if (error != udE_Success)
+	{
+		return error;
+	}
 
-	ENQUEUE_RENDER_COMMAND(UpdateTextureData)(
-		[this](FRHICommandListImmediate& CommandList)
-		{
-			FScopeLock ScopeLock(&DataMutex);
-
-			if (ColorTexture.IsValid() && ColorTexture->GetSizeX() == Width && ColorTexture->GetSizeY() == Height)
-			{
-				auto Region = FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height);
-				RHIUpdateTexture2D(ColorTexture.GetReference(), 0, Region, ColorBulkData.GetTypeSize() * Region.Width, (uint8*)ColorBulkData.GetData());
-			}
+	Coverage = RenderedCoverage;
+	LastRenderSeconds = RenderedSeconds;
+	ImageCheckerboard = RenderCheckerboard;
+	CheckerboardReference = MoveTemp(RenderReference);
+	StageUpload();
+	AddFrameRenderSeconds(View, LastRenderSeconds);
 
-			if (DepthTexture.IsValid() && DepthTexture->GetSizeX() == Width && DepthTexture->GetSizeY() == Height)
-			{
-				auto Region = FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height); // check this maybe?
-				RHIUpdateTexture2D(DepthTexture.GetReference(), 0, Region, DepthBulkData.GetTypeSize() * Region.Width, (uint8*)DepthBulkData.GetData());
-			}
-		}
-	);
 	return error;
 }
 
-int UUDSubsystem::RecreateUDView(int32 InWidth, int32 InHeight, float InFOV)
+void UUDSubsystem::AddFrameRenderSeconds(const FSceneView& View, double Seconds)
 {
-	enum udError error = udE_Success;
-	if (InWidth == Width && InHeight == Height)
+	if (View.Family->FrameNumber != FrameRenderSecondsFrame)
 	{
-		return error;
+		FrameRenderSecondsFrame = View.Family->FrameNumber;
+		FrameRenderSeconds = 0.0;
 	}
+	FrameRenderSeconds += Seconds;
+}
 
-	Width = InWidth;
-	Height = InHeight;
-
-	UE_LOG(LogTemp, Display, TEXT("RecreateUDView() Width: %d, Height: %d"), Width, Height);
-			
-
-	const float MinZ = GNearClippingPlane;
-	const float MaxZ = MinZ;
-	const float ModifiedViewFOV = InFOV;
-	const float MatrixFOV = FMath::Max(0.001f, ModifiedViewFOV) * (float)PI / 360.0f;
+float UUDSubsystem::UpdateProgressive(const FSceneView& View, const FIntPoint& RenderSize)
+{
+	bProgressiveFastRender = false;
 
-	float const XAxisMultiplier = 1.0f;
-	float const YAxisMultiplier = Width / (float)Height;
+	if (GUdsProgressive <= 0)
+	{
+		ProgressiveStep = 0;
+		return 1.0f;
+	}
 
-	ProjectionMatrix = FPerspectiveMatrix(
-		MatrixFOV,
-		MatrixFOV,
-		XAxisMultiplier,
-		YAxisMultiplier,
-		MinZ,
-		MaxZ
-	);
+	// Unjittered, temporal jitter alone isn't movement
+	const FMatrix Camera = View.ViewMatrices.GetViewMatrix() * View.ViewMatrices.GetProjectionNoAAMatrix();
+	const int32 Steps = FMath::Max(GUdsProgressiveSteps, 1);
 
 	{
 		FScopeLock ScopeLock(&DataMutex);
-		ETextureCreateFlags TexCreateFlags = TexCreate_Dynamic; // Flags for .SetFlags()
+
+		if (bSceneChanged || RenderSize != ProgressiveRenderSize || !Camera.Equals(ProgressiveCamera, UE_KINDA_SMALL_NUMBER))
+		{
+			ProgressiveStep = 0;
+		}
+		else
 		{
+			ProgressiveStep = FMath::Min(ProgressiveStep + 1, Steps - 1);
+		}
 
-		
-			ColorBulkData.ResizeArray(Width * Height);
-			const FString DebugName = "RecreateUDView ColorTexture";
-			
-			//RHICreateTexture2D - DEPRECATED in 5.1, use RHICreateTexture(FRHITextureCreateDesc) instead
-			// ColorTexture = RHICreateTexture2D(Width, Height, EPixelFormat::PF_B8G8R8A8, 1, 1, TexCreateFlags, CreateInfo); // 4.27 Line
+		bSceneChanged = false;
+	}
 
-			// FRHIResourceCreateInfo CreateInfo;
-			//FRHIResourceCreateInfo
+	ProgressiveCamera = Camera;
+	ProgressiveRenderSize = RenderSize;
+	SET_DWORD_STAT(STAT_UdsProgressiveStep, ProgressiveStep);
 
-			// New 5.1 texture descriptor
-			FRHITextureCreateDesc ColorTextureDescriptor = FRHITextureCreateDesc::Create2D(*DebugName, Width, Height, EPixelFormat::PF_B8G8R8A8);
+	if (ProgressiveStep == Steps - 1)
+		return 1.0f;
 
-			&ColorTextureDescriptor.SetFlags(TexCreateFlags);
-			&ColorTextureDescriptor.SetNumMips(1);
-			&ColorTextureDescriptor.SetNumSamples(1);
+	// Only the final step is full quality
+	bProgressiveFastRender = true;
 
-			ColorTexture = RHICreateTexture(ColorTextureDescriptor);
-		}
+	const float StartFraction = FMath::Clamp(GUdsProgressiveStartPercentage, 10.0f, 100.0f) / 100.0f;
+	return FMath::Lerp(StartFraction, 1.0f, ProgressiveStep / (float)(Steps - 1));
+}
 
-		{
-			// Size the array to match the possible screen size
-			// Screen size changes in editor all the time so this is required
-			DepthBulkData.ResizeArray(Width * Height);
-			
-			const FString DebugName = "RecreateUDView DepthTexture"; // 5.1 API might require a name to be passed in
+int UUDSubsystem::CaptureDecoupled(const FSceneView& View, const FMatrix& UdProjection, const FUDOccluderDepth* pOccluderDepth)
+{
+	enum udError error = udE_Success;
+	const FMatrix ViewProjection = View.ViewMatrices.GetViewMatrix() * UdProjection;
 
-			
+	// A finished render is uploaded the frame it's picked up; until the next one finishes it is reprojected to every new camera
+	if (RenderTask.IsValid() && RenderTask.IsCompleted())
+	{
+		RenderTask = UE::Tasks::FTask();
+		error = (udError)RenderTaskError;
+		LastRenderSeconds = RenderedSeconds;
 
-			// New 5.1 descriptor
-			FRHITextureCreateDesc DepthTextureDescr = FRHITextureCreateDesc::Create2D(*DebugName, Width, Height, EPixelFormat::PF_R32_FLOAT);
-			
-			&DepthTextureDescr.SetNumMips(1);
-			&DepthTextureDescr.SetNumSamples(1);
-			&DepthTextureDescr.SetFlags(TexCreateFlags);
-			
-			DepthTexture = RHICreateTexture(DepthTextureDescr);
+		if (error == udE_Success)
+		{
+			ImageViewProjection = RenderViewProjection;
+			ImageCoverage = RenderedCoverage;
+			ImageCheckerboard = RenderCheckerboard;
+			bHasImage = true;
+			StageUpload();
 		}
 	}
 
-	
-
-	if (pRenderView)
+	const double Now = FPlatformTime::Seconds();
+	if (!RenderTask.IsValid() && Now - LastRenderStartSeconds >= 1.0 / GetUdsRenderRate())
 	{
-		error = udRenderTarget_Destroy(&pRenderView);
-		if (error != udE_Success)
+		LastRenderStartSeconds = Now;
+
+		// Motion tags would be stale by the time the image is shown
+		PrepareRender(View, UdProjection, pOccluderDepth, false);
+
+		RenderTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this]()
 		{
-			UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_Destroy error : %s"), GetError(error));
-			return error;
-		}
-		pRenderView = nullptr;
+			RenderTaskError = RenderImage();
+		});
 	}
 
-	
-	error = udRenderTarget_Create(pContext, &pRenderView, pRenderer, Width, Height);
-	
-	if (error != udE_Success)
+	Reprojection = FUDReprojection();
+	if (bHasImage && ImageCoverage.bHasCoverage)
 	{
-		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_Create error : %s"), GetError(error));
+		// The reprojected image can land anywhere in the view
+		Coverage.bHasCoverage = true;
+		Coverage.Rect = FIntRect(0, 0, Width, Height);
+
+		Reprojection.bEnabled = true;
+		Reprojection.SourceClipToClip = GetUdsReprojectionClipToClip(ImageViewProjection, ViewProjection);
+	}
+
+	return error;
+}
+
+void UUDSubsystem::WaitForRender()
+{
+	if (RenderTask.IsValid())
+	{
+		RenderTask.Wait();
+		RenderTask = UE::Tasks::FTask();
+	}
+
+	// Whatever it rendered may not match the textures any more
+	bHasImage = false;
+}
+
+void UUDSubsystem::PrepareRender(const FSceneView& View, const FMatrix& UdProjection, const FUDOccluderDepth* pOccluderDepth, bool bTagMotion)
+{
+	FScopeLock ScopeLock(&DataMutex);
+
+	const FMatrix ViewProjection = View.ViewMatrices.GetViewMatrix() * UdProjection;
+	RenderViewProjection = ViewProjection;
+	bFastRender = bProgressiveFastRender;
+	FuncMat2Array(ProjArray, GetUdsForwardZProjection(UdProjection));
+	FuncMat2Array(ViewArray, View.ViewMatrices.GetViewMatrix());
+
+	RenderCheckerboard = FUDCheckerboard();
+	bRenderReference = false;
+	if (bCheckerboard)
+	{
+		CheckerboardParity ^= 1;
+
+		// Half target t renders rows t, t + 2, ... and every other column from the one that puts it on this frame's half.
+		// Its projection is shifted so its pixel centers, which fall between full resolution pixels, land on theirs.
+		for (int32 t = 0; t < 2; ++t)
+		{
+			const int32 Column = (CheckerboardParity + t) & 1;
+			FMatrix HalfProjection = UdProjection;
+			ApplyUdsTemporalJitter(HalfProjection, FVector2f(0.5f - Column, 0.5f - t), FIntPoint(Width, Height));
+			FuncMat2Array(CheckerboardProjArrays[t], GetUdsForwardZProjection(HalfProjection));
+		}
+
+		RenderCheckerboard.bEnabled = true;
+		RenderCheckerboard.Parity = CheckerboardParity;
+		RenderCheckerboard.bHistoryValid = bCheckerboardHistory;
+		// Reversed Z like the device depth the reconstruction decodes, not what udSDK was given
+		RenderCheckerboard.PrevClipToClip = CheckerboardPrevViewProjection.Inverse() * ViewProjection;
+		CheckerboardPrevViewProjection = ViewProjection;
+		bCheckerboardHistory = true;
+
+		bRenderReference = IsUdsCheckerboardReferenceEnabled() && !IsUdsRenderDecoupled();
+	}
+
+	if (bFoveated)
+	{
+		FoveatedInnerRect = GetUdsFoveatedInnerRect(View, UdProjection, FIntPoint(Width, Height));
+		FuncMat2Array(FoveatedProjArrays[0], GetUdsForwardZProjection(UdProjection));
+		FuncMat2Array(FoveatedProjArrays[1], GetUdsForwardZProjection(GetUdsSubFrustumProjection(UdProjection, FoveatedInnerRect, FIntPoint(Width, Height))));
+	}
+
+	bPreserveBuffers = pOccluderDepth != nullptr;
+	if (pOccluderDepth)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsReprojectOccluders);
+
+		// Seeded in udSDK's own depth, so through the projection it renders with
+		const FMatrix UdSDKViewProjection = View.ViewMatrices.GetViewMatrix() * GetUdsForwardZProjection(UdProjection);
+		UDBufferKernels::ReprojectOccluderDepth(*pOccluderDepth, UdSDKViewProjection, GUdsOccluderDepthBias, GUdsOccluderDepthDilation, DepthBulkData.GetData(), Width, Height, ReprojectionScratch);
+
+		// udSDK won't clear with udRCF_PreserveBuffers; the clear color is also how unwritten pixels are found afterwards
+		FColor* pColor = ColorBulkData.GetData();
+		for (int32 i = 0; i < Width * Height; ++i)
+		{
+			pColor[i].DWColor() = UDBufferKernels::ClearColor;
+		}
+	}
+
+	// Instances that moved since the previous frame tag their pixels so the velocity pass can find them; packed output has no alpha to carry it.
+	// The wrappers are pointed to by the render instances, so they can't move while udSDK renders.
+	bTagMotion &= OutputFormat != EUDOutputFormat::Packed;
+	MotionVoxelShaders.Reset(UDS_MAX_MOVING_INSTANCES);
+	GatherRenderInstances(View, bTagMotion, RenderInstances, bLayers ? &FarLayer.RenderInstances : nullptr, bStaticCache ? &NumStaticInstances : nullptr);
+	bRenderFarLayer = bLayers && FarLayer.RenderInstances.Num() > 0;
+	SET_DWORD_STAT(STAT_UdsNearLayerInstances, RenderInstances.Num());
+	SET_DWORD_STAT(STAT_UdsFarLayerInstances, bLayers ? FarLayer.RenderInstances.Num() : 0);
+
+	// The cached static render is only good for the camera, size, quality and static instances it was made with
+	if (bStaticCache)
+	{
+		if (bStaticChanged || StaticCacheSize != FIntPoint(Width, Height) || StaticCacheScene != View.Family->Scene || bStaticCacheFastRender != bFastRender ||
+			!ViewProjection.Equals(StaticCacheViewProjection, UE_KINDA_SMALL_NUMBER))
+		{
+			bStaticCacheValid = false;
+			StaticCacheKeyRenders = 0;
+			bStaticChanged = false;
+			StaticCacheSize = FIntPoint(Width, Height);
+			StaticCacheScene = View.Family->Scene;
+			bStaticCacheFastRender = bFastRender;
+			StaticCacheViewProjection = ViewProjection;
+		}
+		SET_DWORD_STAT(STAT_UdsDynamicInstances, RenderInstances.Num() - NumStaticInstances);
+	}
+
+	// Each tile's renderer gets its own copy of the list, the motion wrappers they point to are only read
+	for (FUDRenderTile& Tile : Tiles)
+	{
+		FuncMat2Array(Tile.ProjArray, GetUdsForwardZProjection(GetUdsSubFrustumProjection(UdProjection, Tile.Rect, FIntPoint(Width, Height))));
+		Tile.RenderInstances = RenderInstances;
+	}
+}
+
+void UUDSubsystem::GatherRenderInstances(const FSceneView& View, bool bTagMotion, TArray<udRenderInstance>& OutInstances, TArray<udRenderInstance>* pOutFarInstances, int32* pOutNumStatic)
+{
+	const uint32 FrameNumber = View.Family->FrameNumber;
+	const FVector ViewOrigin = View.ViewMatrices.GetViewOrigin();
+	OutInstances.Reset();
+	if (pOutFarInstances)
+	{
+		pOutFarInstances->Reset();
+	}
+
+	// Dynamic instances go after the static ones
+	TArray<udRenderInstance, TInlineAllocator<16>> DynamicInstances;
+
+	for (int i = 0; i < RenderInstanceHandles.Num(); ++i)
+	{
+		FUDPointCloudInstanceHandle& Handle = RenderInstanceHandles[i];
+		if (Handle.Scene != View.Family->Scene)
+			continue;
+
+		// Advanced once per frame, every view of the frame sees the same motion
+		if (Handle.TransformFrame != FrameNumber)
+		{
+			Handle.PrevFrameTransform = Handle.FrameTransform;
+			Handle.FrameTransform = Handle.Transform;
+			Handle.TransformFrame = FrameNumber;
+		}
+
+		const bool bFar = pOutFarInstances && IsUdsFarLayerInstance(Handle.Layer, Handle.Transform.GetOrigin(), ViewOrigin);
+		const bool bDeferDynamic = pOutNumStatic && Handle.bDynamic;
+		udRenderInstance& Instance = (bFar ? *pOutFarInstances : (bDeferDynamic ? DynamicInstances : OutInstances)).Add_GetRef(Handle.RenderInstance);
+
+		// Blended instances have their alpha computed by udSDK. Cached static pixels would carry their tag into every frame the cache
+		// is reused for, so those are never tagged; a static instance that moves re-renders the cache and goes without velocity that frame.
+		const bool bBlended = Instance.opacity > 0.0 && Instance.opacity < 1.0;
+		const bool bCachedStatic = pOutNumStatic && !Handle.bDynamic;
+		if (bTagMotion && !bBlended && !bCachedStatic && Instance.pVoxelShader && InstanceMotion.Num() < UDS_MAX_MOVING_INSTANCES && !Handle.FrameTransform.Equals(Handle.PrevFrameTransform, 0.0))
+		{
+			FUDMotionVoxelShader& MotionShader = MotionVoxelShaders.Add_GetRef({ Instance.pVoxelShader, Instance.pVoxelUserData, (uint32)InstanceMotion.Num() + 1 });
+			InstanceMotion.Add({ Handle.FrameTransform, Handle.PrevFrameTransform });
+
+			Instance.pVoxelShader = vcVoxelShader_Motion;
+			Instance.pVoxelUserData = &MotionShader;
+		}
+	}
+
+	if (pOutNumStatic)
+	{
+		*pOutNumStatic = OutInstances.Num();
+		OutInstances.Append(DynamicInstances);
+	}
+}
+
+// Flags every udRenderContext_Render call takes, whichever view it is for
+static uint32 GetUdsBaseRenderFlags()
+{
+	return (GUdsOrthoFastPath > 0) ? udRCF_None : udRCF_DisableOrthographic;
+}
+
+uint32 UUDSubsystem::GetRenderFlags() const
+{
+	uint32 Flags = GetUdsBaseRenderFlags() | (bPreserveBuffers ? udRCF_PreserveBuffers : udRCF_None);
+	if (bFastRender)
+	{
+		Flags |= udRCF_2PixelOpt;
+	}
+	return Flags;
+}
+
+int UUDSubsystem::RenderTarget(struct udRenderContext* pWithRenderer, TArrayView<udRenderInstance> Instances, struct udRenderTarget* pTarget, FColor* pColor, float* pDepth, const double* pView, const double* pProjection, struct udRenderPicking* pPicking, uint32 Flags, int32 Pitch)
+{
+	enum udError error = udE_Failure;
+
+	// A pitch of 0 is the target's own width
+	error = udRenderTarget_SetTargetsWithPitch(pTarget, pColor, UDBufferKernels::ClearColor, pDepth, Pitch * sizeof(FColor), Pitch * sizeof(float));
+	if (error != udE_Success)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_SetTargetsWithPitch error : %s"), GetError(error));
+		return error;
+	}
+
+	error = udRenderTarget_SetMatrix(pTarget, udRTM_Projection, pProjection);
+	error = udRenderTarget_SetMatrix(pTarget, udRTM_View, pView);
+	
+	if (error != udE_Success)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_SetMatrix error : %s"), GetError(error));
+		return error;
+	}
+
+	udRenderSettings renderOptions;
+	memset(&renderOptions, 0, sizeof(udRenderSettings));
+	
+	renderOptions.pPick = pPicking;
+	renderOptions.pFilter = nullptr;
+	renderOptions.pointMode = udRCPM_Rectangles;
+	renderOptions.flags = (udRenderContextFlags)Flags;
+
+	error = udRenderContext_Render(pWithRenderer, pTarget, Instances.GetData(), Instances.Num(), &renderOptions);
+	if (error != udE_Success)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderContext_Render error : %s"), GetError(error));
+	}
+
+	return error;
+}
+
+int UUDSubsystem::RenderImage()
+{
+	enum udError error = udE_Failure;
+
+	RenderedCoverage = FUDCoverage();
+	RenderReference.Reset();
+
+	udRenderPicking picking = {};
+	const uint32 Flags = GetRenderFlags();
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsRender);
+		const double RenderStart = FPlatformTime::Seconds();
+
+		// The far layer renders on a worker meanwhile, into its own buffers
+		UE::Tasks::FTask FarLayerTask;
+		if (bRenderFarLayer)
+		{
+			FarLayerTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, Flags]()
+			{
+				SCOPE_CYCLE_COUNTER(STAT_UdsRenderFarLayer);
+				const double FarStart = FPlatformTime::Seconds();
+
+				udRenderPicking farPicking = {};
+				FarLayer.RenderError = RenderTarget(FarLayer.pRenderer, FarLayer.RenderInstances, FarLayer.pRenderView, FarLayer.Color.GetData(), FarLayer.Depth.GetData(),
+					ViewArray, ProjArray, &farPicking, Flags & ~udRCF_PreserveBuffers);
+				FarLayer.RenderSeconds = FPlatformTime::Seconds() - FarStart;
+			});
+		}
+
+		if (bCheckerboard)
+		{
+			// Each half target covers one row parity; interleaved they are this frame's half of the checkerboard, the other half keeps the previous frame's
+			const int32 HalfWidth = Width / 2;
+			const int32 HalfHeight = Height / 2;
+			for (int32 t = 0; t < 2; ++t)
+			{
+				error = (udError)RenderTarget(pRenderer, RenderInstances, pCheckerboardViews[t], CheckerboardColor[t].GetData(), CheckerboardDepth[t].GetData(), ViewArray, CheckerboardProjArrays[t], &picking, Flags);
+				if (error != udE_Success)
+					break;
+
+				UDBufferKernels::InterleaveCheckerboard(CheckerboardColor[t].GetData(), CheckerboardDepth[t].GetData(), HalfWidth, HalfHeight,
+					(RenderCheckerboard.Parity + t) & 1, t, ColorBulkData.GetData(), DepthBulkData.GetData(), Width);
+			}
+		}
+		else if (bFoveated)
+		{
+			for (int32 t = 0; t < 2 && error == udE_Success; ++t)
+			{
+				error = (udError)RenderTarget(pRenderer, RenderInstances, pFoveatedViews[t], FoveatedColor[t].GetData(), FoveatedDepth[t].GetData(), ViewArray, FoveatedProjArrays[t], &picking, Flags);
+			}
+		}
+		else if (bStereo && StereoEye.Margin > 0)
+		{
+			// The widened first eye, cropped back to its own columns
+			error = (udError)RenderTarget(pRenderer, RenderInstances, StereoEye.pWideView, StereoEye.WideColor.GetData(), StereoEye.WideDepth.GetData(), ViewArray, StereoEye.WideProjArray, &picking, Flags);
+			if (error == udE_Success)
+			{
+				const int32 WideWidth = Width + StereoEye.Margin;
+				for (int32 y = 0; y < Height; ++y)
+				{
+					FMemory::Memcpy(ColorBulkData.GetData() + y * Width, StereoEye.WideColor.GetData() + y * WideWidth, Width * sizeof(FColor));
+					FMemory::Memcpy(DepthBulkData.GetData() + y * Width, StereoEye.WideDepth.GetData() + y * WideWidth, Width * sizeof(float));
+				}
+			}
+		}
+		else if (bStaticCache)
+		{
+			error = (udError)RenderStaticCached(&picking, Flags);
+		}
+		else if (Tiles.Num() > 0)
+		{
+			error = (udError)RenderTiles(Flags);
+		}
+		else
+		{
+			error = (udError)RenderTarget(pRenderer, RenderInstances, pRenderView, ColorBulkData.GetData(), DepthBulkData.GetData(), ViewArray, ProjArray, &picking, Flags);
+		}
+
+		// The second eye draws what the first eye's traversal found, from its own camera
+		if (bStereo && error == udE_Success)
+		{
+			SCOPE_CYCLE_COUNTER(STAT_UdsRenderStereo);
+			error = (udError)RenderTarget(pRenderer, RenderInstances, StereoEye.pRenderView, StereoEye.ColorBulkData.GetData(), StereoEye.DepthBulkData.GetData(), StereoEye.ViewArray, StereoEye.ProjArray, &picking, Flags | udRCF_NoTraversal);
+		}
+
+		if (FarLayerTask.IsValid())
+		{
+			SET_FLOAT_STAT(STAT_UdsNearLayerMs, (FPlatformTime::Seconds() - RenderStart) * 1000.0);
+			FarLayerTask.Wait();
+			SET_FLOAT_STAT(STAT_UdsFarLayerMs, FarLayer.RenderSeconds * 1000.0);
+
+			if (error == udE_Success)
+			{
+				error = (udError)FarLayer.RenderError;
+			}
+		}
+
+		RenderedSeconds = FPlatformTime::Seconds() - RenderStart;
+	}
+
+	if (error != udE_Success)
+	{
+		return error;
+	}
+
+	if (bFoveated)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsFoveatedComposite);
+		UDBufferKernels::CompositeFoveated(FoveatedColor[0].GetData(), FoveatedDepth[0].GetData(), FoveatedSizes[0], FoveatedColor[1].GetData(), FoveatedDepth[1].GetData(),
+			FoveatedInnerRect, GetUdsFoveatedBlendPixels(), ColorBulkData.GetData(), DepthBulkData.GetData(), Width, Height);
+	}
+
+	// Pixels udSDK didn't draw still hold the reprojected scene depth
+	if (bPreserveBuffers)
+	{
+		UDBufferKernels::ResetUnwrittenDepth(ColorBulkData.GetData(), DepthBulkData.GetData(), Width * Height);
+	}
+
+	// After the reset, so the far layer shows through wherever only occluder depth was
+	if (bRenderFarLayer)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsLayerMerge);
+		UDBufferKernels::MergeDepthLayer(FarLayer.Color.GetData(), FarLayer.Depth.GetData(), FarLayer.Size, ColorBulkData.GetData(), DepthBulkData.GetData(), Width, Height);
+	}
+
+	// Not timed, it is only there to be compared against
+	if (bRenderReference)
+	{
+		TSharedPtr<TArray<FColor>, ESPMode::ThreadSafe> Reference = MakeShared<TArray<FColor>, ESPMode::ThreadSafe>();
+		Reference->SetNumUninitialized(Width * Height);
+		ReferenceDepth.SetNumUninitialized(Width * Height);
+
+		udRenderPicking referencePicking = {};
+		if (RenderTarget(pRenderer, RenderInstances, pRenderView, Reference->GetData(), ReferenceDepth.GetData(), ViewArray, ProjArray, &referencePicking, Flags) == udE_Success)
+		{
+			RenderReference = Reference;
+		}
+	}
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsComputeCoverage);
+		RenderedCoverage = UDBufferKernels::ComputeCoverage(DepthBulkData.GetData(), Width, Height);
+
+		if (bStereo)
+		{
+			StereoEye.Coverage = UDBufferKernels::ComputeCoverage(StereoEye.DepthBulkData.GetData(), Width, Height);
+		}
+	}
+
+	// TODO - Add picking back in
+	if (picking.hit)
+	{
+	//	SetSelectedByModelIndex(picking.modelIndex, true);
+	}
+
+	return error;
+}
+
+int UUDSubsystem::RenderTiles(uint32 Flags)
+{
+	// Whoever is free takes the next tile, so a slow tile doesn't hold up the ones queued behind it
+	std::atomic<int32> NextTile{ 0 };
+	auto RenderNextTiles = [this, &NextTile, Flags]()
+	{
+		for (int32 t = NextTile++; t < Tiles.Num(); t = NextTile++)
+		{
+			FUDRenderTile& Tile = Tiles[t];
+			SCOPE_CYCLE_COUNTER(STAT_UdsRenderTile);
+			const double RenderStart = FPlatformTime::Seconds();
+
+			// The tile's top left pixel in the main buffers, each of its rows a whole main row further on
+			const int32 Offset = Tile.Rect.Min.Y * Width + Tile.Rect.Min.X;
+
+			udRenderPicking picking = {};
+			Tile.RenderError = RenderTarget(Tile.pRenderer ? Tile.pRenderer : pRenderer, Tile.RenderInstances, Tile.pRenderView,
+				ColorBulkData.GetData() + Offset, DepthBulkData.GetData() + Offset, ViewArray, Tile.ProjArray, &picking, Flags, Width);
+			Tile.RenderSeconds = FPlatformTime::Seconds() - RenderStart;
+		}
+	};
+
+	TArray<UE::Tasks::FTask, TInlineAllocator<64>> TileTasks;
+	const int32 NumWorkers = GetUdsTileWorkers(Tiles.Num());
+	for (int32 w = 0; w < NumWorkers; ++w)
+	{
+		TileTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, RenderNextTiles));
+	}
+
+	RenderNextTiles();
+	UE::Tasks::Wait(TileTasks);
+
+	int32 error = udE_Success;
+	double SumSeconds = 0.0;
+	double MaxSeconds = 0.0;
+	for (const FUDRenderTile& Tile : Tiles)
+	{
+		if (Tile.RenderError != udE_Success)
+		{
+			error = Tile.RenderError;
+		}
+		SumSeconds += Tile.RenderSeconds;
+		MaxSeconds = FMath::Max(MaxSeconds, Tile.RenderSeconds);
+	}
+
+	// 1 is a perfect split; above it the slowest tile is what the frame waits on
+	SET_FLOAT_STAT(STAT_UdsTileImbalance, SumSeconds > 0.0 ? MaxSeconds * Tiles.Num() / SumSeconds : 1.0);
+
+	return error;
+}
+
+int UUDSubsystem::RenderStaticCached(struct udRenderPicking* pPicking, uint32 Flags)
+{
+	enum udError error = udE_Success;
+	const TArrayView<udRenderInstance> Instances(RenderInstances);
+	const int32 NumPixels = Width * Height;
+
+	SET_DWORD_STAT(STAT_UdsStaticCacheHit, bStaticCacheValid ? 1 : 0);
+
+	if (bStaticCacheValid)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsStaticCacheCopy);
+		FMemory::Memcpy(ColorBulkData.GetData(), StaticCacheColor.GetData(), NumPixels * sizeof(FColor));
+		FMemory::Memcpy(DepthBulkData.GetData(), StaticCacheDepth.GetData(), NumPixels * sizeof(float));
+	}
+	else
+	{
+		// A normal render only has what the streamer had loaded, so caching the first one after the key changes would freeze a
+		// coarse LOD. The key holding for a second render means the camera stopped; that one waits for the streamer instead.
+		const bool bFill = (StaticCacheKeyRenders++ > 0);
+		{
+			SCOPE_CYCLE_COUNTER(STAT_UdsRenderStatic);
+			error = (udError)RenderTarget(pRenderer, Instances.Slice(0, NumStaticInstances), pRenderView, ColorBulkData.GetData(), DepthBulkData.GetData(), ViewArray, ProjArray, pPicking, bFill ? (Flags | udRCF_BlockingStreaming) : Flags);
+		}
+		if (error != udE_Success)
+		{
+			return error;
+		}
+
+		if (bFill)
+		{
+			SCOPE_CYCLE_COUNTER(STAT_UdsStaticCacheCopy);
+			StaticCacheColor.SetNumUninitialized(NumPixels);
+			StaticCacheDepth.SetNumUninitialized(NumPixels);
+			FMemory::Memcpy(StaticCacheColor.GetData(), ColorBulkData.GetData(), NumPixels * sizeof(FColor));
+			FMemory::Memcpy(StaticCacheDepth.GetData(), DepthBulkData.GetData(), NumPixels * sizeof(float));
+			bStaticCacheValid = true;
+		}
+	}
+
+	// udSDK keeps every static pixel the dynamic instances don't draw in front of
+	if (NumStaticInstances < Instances.Num())
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsRenderDynamic);
+		error = (udError)RenderTarget(pRenderer, Instances.Slice(NumStaticInstances, Instances.Num() - NumStaticInstances), pRenderView, ColorBulkData.GetData(), DepthBulkData.GetData(), ViewArray, ProjArray, pPicking, Flags | udRCF_PreserveBuffers);
+	}
+
+	return error;
+}
+
+void UUDSubsystem::StageUpload()
+{
+	FScopeLock ScopeLock(&DataMutex);
+	const FTexture2DRHIRef Textures[UDS_MAX_OUTPUT_PLANES] = { ColorTexture, DepthTexture };
+
+	// Later uploads are diffed against this one, if it was never taken they can't be
+	if (PendingUpload.IsValid())
+	{
+		Uploader.Invalidate();
+	}
+	PendingUpload = Uploader.Upload(Textures, ColorBulkData.GetData(), DepthBulkData.GetData());
+
+	if (bStereo)
+	{
+		StageViewUpload(StereoEye);
+	}
+}
+
+void UUDSubsystem::StageViewUpload(FUDViewTarget& Target)
+{
+	const FTexture2DRHIRef Textures[UDS_MAX_OUTPUT_PLANES] = { Target.ColorTexture, Target.DepthTexture };
+
+	if (Target.PendingUpload.IsValid())
+	{
+		Target.Uploader.Invalidate();
+	}
+	Target.PendingUpload = Target.Uploader.Upload(Textures, Target.ColorBulkData.GetData(), Target.DepthBulkData.GetData());
+}
+
+int UUDSubsystem::CreateViewTarget(FUDViewTarget& Target, const FIntPoint& Size, EUDOutputFormat Format, struct udRenderContext* pSharedRenderer, const TCHAR* DebugName)
+{
+	enum udError error = udE_Success;
+
+	Target.Size = Size;
+	Target.Format = Format;
+
+	{
+		FScopeLock ScopeLock(&DataMutex);
+		const ETextureCreateFlags TexCreateFlags = FUDTextureUploader::GetTextureCreateFlags();
+
+		Target.ColorBulkData.ResizeArray(Size.X * Size.Y);
+		Target.DepthBulkData.ResizeArray(Size.X * Size.Y);
+
+		Target.ColorTexture = RHICreateTexture(FRHITextureCreateDesc::Create2D(*FString::Printf(TEXT("%s ColorTexture"), DebugName), Size.X, Size.Y, FUDTextureUploader::GetPlanePixelFormat(Format, 0))
+			.SetFlags(TexCreateFlags));
+
+		if (FUDTextureUploader::GetNumPlanes(Format) > 1)
+		{
+			Target.DepthTexture = RHICreateTexture(FRHITextureCreateDesc::Create2D(*FString::Printf(TEXT("%s DepthTexture"), DebugName), Size.X, Size.Y, FUDTextureUploader::GetPlanePixelFormat(Format, 1))
+				.SetFlags(TexCreateFlags));
+		}
+
+		Target.Uploader.Reset(Size.X, Size.Y, Format);
+	}
+
+	if (!pSharedRenderer)
+	{
+		error = udRenderContext_Create(pContext, &Target.pRenderer);
+	}
+
+	if (error == udE_Success)
+	{
+		error = udRenderTarget_Create(pContext, &Target.pRenderView, pSharedRenderer ? pSharedRenderer : Target.pRenderer, Size.X, Size.Y);
+	}
+
+	if (error != udE_Success)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | %s udRenderTarget_Create error : %s"), DebugName, GetError(error));
+	}
+
+	return error;
+}
+
+void UUDSubsystem::DestroyViewTarget(FUDViewTarget& Target)
+{
+	if (Target.pRenderView)
+	{
+		udRenderTarget_Destroy(&Target.pRenderView);
+	}
+	if (Target.pWideView)
+	{
+		udRenderTarget_Destroy(&Target.pWideView);
+	}
+	if (Target.pRenderer)
+	{
+		udRenderContext_Destroy(&Target.pRenderer);
+	}
+
+	FScopeLock ScopeLock(&DataMutex);
+	Target = FUDViewTarget();
+}
+
+int UUDSubsystem::RecreateStereoEye(bool bEnable, int32 InMargin)
+{
+	enum udError error = udE_Success;
+
+	// Kept while other views are captured in between, a VR spectator screen doesn't cost the eye its textures
+	bStereo = bEnable;
+	if (!bEnable)
+	{
+		return error;
+	}
+
+	const FIntPoint Size(Width, Height);
+	if (StereoEye.pRenderView && StereoEye.Size == Size && StereoEye.Format == OutputFormat && StereoEye.Margin == InMargin)
+	{
+		return error;
+	}
+
+	DestroyStereoEye();
+	bStereo = true;
+
+	// The eye has to render with the main renderer to see its traversal
+	error = (udError)CreateViewTarget(StereoEye, Size, OutputFormat, pRenderer, TEXT("UDStereoEye"));
+
+	StereoEye.Margin = InMargin;
+	if (error == udE_Success && StereoEye.Margin > 0)
+	{
+		StereoEye.WideColor.SetNumUninitialized((Width + StereoEye.Margin) * Height);
+		StereoEye.WideDepth.SetNumUninitialized((Width + StereoEye.Margin) * Height);
+		error = udRenderTarget_Create(pContext, &StereoEye.pWideView, pRenderer, Width + StereoEye.Margin, Height);
+	}
+
+	if (error != udE_Success)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_Create (stereo) error : %s"), GetError(error));
+		DestroyStereoEye();
+	}
+
+	return error;
+}
+
+void UUDSubsystem::DestroyStereoEye()
+{
+	DestroyViewTarget(StereoEye);
+	bStereo = false;
+}
+
+int UUDSubsystem::RecreateTiles(int32 InNumTiles)
+{
+	enum udError error = udE_Success;
+
+	const FIntPoint Size(Width, Height);
+	if (InNumTiles == TilesCount && (InNumTiles <= 1 || Size == TilesSize))
+	{
+		return error;
+	}
+
+	DestroyTiles();
+	if (InNumTiles <= 1)
+	{
+		return error;
+	}
+
+	TArray<FIntRect> Rects;
+	GetUdsTileRects(Size, InNumTiles, Rects);
+
+	TilesCount = InNumTiles;
+	TilesSize = Size;
+	Tiles.SetNum(Rects.Num());
+
+	// Tile 0 borrows the main renderer, the others each need one of their own to render at the same time
+	for (int32 t = 0; t < Tiles.Num() && error == udE_Success; ++t)
+	{
+		FUDRenderTile& Tile = Tiles[t];
+		Tile.Rect = Rects[t];
+
+		if (t > 0)
+		{
+			error = udRenderContext_Create(pContext, &Tile.pRenderer);
+		}
+
+		if (error == udE_Success)
+		{
+			error = udRenderTarget_Create(pContext, &Tile.pRenderView, Tile.pRenderer ? Tile.pRenderer : pRenderer, Tile.Rect.Width(), Tile.Rect.Height());
+		}
+	}
+
+	if (error != udE_Success)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_Create (tile) error : %s"), GetError(error));
+		DestroyTiles();
+	}
+
+	return error;
+}
+
+void UUDSubsystem::DestroyTiles()
+{
+	// A background render may be using them
+	WaitForRender();
+
+	for (FUDRenderTile& Tile : Tiles)
+	{
+		if (Tile.pRenderView)
+		{
+			udRenderTarget_Destroy(&Tile.pRenderView);
+		}
+		if (Tile.pRenderer)
+		{
+			udRenderContext_Destroy(&Tile.pRenderer);
+		}
+	}
+
+	Tiles.Reset();
+	TilesCount = 1;
+	TilesSize = FIntPoint::ZeroValue;
+}
+
+int UUDSubsystem::RecreateFarLayer(bool bEnable)
+{
+	enum udError error = udE_Success;
+
+	const FIntPoint Size = bEnable ? GetUdsFarLayerSize(FIntPoint(Width, Height)) : FIntPoint::ZeroValue;
+	if (bEnable == bLayers && Size == FarLayer.Size)
+	{
+		return error;
+	}
+
+	DestroyFarLayer();
+	if (!bEnable)
+	{
+		return error;
+	}
+
+	FarLayer.Size = Size;
+	FarLayer.Color.SetNumUninitialized(Size.X * Size.Y);
+	FarLayer.Depth.SetNumUninitialized(Size.X * Size.Y);
+
+	// Its own renderer, it renders at the same time as the main one
+	error = udRenderContext_Create(pContext, &FarLayer.pRenderer);
+	if (error == udE_Success)
+	{
+		error = udRenderTarget_Create(pContext, &FarLayer.pRenderView, FarLayer.pRenderer, Size.X, Size.Y);
+	}
+
+	if (error != udE_Success)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_Create (far layer) error : %s"), GetError(error));
+		DestroyFarLayer();
+		return error;
+	}
+
+	bLayers = true;
+	return error;
+}
+
+void UUDSubsystem::DestroyFarLayer()
+{
+	// A background render may be using it
+	WaitForRender();
+
+	if (FarLayer.pRenderView)
+	{
+		udRenderTarget_Destroy(&FarLayer.pRenderView);
+	}
+	if (FarLayer.pRenderer)
+	{
+		udRenderContext_Destroy(&FarLayer.pRenderer);
+	}
+
+	FarLayer = FUDRenderLayer();
+	bLayers = false;
+	bRenderFarLayer = false;
+}
+
+bool UUDSubsystem::CanCaptureParallel(const FSceneViewFamily& Family) const
+{
+	// The other modes all keep state for a single view
+	return HasSession() && Family.Views.Num() > 1 && GetUdsParallelViewWorkers() > 0 &&
+		!IsUdsTemporalEnabled() && !IsUdsCheckerboardEnabled() && !IsUdsRenderDecoupled() && GUdsProgressive <= 0;
+}
+
+void UUDSubsystem::BeginParallelCapture(const FSceneViewFamily& Family)
+{
+	check(ParallelTasks.Num() == 0);
+
+	const EUDOutputFormat RequestedFormat = (EUDOutputFormat)FMath::Clamp(GUdsOutputFormat, 0, (int32)EUDOutputFormat::MAX - 1);
+	const float ResolutionFraction = FMath::Clamp(GUdsScreenPercentage, 10.0f, 100.0f) / 100.0f;
+
+	NumParallelViews = Family.Views.Num() - 1;
+	while (ParallelViews.Num() > NumParallelViews)
+	{
+		DestroyViewTarget(*ParallelViews.Last());
+		ParallelViews.Pop();
+	}
+
+	// Everything a worker reads is set up here, on the game thread, before any of them starts
+	for (int32 i = 0; i < NumParallelViews; ++i)
+	{
+		const FSceneView& View = *Family.Views[i + 1];
+		if (!ParallelViews.IsValidIndex(i))
+		{
+			ParallelViews.Add(MakeUnique<FUDViewTarget>());
+		}
+		FUDViewTarget& Target = *ParallelViews[i];
+
+		const FIntPoint Size(
+			FMath::Clamp(FMath::CeilToInt(View.UnconstrainedViewRect.Width() * ResolutionFraction), 1, 8191),
+			FMath::Clamp(FMath::CeilToInt(View.UnconstrainedViewRect.Height() * ResolutionFraction), 1, 8191));
+
+		if (!Target.pRenderView || Target.Size != Size || Target.Format != RequestedFormat)
+		{
+			DestroyViewTarget(Target);
+			if (CreateViewTarget(Target, Size, RequestedFormat, nullptr, TEXT("UDParallelView")) != udE_Success)
+			{
+				DestroyViewTarget(Target);
+			}
+		}
+
+		FuncMat2Array(Target.ViewArray, View.ViewMatrices.GetViewMatrix());
+		FuncMat2Array(Target.ProjArray, GetUdsForwardZProjection(View.ViewMatrices.GetProjectionNoAAMatrix()));
+		GatherRenderInstances(View, false, Target.RenderInstances);
+		Target.RenderError = Target.pRenderView ? udE_Success : udE_Failure;
+		Target.RenderSeconds = 0.0;
+		Target.Coverage = FUDCoverage();
+	}
+
+	// Workers pull views until none are left; fewer workers than views leaves cores to the game and render threads
+	ParallelNextView = 0;
+	ParallelStartSeconds = FPlatformTime::Seconds();
+
+	const uint32 Flags = GetUdsBaseRenderFlags();
+	const int32 NumWorkers = FMath::Min(GetUdsParallelViewWorkers(), NumParallelViews);
+	for (int32 w = 0; w < NumWorkers; ++w)
+	{
+		ParallelTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, Flags]()
+		{
+			for (int32 i = ParallelNextView++; i < NumParallelViews; i = ParallelNextView++)
+			{
+				FUDViewTarget& Target = *ParallelViews[i];
+				if (Target.RenderError != udE_Success)
+					continue;
+
+				SCOPE_CYCLE_COUNTER(STAT_UdsRenderParallel);
+				const double RenderStart = FPlatformTime::Seconds();
+
+				udRenderPicking picking = {};
+				Target.RenderError = RenderTarget(Target.pRenderer, Target.RenderInstances, Target.pRenderView, Target.ColorBulkData.GetData(), Target.DepthBulkData.GetData(), Target.ViewArray, Target.ProjArray, &picking, Flags);
+				Target.RenderSeconds = FPlatformTime::Seconds() - RenderStart;
+
+				if (Target.RenderError == udE_Success)
+				{
+					Target.Coverage = UDBufferKernels::ComputeCoverage(Target.DepthBulkData.GetData(), Target.Size.X, Target.Size.Y);
+				}
+			}
+		}, UE::Tasks::ETaskPriority::BackgroundHigh));
+	}
+}
+
+void UUDSubsystem::FinishParallelCapture()
+{
+	UE::Tasks::Wait(ParallelTasks);
+	ParallelTasks.Reset();
+
+	SET_FLOAT_STAT(STAT_UdsParallelWallMs, (FPlatformTime::Seconds() - ParallelStartSeconds) * 1000.0);
+
+	for (int32 i = 0; i < NumParallelViews; ++i)
+	{
+		FUDViewTarget& Target = *ParallelViews[i];
+		if (Target.RenderError == udE_Success)
+		{
+			FScopeLock ScopeLock(&DataMutex);
+			StageViewUpload(Target);
+		}
+		FrameRenderSeconds += Target.RenderSeconds;
+	}
+}
+
+const FUDViewTarget* UUDSubsystem::CaptureThrottledView(const FSceneView& View, uint32 ViewKey, const FUDThrottle& Throttle)
+{
+	if (!HasSession())
+	{
+		return nullptr;
+	}
+
+	const uint32 FrameNumber = View.Family->FrameNumber;
+	if (FrameNumber != ThrottledFrame)
+	{
+		ThrottledFrame = FrameNumber;
+		NumThrottledRenders = 0;
+
+		// Views that stopped rendering give their targets back, like the composite's view states
+		for (auto It = ThrottledViews.CreateIterator(); It; ++It)
+		{
+			if (FrameNumber - It.Value()->LastUsedFrame > UDS_VIEW_STATE_TIMEOUT)
+			{
+				DestroyViewTarget(It.Value()->Target);
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	const EUDOutputFormat RequestedFormat = (EUDOutputFormat)FMath::Clamp(GUdsOutputFormat, 0, (int32)EUDOutputFormat::MAX - 1);
+	const float ResolutionFraction = Throttle.ResolutionFraction;
+	const FIntPoint Size(
+		FMath::Clamp(FMath::CeilToInt(View.UnconstrainedViewRect.Width() * ResolutionFraction), 1, 8191),
+		FMath::Clamp(FMath::CeilToInt(View.UnconstrainedViewRect.Height() * ResolutionFraction), 1, 8191));
+
+	TUniquePtr<FUDThrottledTarget>& Capture = ThrottledViews.FindOrAdd(ViewKey);
+	if (!Capture.IsValid())
+	{
+		Capture = MakeUnique<FUDThrottledTarget>();
+	}
+	Capture->LastUsedFrame = FrameNumber;
+	SET_DWORD_STAT(STAT_UdsThrottledTargets, ThrottledViews.Num());
+
+	FUDViewTarget& Target = Capture->Target;
+	if (Throttle.bPaused)
+	{
+		return Capture->bHasImage ? &Target : nullptr;
+	}
+
+	if (!Target.pRenderView || Target.Size != Size || Target.Format != RequestedFormat)
+	{
+		DestroyViewTarget(Target);
+		Capture->bHasImage = false;
+
+		enum udError error = udE_Success;
+		if (!pThrottledRenderer)
+		{
+			error = udRenderContext_Create(pContext, &pThrottledRenderer);
+		}
+		if (error == udE_Success)
+		{
+			error = (udError)CreateViewTarget(Target, Size, RequestedFormat, pThrottledRenderer, TEXT("UDThrottledView"));
+		}
+		if (error != udE_Success)
+		{
+			DestroyViewTarget(Target);
+			return nullptr;
+		}
+	}
+
+	// Unchanged since the image it holds, which the streamer has caught up with: nothing to render, nothing to upload
+	const FMatrix ViewProjection = View.ViewMatrices.GetViewMatrix() * View.ViewMatrices.GetProjectionNoAAMatrix();
+	const bool bChanged = !Capture->bHasImage || Capture->SceneRevision != SceneRevision || !ViewProjection.Equals(Capture->ViewProjection, UE_KINDA_SMALL_NUMBER);
+	if (!bChanged && Capture->bSettled)
+	{
+		return &Target;
+	}
+
+	// Changed or still streaming, but shown as it was until its interval has passed and the frame has room for it; overdue by 4 intervals goes over the budget
+	const int32 Interval = FMath::Max(Throttle.Interval, 1);
+	const uint32 FramesSinceRender = FrameNumber - Capture->RenderedFrame;
+	if (Capture->bHasImage && (FramesSinceRender < (uint32)Interval ||
+		(NumThrottledRenders >= Throttle.MaxPerFrame && FramesSinceRender < (uint32)Interval * 4)))
+	{
+		return &Target;
+	}
+
+	{
+		FScopeLock ScopeLock(&DataMutex);
+		FuncMat2Array(Target.ViewArray, View.ViewMatrices.GetViewMatrix());
+		FuncMat2Array(Target.ProjArray, GetUdsForwardZProjection(View.ViewMatrices.GetProjectionNoAAMatrix()));
+		GatherRenderInstances(View, false, Target.RenderInstances);
+	}
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsRenderThrottled);
+		const double RenderStart = FPlatformTime::Seconds();
+
+		udRenderPicking picking = {};
+		Target.RenderError = RenderTarget(pThrottledRenderer, Target.RenderInstances, Target.pRenderView, Target.ColorBulkData.GetData(), Target.DepthBulkData.GetData(),
+			Target.ViewArray, Target.ProjArray, &picking, GetUdsBaseRenderFlags());
+		Target.RenderSeconds = FPlatformTime::Seconds() - RenderStart;
+	}
+
+	++NumThrottledRenders;
+	SET_DWORD_STAT(STAT_UdsThrottledRenders, NumThrottledRenders);
+	AddFrameRenderSeconds(View, Target.RenderSeconds);
+
+	if (Target.RenderError != udE_Success)
+	{
+		return Capture->bHasImage ? &Target : nullptr;
+	}
+
+	// udSDK doesn't say when a view's streaming is done; rendering the same view again and getting the same image back is the sign
+	const uint32 ImageHash = FCrc::MemCrc32(Target.DepthBulkData.GetData(), Size.X * Size.Y * sizeof(float),
+		FCrc::MemCrc32(Target.ColorBulkData.GetData(), Size.X * Size.Y * sizeof(FColor)));
+	Capture->bSettled = !bChanged && ImageHash == Capture->ImageHash;
+	Capture->ImageHash = ImageHash;
+
+	Target.Coverage = UDBufferKernels::ComputeCoverage(Target.DepthBulkData.GetData(), Size.X, Size.Y);
+	{
+		FScopeLock ScopeLock(&DataMutex);
+		StageViewUpload(Target);
+	}
+
+	Capture->bHasImage = true;
+	Capture->ViewProjection = ViewProjection;
+	Capture->SceneRevision = SceneRevision;
+	Capture->RenderedFrame = FrameNumber;
+
+	return &Target;
+}
+
+FUDTextureUploadPtr UUDSubsystem::TakeThrottledUpload(uint32 ViewKey)
+{
+	TUniquePtr<FUDThrottledTarget>* Capture = ThrottledViews.Find(ViewKey);
+	return Capture ? MoveTemp((*Capture)->Target.PendingUpload) : nullptr;
+}
+
+int UUDSubsystem::RecreateUDView(int32 InWidth, int32 InHeight, bool bInCheckerboard, bool bInFoveated)
+{
+	enum udError error = udE_Success;
+	const EUDOutputFormat RequestedFormat = (EUDOutputFormat)FMath::Clamp(GUdsOutputFormat, 0, (int32)EUDOutputFormat::MAX - 1);
+	const FIntPoint RequestedFoveatedSizes[2] = {
+		bInFoveated ? GetUdsFoveatedOuterSize(FIntPoint(InWidth, InHeight)) : FIntPoint::ZeroValue,
+		bInFoveated ? GetUdsFoveatedInnerSize(FIntPoint(InWidth, InHeight)) : FIntPoint::ZeroValue };
+
+	if (InWidth == Width && InHeight == Height && RequestedFormat == OutputFormat && bInCheckerboard == bCheckerboard &&
+		RequestedFoveatedSizes[0] == FoveatedSizes[0] && RequestedFoveatedSizes[1] == FoveatedSizes[1])
+	{
+		return error;
+	}
+
+	// The buffers and render target are about to go, a background render can't be writing to them
+	WaitForRender();
+	++NumViewRecreations;
+
+	Width = InWidth;
+	Height = InHeight;
+	OutputFormat = RequestedFormat;
+	bCheckerboard = bInCheckerboard;
+	bCheckerboardHistory = false;
+	bFoveated = bInFoveated;
+	FoveatedSizes[0] = RequestedFoveatedSizes[0];
+	FoveatedSizes[1] = RequestedFoveatedSizes[1];
+
+	UE_LOG(LogTemp, Display, TEXT("RecreateUDView() Width: %d, Height: %d"), Width, Height);
+
+	{
+		FScopeLock ScopeLock(&DataMutex);
+		ETextureCreateFlags TexCreateFlags = FUDTextureUploader::GetTextureCreateFlags(); // Flags for .SetFlags()
+		{
+
+		
+			ColorBulkData.ResizeArray(Width * Height);
+			const FString DebugName = "RecreateUDView ColorTexture";
+			
+			//RHICreateTexture2D - DEPRECATED in 5.1, use RHICreateTexture(FRHITextureCreateDesc) instead
+			// ColorTexture = RHICreateTexture2D(Width, Height, EPixelFormat::PF_B8G8R8A8, 1, 1, TexCreateFlags, CreateInfo); // 4.27 Line
+
+			// FRHIResourceCreateInfo CreateInfo;
+			//FRHIResourceCreateInfo
+
+			// New 5.1 texture descriptor
+			FRHITextureCreateDesc ColorTextureDescriptor = FRHITextureCreateDesc::Create2D(*DebugName, Width, Height, FUDTextureUploader::GetPlanePixelFormat(OutputFormat, 0));
+
+			&ColorTextureDescriptor.SetFlags(TexCreateFlags);
+			&ColorTextureDescriptor.SetNumMips(1);
+			&ColorTextureDescriptor.SetNumSamples(1);
+
+			ColorTexture = RHICreateTexture(ColorTextureDescriptor);
+		}
+
+		{
+			// Size the array to match the possible screen size
+			// Screen size changes in editor all the time so this is required
+			DepthBulkData.ResizeArray(Width * Height);
+			
+			const FString DebugName = "RecreateUDView DepthTexture"; // 5.1 API might require a name to be passed in
+
+			// Packed output carries depth in the color texture
+			if (FUDTextureUploader::GetNumPlanes(OutputFormat) > 1)
+			{
+				// New 5.1 descriptor
+				FRHITextureCreateDesc DepthTextureDescr = FRHITextureCreateDesc::Create2D(*DebugName, Width, Height, FUDTextureUploader::GetPlanePixelFormat(OutputFormat, 1));
+				
+				&DepthTextureDescr.SetNumMips(1);
+				&DepthTextureDescr.SetNumSamples(1);
+				&DepthTextureDescr.SetFlags(TexCreateFlags);
+				
+				DepthTexture = RHICreateTexture(DepthTextureDescr);
+			}
+			else
+			{
+				DepthTexture = nullptr;
+			}
+		}
+
+		// New textures have no content yet
+		Uploader.Reset(Width, Height, OutputFormat);
+		PendingUpload.Reset();
+	}
+
+	
+
+	if (pRenderView)
+	{
+		error = udRenderTarget_Destroy(&pRenderView);
+		if (error != udE_Success)
+		{
+			UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_Destroy error : %s"), GetError(error));
+			return error;
+		}
+		pRenderView = nullptr;
+	}
+
+	
+	error = udRenderTarget_Create(pContext, &pRenderView, pRenderer, Width, Height);
+	
+	if (error != udE_Success)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_Create error : %s"), GetError(error));
+	}
+
+	for (int32 t = 0; t < 2; ++t)
+	{
+		if (pCheckerboardViews[t])
+		{
+			udRenderTarget_Destroy(&pCheckerboardViews[t]);
+			pCheckerboardViews[t] = nullptr;
+		}
+
+		if (bCheckerboard && error == udE_Success)
+		{
+			CheckerboardColor[t].SetNumUninitialized((Width / 2) * (Height / 2));
+			CheckerboardDepth[t].SetNumUninitialized((Width / 2) * (Height / 2));
+
+			error = udRenderTarget_Create(pContext, &pCheckerboardViews[t], pRenderer, Width / 2, Height / 2);
+			if (error != udE_Success)
+			{
+				UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_Create (checkerboard) error : %s"), GetError(error));
+			}
+		}
+		else
+		{
+			CheckerboardColor[t].Empty();
+			CheckerboardDepth[t].Empty();
+		}
+
+		if (pFoveatedViews[t])
+		{
+			udRenderTarget_Destroy(&pFoveatedViews[t]);
+			pFoveatedViews[t] = nullptr;
+		}
+
+		if (bFoveated && error == udE_Success)
+		{
+			FoveatedColor[t].SetNumUninitialized(FoveatedSizes[t].X * FoveatedSizes[t].Y);
+			FoveatedDepth[t].SetNumUninitialized(FoveatedSizes[t].X * FoveatedSizes[t].Y);
+
+			error = udRenderTarget_Create(pContext, &pFoveatedViews[t], pRenderer, FoveatedSizes[t].X, FoveatedSizes[t].Y);
+			if (error != udE_Success)
+			{
+				UE_LOG(LogTemp, Error, TEXT("UnlimitedDetail | udRenderTarget_Create (foveated) error : %s"), GetError(error));
+			}
+		}
+		else
+		{
+			FoveatedColor[t].Empty();
+			FoveatedDepth[t].Empty();
+		}
 	}
 
 	return error;
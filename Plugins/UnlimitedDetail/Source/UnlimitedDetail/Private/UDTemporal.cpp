@@ -0,0 +1,75 @@
+#include "UDTemporal.h"
+#include "SceneView.h"
+
+static int32 GUdsTemporal = 0;
+static FAutoConsoleVariableRef CVarUdsTemporal(
+	TEXT("r.Uds.Temporal"),
+	GUdsTemporal,
+	TEXT("Renders UD at the view's internal resolution with a jittered projection and writes it into scene color before post processing,\n")
+	TEXT("so TSR / TAA upsample and accumulate it like the rest of the frame and UD cost follows r.ScreenPercentage.\n")
+	TEXT("Turns on the depth prepass (r.Uds.DepthPrepass 1) if it is off, TSR reprojects UD pixels with their depth. 1 on, 0 off (default)"),
+	ECVF_Default);
+
+static float Halton(int32 Index, int32 Base)
+{
+	float Result = 0.0f;
+	const float InvBase = 1.0f / Base;
+	float Fraction = InvBase;
+	while (Index > 0)
+	{
+		Result += (Index % Base) * Fraction;
+		Index /= Base;
+		Fraction *= InvBase;
+	}
+	return Result;
+}
+
+bool IsUdsTemporalEnabled()
+{
+	return GUdsTemporal > 0;
+}
+
+FIntPoint GetUdsTemporalRenderSize(const FSceneView& View)
+{
+	const FIntPoint OutputSize = View.UnconstrainedViewRect.Size();
+
+	// The exact view rect is only decided once the renderer sets up the views, dynamic resolution can go below this.
+	// The prepass and composite scale UD onto whatever rect it ends up being.
+	float ResolutionFraction = 1.0f;
+	if (View.Family->EngineShowFlags.ScreenPercentage && View.Family->GetScreenPercentageInterface())
+	{
+		ResolutionFraction = FMath::Clamp(View.Family->GetPrimaryResolutionFractionUpperBound(), 0.01f, 1.0f);
+	}
+
+	return FIntPoint(
+		FMath::Max(FMath::CeilToInt(OutputSize.X * ResolutionFraction), 1),
+		FMath::Max(FMath::CeilToInt(OutputSize.Y * ResolutionFraction), 1));
+}
+
+FVector2f GetUdsTemporalJitter(uint32 FrameNumber)
+{
+	static const auto CVarTemporalAASamples = IConsoleManager::Get().FindTConsoleVariableDataInt(TEXT("r.TemporalAASamples"));
+	const int32 NumSamples = FMath::Max(CVarTemporalAASamples ? CVarTemporalAASamples->GetValueOnGameThread() : 8, 1);
+
+	const int32 Index = (int32)(FrameNumber % (uint32)NumSamples) + 1;
+	return FVector2f(Halton(Index, 2) - 0.5f, Halton(Index, 3) - 0.5f);
+}
+
+void ApplyUdsTemporalJitter(FMatrix& Projection, const FVector2f& Jitter, const FIntPoint& Size)
+{
+	// Matches FViewMatrices::HackAddTemporalAAProjectionJitter, clip space Y points up. An orthographic projection has w = 1, its offset is the translation row.
+	const int32 Row = (Projection.M[3][3] == 0.0) ? 2 : 3;
+	Projection.M[Row][0] += Jitter.X * 2.0f / Size.X;
+	Projection.M[Row][1] -= Jitter.Y * 2.0f / Size.Y;
+}
+
+FMatrix GetUdsForwardZProjection(const FMatrix& Projection)
+{
+	// z' = w - z: near / d becomes 1 - near / d in perspective, 1 - z in orthographic where w = 1. x, y and w, jitter included, are untouched.
+	FMatrix Result = Projection;
+	for (int32 Row = 0; Row < 4; ++Row)
+	{
+		Result.M[Row][2] = Projection.M[Row][3] - Projection.M[Row][2];
+	}
+	return Result;
+}
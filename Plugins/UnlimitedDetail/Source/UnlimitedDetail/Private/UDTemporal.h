@@ -0,0 +1,22 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSceneView;
+
+// Value of r.Uds.Temporal, read on the game thread when a view's UD capture is set up
+bool IsUdsTemporalEnabled();
+
+// Size UD renders a view at in temporal mode: the view's internal resolution under r.ScreenPercentage
+FIntPoint GetUdsTemporalRenderSize(const FSceneView& View);
+
+// Sub pixel offset, in UD pixels, UD is rendered with on this frame. Follows the Halton(2, 3) sequence UE's temporal AA jitters with,
+// but not necessarily in step with the view's; passes reading UD offset their lookups by the difference.
+FVector2f GetUdsTemporalJitter(uint32 FrameNumber);
+
+// Offsets a projection for a Size target by Jitter pixels, the same way the renderer jitters the view projection
+void ApplyUdsTemporalJitter(FMatrix& Projection, const FVector2f& Jitter, const FIntPoint& Size);
+
+// The projection udSDK is given for a UE one. udSDK writes forward Z (1 - near / d for a perspective view, clearing to 1),
+// which is what the depth decode, quantization and coverage all expect; UE's projections are reversed Z.
+FMatrix GetUdsForwardZProjection(const FMatrix& Projection);
@@ -0,0 +1,361 @@
+#include "UDTextureUploader.h"
+#include "UDBufferKernels.h"
+#include "RenderGraphUtils.h"
+
+static int32 GUdsUploadDirtyRects = 1;
+static FAutoConsoleVariableRef CVarUdsUploadDirtyRects(
+	TEXT("r.Uds.Upload.DirtyRects"),
+	GUdsUploadDirtyRects,
+	TEXT("Only upload the regions of the UD textures that changed since the previous frame = 1 or 0"),
+	ECVF_Default);
+
+static int32 GUdsUploadTileSize = 64;
+static FAutoConsoleVariableRef CVarUdsUploadTileSize(
+	TEXT("r.Uds.Upload.TileSize"),
+	GUdsUploadTileSize,
+	TEXT("Size in pixels of the tiles compared when finding changed regions"),
+	ECVF_Default);
+
+static int32 GUdsUploadMaxRegions = 32;
+static FAutoConsoleVariableRef CVarUdsUploadMaxRegions(
+	TEXT("r.Uds.Upload.MaxRegions"),
+	GUdsUploadMaxRegions,
+	TEXT("Maximum number of separate texture updates per frame before the changed regions collapse into their bounding rect"),
+	ECVF_Default);
+
+DECLARE_CYCLE_STAT(TEXT("Convert Output Format"), STAT_UdsConvertOutput, STATGROUP_UnlimitedDetail);
+DECLARE_CYCLE_STAT(TEXT("Find Dirty Regions"), STAT_UdsFindDirtyRegions, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Uploaded Bytes"), STAT_UdsUploadedBytes, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Upload Regions"), STAT_UdsUploadRegions, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dropped Uploads"), STAT_UdsUploadsDropped, STATGROUP_UnlimitedDetail);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Upload Staging Buffers"), STAT_UdsUploadStagingBuffers, STATGROUP_UnlimitedDetail);
+
+DECLARE_GPU_STAT(UnlimitedDetailUpload)
+
+// Matches UDS_UPLOAD_FORMAT_* in Uds_Upload.usf
+enum class EUdsUploadFormat : uint8
+{
+	Color,
+	Float,
+	Half,
+	Uint,
+
+	MAX
+};
+
+///
+/// COMPUTE SHADER
+///
+class FUdsUploadCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FUdsUploadCS);
+	SHADER_USE_PARAMETER_STRUCT(FUdsUploadCS, FGlobalShader);
+
+	class FUploadFormatDim : SHADER_PERMUTATION_ENUM_CLASS("UDS_UPLOAD_FORMAT", EUdsUploadFormat);
+	using FPermutationDomain = TShaderPermutationDomain<FUploadFormatDim>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_BUFFER_SRV(ByteAddressBuffer, UploadBuffer)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, RWFloatTexture)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<uint>, RWUintTexture)
+		SHADER_PARAMETER(uint32, SourceOffset)
+		SHADER_PARAMETER(FIntPoint, RectMin)
+		SHADER_PARAMETER(FIntPoint, RectSize)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEX"), FComputeShaderUtils::kGolden2DGroupSize);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZEY"), FComputeShaderUtils::kGolden2DGroupSize);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUdsUploadCS, "/Plugins/UnlimitedDetail/Private/Uds_Upload.usf", "UploadCS", SF_Compute);
+
+static EUdsUploadFormat GetUploadFormat(EPixelFormat PixelFormat)
+{
+	switch (PixelFormat)
+	{
+	case PF_R8G8B8A8:
+		return EUdsUploadFormat::Color;
+	case PF_R16F:
+		return EUdsUploadFormat::Half;
+	case PF_R32_UINT:
+		return EUdsUploadFormat::Uint;
+	default:
+		return EUdsUploadFormat::Float;
+	}
+}
+
+// Staged blocks start on a dword so the shader can address them with ByteAddressBuffer loads
+static int64 GetStagedBlockBytes(const FIntRect& Rect, int32 BytesPerPixel)
+{
+	return Align((int64)Rect.Area() * BytesPerPixel, 4);
+}
+
+int32 FUDTextureUploader::GetNumPlanes(EUDOutputFormat Format)
+{
+	return (Format == EUDOutputFormat::Packed) ? 1 : 2;
+}
+
+EPixelFormat FUDTextureUploader::GetPlanePixelFormat(EUDOutputFormat Format, int32 Plane)
+{
+	switch (Format)
+	{
+	// Color is uploaded as udSDK's BGRA bytes and swizzled by UploadCS; RGBA has typed UAV stores everywhere, BGRA doesn't
+	case EUDOutputFormat::Depth16:
+		return (Plane == 0) ? PF_R8G8B8A8 : PF_R16F;
+	case EUDOutputFormat::Packed:
+		return PF_R32_UINT;
+	default:
+		return (Plane == 0) ? PF_R8G8B8A8 : PF_R32_FLOAT;
+	}
+}
+
+int32 FUDTextureUploader::GetBytesPerPixel(EUDOutputFormat Format, int32 Plane)
+{
+	return GPixelFormats[GetPlanePixelFormat(Format, Plane)].BlockBytes;
+}
+
+bool FUDTextureUploader::IsPlaneConverted(EUDOutputFormat Format, int32 Plane)
+{
+	return (Format == EUDOutputFormat::Packed) || (Format == EUDOutputFormat::Depth16 && Plane == 1);
+}
+
+void FUDTextureUploader::ConvertPlanes(EUDOutputFormat Format, const FColor* pColor, const float* pDepth, int32 Count, uint8* const* ppScratch, const uint8** ppOutPlanes)
+{
+	switch (Format)
+	{
+	case EUDOutputFormat::Depth16:
+		UDBufferKernels::ConvertDepthToHalf(pDepth, reinterpret_cast<uint16*>(ppScratch[1]), Count);
+		ppOutPlanes[0] = reinterpret_cast<const uint8*>(pColor);
+		ppOutPlanes[1] = ppScratch[1];
+		break;
+	case EUDOutputFormat::Packed:
+		UDBufferKernels::PackColorDepth(pColor, pDepth, reinterpret_cast<uint32*>(ppScratch[0]), Count);
+		ppOutPlanes[0] = ppScratch[0];
+		break;
+	default:
+		ppOutPlanes[0] = reinterpret_cast<const uint8*>(pColor);
+		ppOutPlanes[1] = reinterpret_cast<const uint8*>(pDepth);
+		break;
+	}
+}
+
+void FUDTextureUploader::Reset(int32 InWidth, int32 InHeight, EUDOutputFormat InFormat)
+{
+	Width = InWidth;
+	Height = InHeight;
+	Format = InFormat;
+	bForceFullUpload = true;
+
+	NumPlanes = GetNumPlanes(Format);
+	for (int32 p = 0; p < UDS_MAX_OUTPUT_PLANES; ++p)
+	{
+		FPlane& Plane = Planes[p];
+		Plane.BytesPerPixel = (p < NumPlanes) ? GetBytesPerPixel(Format, p) : 0;
+		Plane.Prev.SetNumUninitialized(Width * Height * Plane.BytesPerPixel, false);
+		Plane.Converted.SetNumUninitialized(IsPlaneConverted(Format, p) ? Plane.Prev.Num() : 0, false);
+	}
+}
+
+FUDTextureUploadPtr FUDTextureUploader::AcquireStagingBuffer()
+{
+	for (const FUDTextureUploadPtr& Staging : StagingBuffers)
+	{
+		// Only the uploader hands these out, so one reference means no pending upload or graph still reads it
+		if (Staging.GetSharedReferenceCount() == 1)
+			return Staging;
+	}
+
+	INC_DWORD_STAT(STAT_UdsUploadStagingBuffers);
+	return StagingBuffers.Add_GetRef(MakeShared<FUDTextureUpload, ESPMode::ThreadSafe>());
+}
+
+FUDTextureUploadPtr FUDTextureUploader::Upload(const FTexture2DRHIRef* pTextures, const FColor* pColor, const float* pDepth)
+{
+	check(IsInGameThread());
+
+	if (Width <= 0 || Height <= 0)
+		return nullptr;
+
+	// Dropped before it reached the textures, they don't hold what the diff would assume
+	for (const FUDTextureUploadPtr& Dropped : StagingBuffers)
+	{
+		if (Dropped.GetSharedReferenceCount() == 1 && Dropped->bPending.exchange(false))
+		{
+			INC_DWORD_STAT(STAT_UdsUploadsDropped);
+			bForceFullUpload = true;
+		}
+	}
+
+	FUDTextureUploadPtr Staging = AcquireStagingBuffer();
+
+	uint8* ppScratch[UDS_MAX_OUTPUT_PLANES] = {};
+	const uint8* ppSources[UDS_MAX_OUTPUT_PLANES] = {};
+	for (int32 p = 0; p < NumPlanes; ++p)
+	{
+		ppScratch[p] = Planes[p].Converted.GetData();
+	}
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsConvertOutput);
+		ConvertPlanes(Format, pColor, pDepth, Width * Height, ppScratch, ppSources);
+	}
+
+	if (bForceFullUpload || GUdsUploadDirtyRects == 0)
+	{
+		Staging->Rects.Reset();
+		Staging->Rects.Add(FIntRect(0, 0, Width, Height));
+
+		for (int32 p = 0; p < NumPlanes; ++p)
+		{
+			FMemory::Memcpy(Planes[p].Prev.GetData(), ppSources[p], Planes[p].Prev.Num());
+		}
+
+		bForceFullUpload = false;
+	}
+	else
+	{
+		SCOPE_CYCLE_COUNTER(STAT_UdsFindDirtyRegions);
+
+		UDBufferKernels::FDirtyPlane DirtyPlanes[UDS_MAX_OUTPUT_PLANES];
+		for (int32 p = 0; p < NumPlanes; ++p)
+		{
+			DirtyPlanes[p] = { ppSources[p], Planes[p].Prev.GetData(), Planes[p].BytesPerPixel };
+		}
+
+		UDBufferKernels::ComputeDirtyRects(DirtyPlanes, NumPlanes, Width, Height, FMath::Max(GUdsUploadTileSize, 4), FMath::Max(GUdsUploadMaxRegions, 1), Staging->Rects);
+	}
+
+	if (Staging->Rects.Num() == 0)
+		return nullptr;
+
+	int64 TotalBytes = 0;
+	for (const FIntRect& Rect : Staging->Rects)
+	{
+		for (int32 p = 0; p < NumPlanes; ++p)
+		{
+			TotalBytes += GetStagedBlockBytes(Rect, Planes[p].BytesPerPixel);
+		}
+	}
+
+	// Staged rather than read from the bulk data on the render thread, the game thread is already rendering the next frame into it by then
+	Staging->Data.SetNumUninitialized((int32)TotalBytes, false);
+
+	uint8* pBlock = Staging->Data.GetData();
+	for (const FIntRect& Rect : Staging->Rects)
+	{
+		for (int32 p = 0; p < NumPlanes; ++p)
+		{
+			uint8* pDest = pBlock;
+			const int32 RowBytes = Rect.Width() * Planes[p].BytesPerPixel;
+			for (int32 y = Rect.Min.Y; y < Rect.Max.Y; ++y, pDest += RowBytes)
+			{
+				FMemory::Memcpy(pDest, ppSources[p] + ((SIZE_T)y * Width + Rect.Min.X) * Planes[p].BytesPerPixel, RowBytes);
+			}
+			pBlock += GetStagedBlockBytes(Rect, Planes[p].BytesPerPixel);
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_UdsUploadedBytes, (uint32)TotalBytes);
+	INC_DWORD_STAT_BY(STAT_UdsUploadRegions, Staging->Rects.Num());
+
+	for (int32 p = 0; p < UDS_MAX_OUTPUT_PLANES; ++p)
+	{
+		Staging->Textures[p] = (p < NumPlanes) ? pTextures[p] : nullptr;
+	}
+	Staging->Format = Format;
+	Staging->NumPlanes = NumPlanes;
+	Staging->bPending = true;
+
+	return Staging;
+}
+
+ETextureCreateFlags FUDTextureUploader::GetTextureCreateFlags()
+{
+	return TexCreate_ShaderResource | TexCreate_UAV;
+}
+
+FRDGTextureRef FUDTextureUploader::RegisterTexture(FRDGBuilder& GraphBuilder, const FTexture2DRHIRef& Texture)
+{
+	// RDG returns the texture it already has when the same RHI texture is registered again in a graph
+	return GraphBuilder.RegisterExternalTexture(CreateRenderTarget(Texture, TEXT("Uds.Output")));
+}
+
+void FUDTextureUploader::AddUploadPasses(FRDGBuilder& GraphBuilder, const FUDTextureUploadPtr& Upload)
+{
+	check(IsInRenderingThread());
+
+	if (!Upload.IsValid())
+		return;
+
+	// Reached the graph, which holds it until the copy passes have run
+	Upload->bPending = false;
+
+	if (Upload->Rects.Num() == 0)
+		return;
+
+	RDG_GPU_STAT_SCOPE(GraphBuilder, UnlimitedDetailUpload);
+	RDG_EVENT_SCOPE(GraphBuilder, "UdsUpload %d regions", Upload->Rects.Num());
+
+	// The graph keeps the staging buffer alive until the upload has been read, the uploader reuses it after that
+	const FUDTextureUploadPtr& StagingRef = *GraphBuilder.AllocObject<FUDTextureUploadPtr>(Upload);
+
+	FRDGBufferRef UploadBuffer = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateByteAddressDesc(StagingRef->Data.Num()), TEXT("Uds.UploadBuffer"));
+	GraphBuilder.QueueBufferUpload(UploadBuffer, StagingRef->Data.GetData(), StagingRef->Data.Num(), ERDGInitialDataFlags::NoCopy);
+	FRDGBufferSRVRef UploadBufferSRV = GraphBuilder.CreateSRV(UploadBuffer);
+
+	FRDGTextureUAVRef PlaneUAVs[UDS_MAX_OUTPUT_PLANES] = {};
+	EUdsUploadFormat PlaneFormats[UDS_MAX_OUTPUT_PLANES] = {};
+	int32 PlaneBytesPerPixel[UDS_MAX_OUTPUT_PLANES] = {};
+	for (int32 p = 0; p < StagingRef->NumPlanes; ++p)
+	{
+		if (StagingRef->Textures[p].IsValid())
+		{
+			PlaneUAVs[p] = GraphBuilder.CreateUAV(RegisterTexture(GraphBuilder, StagingRef->Textures[p]));
+		}
+		PlaneFormats[p] = GetUploadFormat(GetPlanePixelFormat(StagingRef->Format, p));
+		PlaneBytesPerPixel[p] = GetBytesPerPixel(StagingRef->Format, p);
+	}
+
+	FGlobalShaderMap* ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+
+	uint32 SourceOffset = 0;
+	for (const FIntRect& Rect : StagingRef->Rects)
+	{
+		for (int32 p = 0; p < StagingRef->NumPlanes; ++p)
+		{
+			if (PlaneUAVs[p])
+			{
+				FUdsUploadCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FUdsUploadCS::FParameters>();
+				PassParameters->UploadBuffer = UploadBufferSRV;
+				if (PlaneFormats[p] == EUdsUploadFormat::Uint)
+				{
+					PassParameters->RWUintTexture = PlaneUAVs[p];
+				}
+				else
+				{
+					PassParameters->RWFloatTexture = PlaneUAVs[p];
+				}
+				PassParameters->SourceOffset = SourceOffset;
+				PassParameters->RectMin = Rect.Min;
+				PassParameters->RectSize = Rect.Size();
+
+				FUdsUploadCS::FPermutationDomain PermutationVector;
+				PermutationVector.Set<FUdsUploadCS::FUploadFormatDim>(PlaneFormats[p]);
+				TShaderMapRef<FUdsUploadCS> ComputeShader(ShaderMap, PermutationVector);
+
+				FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Plane %d %dx%d", p, Rect.Width(), Rect.Height()), ComputeShader, PassParameters,
+					FComputeShaderUtils::GetGroupCount(Rect.Size(), FComputeShaderUtils::kGolden2DGroupSize));
+			}
+
+			SourceOffset += (uint32)GetStagedBlockBytes(Rect, PlaneBytesPerPixel[p]);
+		}
+	}
+}
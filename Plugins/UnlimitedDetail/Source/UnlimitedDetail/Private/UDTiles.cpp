@@ -0,0 +1,68 @@
+#include "UDTiles.h"
+#include "Async/TaskGraphInterfaces.h"
+
+static int32 GUdsTiles = 1;
+static FAutoConsoleVariableRef CVarUdsTiles(
+	TEXT("r.Uds.Tiles"),
+	GUdsTiles,
+	TEXT("Splits the main UD view into this many sub-frusta, each rendered by its own udRenderContext on a task worker straight into its part of\n")
+	TEXT("the view's buffers. For machines where one udRenderContext_Render doesn't use every core; Uds.Benchmark.Tiles finds the count.\n")
+	TEXT("Ignored with r.Uds.Checkerboard, r.Uds.Foveated and r.Uds.Stereo. 1 renders in one piece (default)"),
+	ECVF_Default);
+
+static int32 GUdsTilesLayout = 0;
+static FAutoConsoleVariableRef CVarUdsTilesLayout(
+	TEXT("r.Uds.Tiles.Layout"),
+	GUdsTilesLayout,
+	TEXT("How r.Uds.Tiles splits the view.\n")
+	TEXT(" 0: Horizontal bands, one above the other (default)\n")
+	TEXT(" 1: A grid as close to square as the count allows"),
+	ECVF_Default);
+
+int32 GetUdsTileCount()
+{
+	return FMath::Clamp(GUdsTiles, 1, 64);
+}
+
+int32 GetUdsTileWorkers(int32 NumTiles)
+{
+	// The calling thread renders tiles too, it only waits once there are none left to take
+	const int32 MaxWorkers = FMath::Max(FTaskGraphInterface::Get().GetNumWorkerThreads() - 1, 0);
+	return FMath::Min(NumTiles - 1, MaxWorkers);
+}
+
+void GetUdsTileRects(const FIntPoint& Size, int32 NumTiles, TArray<FIntRect>& OutRects)
+{
+	OutRects.Reset(NumTiles);
+
+	// Never more bands than rows, or columns than columns
+	int32 Rows = FMath::Min(NumTiles, Size.Y);
+	int32 Columns = 1;
+	if (GUdsTilesLayout == 1)
+	{
+		Rows = FMath::Max(FMath::FloorToInt(FMath::Sqrt((float)NumTiles)), 1);
+		while (NumTiles % Rows != 0)
+		{
+			--Rows;
+		}
+		Columns = NumTiles / Rows;
+
+		// Views are wider than they are tall
+		if (Size.X < Size.Y)
+		{
+			Swap(Rows, Columns);
+		}
+		Rows = FMath::Min(Rows, Size.Y);
+		Columns = FMath::Min(Columns, Size.X);
+	}
+
+	for (int32 y = 0; y < Rows; ++y)
+	{
+		for (int32 x = 0; x < Columns; ++x)
+		{
+			OutRects.Emplace(
+				Size.X * x / Columns, Size.Y * y / Rows,
+				Size.X * (x + 1) / Columns, Size.Y * (y + 1) / Rows);
+		}
+	}
+}
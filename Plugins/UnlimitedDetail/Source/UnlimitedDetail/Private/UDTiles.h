@@ -0,0 +1,12 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Sub-frusta r.Uds.Tiles splits the main view's render into, 1 when it renders in one piece
+int32 GetUdsTileCount();
+
+// Workers the tiles after the calling thread's are rendered on
+int32 GetUdsTileWorkers(int32 NumTiles);
+
+// Rects NumTiles tiles cover a Size render with, in r.Uds.Tiles.Layout; they don't overlap and cover every pixel
+void GetUdsTileRects(const FIntPoint& Size, int32 NumTiles, TArray<FIntRect>& OutRects);
@@ -24,14 +24,20 @@ public:
 	UFUNCTION(CallInEditor, BlueprintCallable, Category = "UnlimitedDetail")
 	void RefreshPointCloud();
 
+	// Moves at runtime, rendered every frame over the cached static instances with r.Uds.StaticCache
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "UnlimitedDetail")
+	bool bDynamic = false;
+
 private:
 	void LoadPointCloud();
 	void UnloadPointCloud();
+	void OnPointCloudLoaded(const FString& RequestedUrl, struct FUDPointCloudHandle* Handle);
 
 	UPROPERTY(EditAnywhere, BlueprintGetter = GetUrl, BlueprintSetter = SetUrl, Category = "UnlimitedDetail")
 	FString Url;
 
 	struct FUDPointCloudHandle* PointCloudHandle;
+	bool bLoadRequested = false; // Waiting on the udSDK login, see UUDSubsystem::RequestLoad
 
 protected:
 	/** Overridable native event for when play begins for this actor. */
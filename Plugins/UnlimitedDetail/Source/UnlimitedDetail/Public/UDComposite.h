@@ -6,6 +6,7 @@
 #include "PostProcess/TemporalAA.h"
 
 class FUdsSubpass;
+class FSceneView;
 
 enum class EUdsMode
 {
@@ -15,18 +16,44 @@ enum class EUdsMode
 	Combined
 };
 
-class FUDComposite final : public ISpatialUpscaler
+// Number of frames of per-view data kept in flight; the game thread fills frame N while the render thread may still be consuming frame N - 1
+#define UDS_FRAME_SLOTS 3
+
+// Views that haven't been rendered for this many frames have their pooled state released
+#define UDS_VIEW_STATE_TIMEOUT 60
+
+// Persistent composite state, owned by the scene view extension and shared by every FUDComposite handed to the renderer.
+// Subpasses are created once and per-view data is pooled, so nothing is allocated on the render path once a view has been seen.
+class FUdsCompositeState
 {
 public:
-	FUDComposite(EUdsMode InMode, TArray<TSharedPtr<FUdsData>> InViewData);
+	FUdsCompositeState(EUdsMode InMode);
+	~FUdsCompositeState();
 
-	// ISpatialUpscaler interface
-	const TCHAR* GetDebugName() const override { return TEXT("FUDComposite"); }
+	// Game thread: returns the (reset) data slot for this view and frame, creating the view's pooled state on first use
+	FUdsData* BeginViewFrame_GameThread(const FSceneView& View, int32 ViewIndex);
 
-	ISpatialUpscaler* Fork_GameThread(const class FSceneViewFamily& ViewFamily) const override;
-	FScreenPassTexture AddPasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs) const override;
+	// Game thread: releases pooled state for views that are no longer being rendered
+	void EndFrame_GameThread(uint32 FrameNumber);
+
+	// Identifies a view across frames, ViewIndex is its index in the family. Views without a view state are told apart by their family's render target.
+	static uint32 GetViewKey(const FSceneView& View, int32 ViewIndex);
+
+	// Render thread: the data captured for this view this frame, null if there is none
+	FUdsData* FindViewData_RenderThread(const FSceneView& View);
+
+	FScreenPassTexture AddPasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, const ISpatialUpscaler::FInputs& PassInputs);
+
+	// Game thread: subpasses and view states created so far, stays put once every view being rendered has been seen
+	uint32 GetNumAllocations() const { return NumAllocations; }
 
 private:
+	struct FViewState
+	{
+		FUdsData Frames[UDS_FRAME_SLOTS];
+		uint32 LastUsedFrame = 0;
+	};
+
 	template <class T>
 	T* RegisterSubpass()
 	{
@@ -35,9 +62,28 @@ private:
 		return Subpass;
 	}
 
-	TSharedPtr<FUdsData> GetDataForView(const FViewInfo& View) const;
 
 	EUdsMode Mode;
-	TArray<TSharedPtr<FUdsData>> ViewData;
 	TArray<FUdsSubpass*> FUdsubpasses;
-};
\ No newline at end of file
+
+	FCriticalSection ViewStatesMutex;
+	TMap<uint32, TUniquePtr<FViewState>> ViewStates;
+
+	uint32 NumAllocations = 0;
+};
+
+// Thin handle given to the view family; the engine deletes it when the family tears down, the state it points to lives on
+class FUDComposite final : public ISpatialUpscaler
+{
+public:
+	FUDComposite(TSharedRef<FUdsCompositeState, ESPMode::ThreadSafe> InState);
+
+	// ISpatialUpscaler interface
+	const TCHAR* GetDebugName() const override { return TEXT("FUDComposite"); }
+
+	ISpatialUpscaler* Fork_GameThread(const class FSceneViewFamily& ViewFamily) const override;
+	FScreenPassTexture AddPasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FInputs& PassInputs) const override;
+
+private:
+	TSharedRef<FUdsCompositeState, ESPMode::ThreadSafe> State;
+};
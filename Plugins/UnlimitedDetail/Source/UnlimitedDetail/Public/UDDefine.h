@@ -7,6 +7,11 @@
 
 #include "Containers/UnrealString.h"
 #include "Containers/ResourceArray.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("UnlimitedDetail"), STATGROUP_UnlimitedDetail, STATCAT_Advanced);
+
+DECLARE_LOG_CATEGORY_EXTERN(LogUnlimitedDetail, Log, All);
 
 const TMap<udError, FString> g_udSDKErrorInfo = {
 	{ udE_Success,TEXT("Indicates the operation was successful.") },
@@ -71,6 +76,102 @@ static auto GetError = [](udError e)->const TCHAR* {
 	return TEXT("Unknown error.");
 };
 
+// Pixel layout of the UD textures handed to the composite
+enum class EUDOutputFormat : uint8
+{
+	Full,		// R8G8B8A8 color + R32 float depth, 8 bytes per pixel
+	Depth16,	// R8G8B8A8 color + R16F reversed Z depth, 6 bytes per pixel
+	Packed,		// Single R32 uint texture, R5G6B5 color in the low 16 bits and half float reversed Z depth in the high 16 bits, 4 bytes per pixel
+
+	MAX
+};
+
+// How depth is stored in the uploaded UD textures. udSDK renders 1 - UE's reversed Z device depth with 1 where it didn't draw;
+// formats that convert the depth on the CPU store it as device depth instead so shaders can compare it with scene depth directly.
+enum class EUDDepthConvention : uint8
+{
+	UdNative,
+	ReversedZ,
+
+	MAX
+};
+
+inline EUDDepthConvention GetUDDepthConvention(EUDOutputFormat Format)
+{
+	return (Format == EUDOutputFormat::Full) ? EUDDepthConvention::UdNative : EUDDepthConvention::ReversedZ;
+}
+
+// Where UD pixels enter the frame, see r.Uds.DepthPrepass
+enum class EUDDepthPrepass : uint8
+{
+	Off,		// Post-process composite only
+	Depth,		// UD depth is written into scene depth before the base pass, color is still composited
+	GBuffer,	// UD is also written into the GBuffer as unlit, there is no post-process composite
+
+	MAX
+};
+
+// Screen-space extent of the pixels written by a UD render
+struct FUDCoverage
+{
+	bool bHasCoverage = false;
+	FIntRect Rect; // Inclusive min, exclusive max, in render target pixels
+};
+
+// A view's scene depth from a previous frame, downsampled to its furthest value per block, used to seed the UD depth buffer
+struct FUDOccluderDepth
+{
+	TArray<float> DeviceZ;		// Reversed Z device depth, Size.X * Size.Y
+	FIntPoint Size;
+	FIntRect ViewRect;			// View rect of the scene textures it was read from
+	FMatrix InvViewProjection;	// Of the frame it was read from, without the TAA jitter
+	uint32 FrameNumber = 0;
+};
+
+// Most UD instances a single render can tag for velocity; the tag is the instance's index + 1 in the color alpha, 0xFF is unwritten
+#define UDS_MAX_MOVING_INSTANCES 64
+
+// A UD instance that moved between the previous frame and this one, see r.Uds.Velocity
+struct FUDInstanceMotion
+{
+	FMatrix Transform;		// Local to world, this frame
+	FMatrix PrevTransform;	// Local to world, previous frame
+};
+
+// Layer a UD instance renders in with r.Uds.Layers; Auto picks by its distance from the camera each frame
+enum class EUDRenderLayer : uint8
+{
+	Auto,
+	Near,	// Rendered with the main view, at its resolution
+	Far,	// Rendered on its own at r.Uds.Layers.FarScale and depth merged into the main view
+
+	MAX
+};
+
+// Maps the image in the UD textures onto the current view when it was rendered for an earlier camera, see r.Uds.RenderRate
+struct FUDReprojection
+{
+	bool bEnabled = false;
+	FMatrix SourceClipToClip = FMatrix::Identity; // Clip space the image was rendered in, to the current frame's; both UE's reversed Z, as UD depth is decoded
+};
+
+// Half of the pixels, those with (x + y) & 1 == Parity, were rendered this frame; the rest hold the previous frame's half
+struct FUDCheckerboard
+{
+	bool bEnabled = false;
+	uint32 Parity = 0;
+	bool bHistoryValid = false; // The other half was rendered at this resolution
+	FMatrix PrevClipToClip = FMatrix::Identity; // Clip space of the previous half, to this frame's; both UE's reversed Z, as UD depth is decoded
+};
+
+// PSNR of reconstructed checkerboard frames against their references, with r.Uds.Checkerboard.Reference
+struct FUDCheckerboardQuality
+{
+	double PSNRSum = 0.0;
+	double MinPSNR = 0.0;
+	int32 NumFrames = 0;
+};
+
 template <class Type>
 class FUdSDKResourceBulkData : public FResourceBulkDataInterface
 {
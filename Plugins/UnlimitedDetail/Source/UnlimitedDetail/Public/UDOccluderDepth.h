@@ -0,0 +1,45 @@
+#pragma once
+
+#include "UDDefine.h"
+#include "RenderGraphBuilder.h"
+
+class FRHIGPUTextureReadback;
+class FViewInfo;
+
+// Readbacks in flight across all views; a view's capture is skipped while all of them are busy
+#define UDS_OCCLUDER_READBACKS 4
+
+// Reads back each view's scene depth, downsampled to its furthest value per block, so the next UD render of that view
+// can be seeded with it (see r.Uds.OccluderDepth). Owned by the scene view extension.
+class FUDOccluderDepthHistory
+{
+public:
+	FUDOccluderDepthHistory();
+	~FUDOccluderDepthHistory();
+
+	// Render thread: publishes finished readbacks, then queues this view's depth (complete after the depth prepass) for readback
+	void Capture_RenderThread(FRDGBuilder& GraphBuilder, const FViewInfo& View, uint32 ViewKey);
+
+	// Game thread: the latest depth read back for the view, null if there is none recent enough to reproject
+	TSharedPtr<const FUDOccluderDepth, ESPMode::ThreadSafe> GetOccluderDepth_GameThread(uint32 ViewKey, uint32 FrameNumber) const;
+
+	// Value of r.Uds.OccluderDepth
+	static bool IsEnabled();
+
+private:
+	struct FReadback
+	{
+		TUniquePtr<FRHIGPUTextureReadback> Readback;
+		FUDOccluderDepth Info; // Everything but the data
+		uint32 ViewKey = 0;
+		bool bPending = false;
+	};
+
+	// Also drops the depth of views that haven't been captured for UDS_VIEW_STATE_TIMEOUT frames
+	void PublishReadbacks_RenderThread(uint32 FrameNumber);
+
+	FReadback Readbacks[UDS_OCCLUDER_READBACKS];
+
+	mutable FCriticalSection OccluderDepthMutex;
+	TMap<uint32, TSharedPtr<const FUDOccluderDepth, ESPMode::ThreadSafe>> OccluderDepth;
+};
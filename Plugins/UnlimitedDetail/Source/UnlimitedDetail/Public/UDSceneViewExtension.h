@@ -2,6 +2,11 @@
 
 #include "SceneViewExtension.h"
 
+class FUdsCompositeState;
+class FUDOccluderDepthHistory;
+class FUDCheckerboardScoring;
+struct FUDCheckerboardQuality;
+
 class FUDSceneViewExtension final : public FSceneViewExtensionBase
 {
 public:
@@ -11,4 +16,30 @@ public:
 	void SetupView(FSceneViewFamily &InViewFamily, FSceneView &InView) override;
 
 	void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override;
-};
\ No newline at end of file
+
+	// Render thread hooks for the UD texture upload, r.Uds.DepthPrepass, r.Uds.Temporal, r.Uds.HZB and r.Uds.OccluderDepth
+	void PreRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily) override;
+	void PreRenderBasePass_RenderThread(FRDGBuilder& GraphBuilder, bool bDepthBufferIsPopulated) override;
+	void PostRenderBasePassDeferred_RenderThread(FRDGBuilder& GraphBuilder, FSceneView& InView, const FRenderTargetBindingSlots& RenderTargets, TRDGUniformBufferRef<FSceneTextureUniformParameters> SceneTextures) override;
+	void PrePostProcessPass_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& View, const FPostProcessingInputs& Inputs) override;
+	void PostRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily) override;
+
+	// Checkerboard reconstruction PSNR accumulated since the last call, with r.Uds.Checkerboard.Reference
+	FUDCheckerboardQuality ConsumeCheckerboardQuality();
+
+	// Composite state created so far, see FUdsCompositeState::GetNumAllocations
+	uint32 GetNumCompositeAllocations() const;
+
+private:
+	// The base pass hook has no view, this is the family the render thread is currently in
+	const FSceneViewFamily* RenderingViewFamily = nullptr;
+
+	// Persists across frames, each frame's FUDComposite only references it
+	TSharedPtr<FUdsCompositeState, ESPMode::ThreadSafe> CompositeState;
+
+	// Scene depth read back for seeding UD renders
+	TSharedPtr<FUDOccluderDepthHistory, ESPMode::ThreadSafe> OccluderDepthHistory;
+
+	// Checkerboard reconstructions read back for scoring
+	TSharedPtr<FUDCheckerboardScoring, ESPMode::ThreadSafe> CheckerboardScoring;
+};
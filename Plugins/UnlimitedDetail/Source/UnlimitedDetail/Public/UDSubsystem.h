@@ -7,7 +7,10 @@
 #include "udRenderTarget.h"
 #include "udConfig.h"
 #include "UDDefine.h"
+#include "UDTextureUploader.h"
 #include "SceneView.h"
+#include "Tasks/Task.h"
+#include <atomic>
 
 #include "UDSubsystem.generated.h"
 
@@ -41,8 +44,125 @@ struct FUDPointCloudInstanceHandle
 	int64_t id;
 	const FSceneInterface* Scene;
 	udRenderInstance RenderInstance;
+
+	EUDRenderLayer Layer;
+	bool bDynamic;
+
+	FMatrix Transform;			// As last given to QueueInstance / UpdateInstance
+	FMatrix FrameTransform;		// Transform as of the last frame it was rendered in, and the frame before that
+	FMatrix PrevFrameTransform;
+	uint32 TransformFrame;
+};
+
+// Far layer of the main view, rendered by its own renderer at its own resolution then depth merged into the main buffers, r.Uds.Layers
+struct FUDRenderLayer
+{
+	struct udRenderContext* pRenderer = nullptr;
+	struct udRenderTarget* pRenderView = nullptr;
+	FIntPoint Size = FIntPoint::ZeroValue;
+	TArray<FColor> Color;
+	TArray<float> Depth;
+	TArray<udRenderInstance> RenderInstances;
+	int32 RenderError = 0;
+	double RenderSeconds = 0.0;
+};
+
+// Voxel shader user data for an instance tagged for velocity, wraps the instance's own shader
+struct FUDMotionVoxelShader
+{
+	udVoxelShader* pVoxelShader;
+	void* pVoxelUserData;
+	uint32 Tag;
+};
+
+// Target, buffers and textures of a view captured besides the main one: the second stereo eye (r.Uds.Stereo), rendered with the
+// main renderer and its traversal, or a view rendered in parallel with its own renderer (r.Uds.ParallelViews)
+struct FUDViewTarget
+{
+	struct udRenderContext* pRenderer = nullptr; // Own renderer, null for the stereo eye
+	struct udRenderTarget* pRenderView = nullptr;
+	FUdSDKResourceBulkData<FColor> ColorBulkData;
+	FUdSDKResourceBulkData<float> DepthBulkData;
+	FTexture2DRHIRef ColorTexture;
+	FTexture2DRHIRef DepthTexture;
+	FUDTextureUploader Uploader;
+	FUDTextureUploadPtr PendingUpload;
+	FUDCoverage Coverage;
+	FIntPoint Size = FIntPoint::ZeroValue;
+	EUDOutputFormat Format = EUDOutputFormat::Full;
+	double ViewArray[16] = {};
+	double ProjArray[16] = {};
+
+	// Parallel views render their own copy of the instance list, on a worker
+	TArray<udRenderInstance> RenderInstances;
+	int32 RenderError = 0;
+	double RenderSeconds = 0.0;
+
+	// Stereo eye only: with a traversal margin the first eye renders Margin columns wider than it is into these, then is cropped out of them
+	int32 Margin = 0;
+	struct udRenderTarget* pWideView = nullptr;
+	TArray<FColor> WideColor;
+	TArray<float> WideDepth;
+	double WideProjArray[16] = {};
 };
 
+// How large and how often a throttled view renders, see UUDSubsystem::CaptureThrottledView
+struct FUDThrottle
+{
+	float ResolutionFraction = 1.0f;
+	int32 Interval = 1; // Fewest frames between two renders
+	int32 MaxPerFrame = MAX_int32; // Throttled renders a frame, of every view, past which this one waits
+	bool bPaused = false; // Keeps the image it has, or shows none, whatever changed
+};
+
+// A view's own UD target, kept between the renders it is throttled to: scene captures and unfocused editor viewports
+struct FUDThrottledTarget
+{
+	FUDViewTarget Target;
+	bool bHasImage = false;
+	bool bSettled = false; // Its last render had nothing new to show, the streamer had loaded all the image needed
+	uint32 ImageHash = 0; // Of the image it holds
+	FMatrix ViewProjection = FMatrix::Identity; // Of the image it holds
+	uint32 SceneRevision = 0; // UUDSubsystem::SceneRevision it was rendered at
+	uint32 RenderedFrame = 0;
+	uint32 LastUsedFrame = 0;
+};
+
+// Part of the main view rendered by its own renderer straight into the main buffers, r.Uds.Tiles
+struct FUDRenderTile
+{
+	struct udRenderContext* pRenderer = nullptr; // Null for tile 0, which renders with the main renderer
+	struct udRenderTarget* pRenderView = nullptr;
+	FIntRect Rect;
+	double ProjArray[16] = {};
+	TArray<udRenderInstance> RenderInstances;
+	int32 RenderError = 0;
+	double RenderSeconds = 0.0;
+};
+
+// Where the udSDK login is; it starts with the first point cloud asked for, see UUDSubsystem::RequestLoad
+enum class EUDLoginState : uint8
+{
+	LoggedOut,
+	LoggingIn,	// On a background task
+	LoggedIn,
+	Failed		// Until the next Exit or LoginFunction, or a RequestLoad after r.Uds.Login.RetrySeconds
+};
+
+// What a login task connected, owned by it until the game thread takes it over. Whatever is still in it when the last reference
+// goes, after an Exit that didn't wait for the login, is destroyed and disconnected then.
+struct FUDLoginResult
+{
+	~FUDLoginResult();
+
+	struct udContext* pContext = nullptr;
+	struct udRenderContext* pRenderer = nullptr;
+	int32 Error = 0;
+};
+
+// The point cloud a RequestLoad asked for, null if it or the login failed
+DECLARE_DELEGATE_OneParam(FUDOnPointCloudLoaded, FUDPointCloudHandle*);
+
 UCLASS()
 class UNLIMITEDDETAIL_API UUDSubsystem : public UEngineSubsystem
 {
@@ -58,6 +178,13 @@ public:
 	int LoginFunction();
 	void Exit();
 
+	// Logs in on a background task; does nothing unless logged out
+	void BeginLogin();
+	EUDLoginState GetLoginState() const { return LoginState; };
+
+	// Loads URL once logged in, logging in first if nobody has yet. OnLoaded runs on the game thread, straight away when already logged in.
+	void RequestLoad(const FString& URL, FUDOnPointCloudLoaded OnLoaded);
+
 	FUDPointCloudHandle* Load(FString URL);
 	void Remove(FUDPointCloudHandle* PCI);
 	bool Find(FString URL);
@@ -65,27 +192,143 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "UnlimitedDetail")
 	bool HasSession() const { return (pContext != nullptr); };
 
+	// With EUDOutputFormat::Packed the color texture holds both color and depth and there is no depth texture
 	FTexture2DRHIRef GetColorTexture()const { return ColorTexture; };
 	FTexture2DRHIRef GetDepthTexture()const { return DepthTexture; };
+	EUDOutputFormat GetOutputFormat() const { return OutputFormat; };
+
+	bool IsValid() const { return HasSession() && GetColorTexture().IsValid() && (GetDepthTexture().IsValid() || OutputFormat == EUDOutputFormat::Packed); };
+
+	// Pixels written by the last CaptureUDSImage call
+	const FUDCoverage& GetCoverage() const { return Coverage; };
+
+	// Texture upload staged by the last CaptureUDSImage call, to be handed to FUDTextureUploader::AddUploadPasses on the render thread.
+	// Null if nothing changed or it was already taken.
+	FUDTextureUploadPtr TakeUpload() { return MoveTemp(PendingUpload); };
+
+	// Sub pixel offset the last CaptureUDSImage call rendered with, zero unless r.Uds.Temporal is on
+	FVector2f GetJitter() const { return Jitter; };
+
+	// Instances tagged in the last CaptureUDSImage call, a pixel with color alpha N belongs to element N - 1
+	const TArray<FUDInstanceMotion>& GetInstanceMotion() const { return InstanceMotion; };
+
+	// Set when the UD textures hold an image rendered for an earlier camera, with r.Uds.RenderRate
+	const FUDReprojection& GetReprojection() const { return Reprojection; };
+
+	// Set when the UD textures hold a checkerboard image, with r.Uds.Checkerboard
+	const FUDCheckerboard& GetCheckerboard() const { return ImageCheckerboard; };
+
+	// PSNR of checkerboard reconstructions against their references since the last call, with r.Uds.Checkerboard.Reference
+	FUDCheckerboardQuality ConsumeCheckerboardQuality();
+
+	// Full resolution render of the last checkerboard image, with r.Uds.Checkerboard.Reference
+	TSharedPtr<const TArray<FColor>, ESPMode::ThreadSafe> GetCheckerboardReference() const { return CheckerboardReference; };
+
+	// Second eye of the last CaptureUDSImage call given one, same format as the first
+	FTexture2DRHIRef GetStereoColorTexture() const { return StereoEye.ColorTexture; };
+	FTexture2DRHIRef GetStereoDepthTexture() const { return StereoEye.DepthTexture; };
+	const FUDCoverage& GetStereoCoverage() const { return StereoEye.Coverage; };
+	FUDTextureUploadPtr TakeStereoUpload() { return MoveTemp(StereoEye.PendingUpload); };
+
+	// View ViewIndex of the family given to the last BeginParallelCapture, null for view 0 which is captured by CaptureUDSImage
+	const FUDViewTarget* GetParallelView(int32 ViewIndex) const { return ParallelViews.IsValidIndex(ViewIndex - 1) ? ParallelViews[ViewIndex - 1].Get() : nullptr; };
+	FUDTextureUploadPtr TakeParallelUpload(int32 ViewIndex) { return ParallelViews.IsValidIndex(ViewIndex - 1) ? MoveTemp(ParallelViews[ViewIndex - 1]->PendingUpload) : nullptr; };
+
+	// The target of view ViewKey (FUdsCompositeState::GetViewKey), re-rendered first if it changed and Throttle lets it this frame;
+	// otherwise it holds an earlier image and has no upload. Null when it can't be rendered.
+	// Views without a persistent view state are keyed by the render target of their family, each such capture keeps a target of its own.
+	const FUDViewTarget* CaptureThrottledView(const FSceneView& View, uint32 ViewKey, const FUDThrottle& Throttle);
+	FUDTextureUploadPtr TakeThrottledUpload(uint32 ViewKey);
+
+	// Wall time of the last udRenderContext_Render call
+	double GetLastRenderSeconds() const { return LastRenderSeconds; };
 
-	bool IsValid() const { return HasSession() && GetColorTexture().IsValid() && GetDepthTexture().IsValid(); };
+	// GetLastRenderSeconds summed over every view captured in the latest frame, e.g. both eyes
+	double GetFrameRenderSeconds() const { return FrameRenderSeconds; };
 
-	int64_t QueueInstance(FUDPointCloudHandle* PCI, const FMatrix& InMatrix, FSceneInterface* Scene);
+	// Times the main target and its buffers were recreated, and composite state created, so far; both stay put while the view keeps its size
+	uint32 GetNumViewRecreations() const { return NumViewRecreations; };
+	uint32 GetNumCompositeAllocations() const;
+
+	// bDynamic instances are expected to move, static ones are cached with r.Uds.StaticCache
+	int64_t QueueInstance(FUDPointCloudHandle* PCI, const FMatrix& InMatrix, FSceneInterface* Scene, EUDRenderLayer Layer = EUDRenderLayer::Auto, bool bDynamic = false);
 	bool RemoveInstance(int64_t id);
 	bool UpdateInstance(int64_t id, const FMatrix &InMatrix);
 
-	int CaptureUDSImage(const FSceneView& View);
+	// Both views can be captured by one CaptureUDSImage call, see r.Uds.Stereo
+	bool CanCaptureStereo(const FSceneView& View, const FSceneView& StereoView) const;
+
+	// pOccluderDepth, when given, is reprojected into the depth buffer so udSDK skips voxels behind it.
+	// pStereoView, when CanCaptureStereo, is the second eye and is rendered with View's traversal, see GetStereoColorTexture; occluders are then ignored.
+	int CaptureUDSImage(const FSceneView& View, const FUDOccluderDepth* pOccluderDepth = nullptr, const FSceneView* pStereoView = nullptr);
+
+	// Every view of the family but the first can be rendered on workers while CaptureUDSImage renders the first, see r.Uds.ParallelViews
+	bool CanCaptureParallel(const FSceneViewFamily& Family) const;
+
+	// Starts rendering views 1 and up of Family on task workers, each with its own renderer and target; view 0 is left to CaptureUDSImage.
+	// FinishParallelCapture has to follow in the same frame, it waits for them and stages their uploads, see GetParallelView.
+	void BeginParallelCapture(const FSceneViewFamily& Family);
+	void FinishParallelCapture();
 
 private:
 
 	int Init();
-	int RecreateUDView(int InWidth, int InHeight, float InFOV);
+
+	// udContext_ConnectWithKey, then the renderer; safe off the game thread
+	static int Connect(const FString& InServerUrl, const FString& InAPIKey, struct udContext** ppOutContext, struct udRenderContext** ppOutRenderer);
+
+	// Game thread end of BeginLogin: takes the context and renderer out of Result and runs the queued loads. Ignored unless Generation is the current login's.
+	void FinishLogin(uint32 Generation, FUDLoginResult& Result);
+
+	int RecreateUDView(int InWidth, int InHeight, bool bInCheckerboard, bool bInFoveated);
+	int RecreateStereoEye(bool bEnable, int32 InMargin);
+	void DestroyStereoEye();
+	int RecreateTiles(int32 InNumTiles);
+	int RecreateFarLayer(bool bEnable);
+	void DestroyFarLayer();
+	void DestroyTiles();
+
+	// Buffers, textures and udSDK target of an extra view, rendered by pSharedRenderer or, when null, a renderer of its own
+	int CreateViewTarget(FUDViewTarget& Target, const FIntPoint& Size, EUDOutputFormat Format, struct udRenderContext* pSharedRenderer, const TCHAR* DebugName);
+	void DestroyViewTarget(FUDViewTarget& Target);
+	void StageViewUpload(FUDViewTarget& Target);
+
+	// Fraction of the render size this frame's r.Uds.Progressive step renders at, sets bProgressiveFastRender
+	float UpdateProgressive(const FSceneView& View, const FIntPoint& RenderSize);
+
+	// Renders on a background task at r.Uds.RenderRate, picking up the last finished image
+	int CaptureDecoupled(const FSceneView& View, const FMatrix& UdProjection, const FUDOccluderDepth* pOccluderDepth);
+	void WaitForRender();
+
+	// Game thread setup of the udSDK render: matrices, occluder depth and the instance list
+	void PrepareRender(const FSceneView& View, const FMatrix& UdProjection, const FUDOccluderDepth* pOccluderDepth, bool bTagMotion);
+
+	// Instances of View's scene, wrapped for velocity tagging with bTagMotion. Far layer instances go to pOutFarInstances when given.
+	// With pOutNumStatic static instances come first, that many of them.
+	void GatherRenderInstances(const FSceneView& View, bool bTagMotion, TArray<udRenderInstance>& OutInstances, TArray<udRenderInstance>* pOutFarInstances = nullptr, int32* pOutNumStatic = nullptr);
+
+	// The udSDK render itself, may run on a background task; touches nothing PrepareRender didn't set up
+	int RenderImage();
+	// Pitch is the buffers' row length in pixels, 0 when it is the target's width
+	int RenderTarget(struct udRenderContext* pWithRenderer, TArrayView<udRenderInstance> Instances, struct udRenderTarget* pTarget, FColor* pColor, float* pDepth, const double* pView, const double* pProjection, struct udRenderPicking* pPicking, uint32 Flags, int32 Pitch = 0);
+
+	// Renders every tile into the main buffers, the calling thread alongside workers
+	int RenderTiles(uint32 Flags);
+
+	// Fills the main buffers from the static cache, rendering it first if it's stale, then renders the dynamic instances over them
+	int RenderStaticCached(struct udRenderPicking* pPicking, uint32 Flags);
+
+	// udRenderContextFlags the main view renders with this frame
+	uint32 GetRenderFlags() const;
+	void StageUpload();
+	void AddFrameRenderSeconds(const FSceneView& View, double Seconds);
 
 	FString ServerUrl;
 	FString APIKey;
 
 	FTexture2DRHIRef ColorTexture;
 	FTexture2DRHIRef DepthTexture;
+	EUDOutputFormat OutputFormat = EUDOutputFormat::Full;
 
 	struct udContext* pContext = NULL;
 	struct udContextPartial* pContextPartial = NULL; // New 5.1 context partial for web based logins
@@ -111,7 +354,114 @@ private:
 	FUdSDKResourceBulkData<FColor> ColorBulkData;
 	FUdSDKResourceBulkData<float> DepthBulkData;
 
-	FMatrix ProjectionMatrix;
+	FUDTextureUploader Uploader;
+	FUDTextureUploadPtr PendingUpload;
+	TArray<float> ReprojectionScratch;
+
+	FUDCoverage Coverage;
+	FVector2f Jitter = FVector2f::ZeroVector;
+	TArray<FUDInstanceMotion> InstanceMotion;
+	TArray<FUDMotionVoxelShader> MotionVoxelShaders;
+	TArray<udRenderInstance> RenderInstances;
+	bool bPreserveBuffers = false;
+	bool bFastRender = false; // udRCF_2PixelOpt, of the render last prepared; a background render reads it
+
+	// Progressive refinement, r.Uds.Progressive
+	bool bSceneChanged = true; // An instance was added, removed or moved
+	uint32 SceneRevision = 0; // Counts those changes
+	int32 ProgressiveStep = 0;
+	bool bProgressiveFastRender = false; // This frame's step, game thread only; PrepareRender hands it to bFastRender
+	FMatrix ProgressiveCamera = FMatrix::Identity;
+	FIntPoint ProgressiveRenderSize = FIntPoint::ZeroValue;
+
+	// Written by RenderImage
+	FUDCoverage RenderedCoverage;
+	double RenderedSeconds = 0.0;
+
+	// Lazy login, see BeginLogin. The task hands its FUDLoginResult to FinishLogin.
+	EUDLoginState LoginState = EUDLoginState::LoggedOut;
+	uint32 LoginGeneration = 0; // Counts BeginLogin and Exit calls
+	double LoginFailedSeconds = 0.0; // When LoginState last became Failed
+	TArray<TPair<FString, FUDOnPointCloudLoaded>> PendingLoads;
+
+	// Decoupled rendering, r.Uds.RenderRate
+	UE::Tasks::FTask RenderTask;
+	int32 RenderTaskError = 0;
+	double LastRenderStartSeconds = 0.0;
+	FMatrix RenderViewProjection = FMatrix::Identity; // Of the render last prepared, UE's reversed Z rather than what udSDK was given
+	FMatrix ImageViewProjection = FMatrix::Identity; // Of the image in the textures
+	FUDCoverage ImageCoverage;
+	bool bHasImage = false;
+	FUDReprojection Reprojection;
+	double LastRenderSeconds = 0.0;
+	double FrameRenderSeconds = 0.0;
+	uint32 FrameRenderSecondsFrame = 0;
+	uint32 NumViewRecreations = 0;
+
+	// Checkerboard rendering, r.Uds.Checkerboard. Target t renders rows t, t + 2, ... of this frame's half.
+	bool bCheckerboard = false;
+	struct udRenderTarget* pCheckerboardViews[2] = {};
+	TArray<FColor> CheckerboardColor[2];
+	TArray<float> CheckerboardDepth[2];
+	double CheckerboardProjArrays[2][16] = {};
+	uint32 CheckerboardParity = 0;
+	bool bCheckerboardHistory = false;
+	FMatrix CheckerboardPrevViewProjection = FMatrix::Identity;
+	FUDCheckerboard RenderCheckerboard;
+	FUDCheckerboard ImageCheckerboard;
+	bool bRenderReference = false;
+	TArray<float> ReferenceDepth;
+	TSharedPtr<TArray<FColor>, ESPMode::ThreadSafe> RenderReference;
+	TSharedPtr<const TArray<FColor>, ESPMode::ThreadSafe> CheckerboardReference;
+
+	// Foveated rendering, r.Uds.Foveated. Index 0 is the reduced resolution outer target, 1 the full resolution inner one.
+	bool bFoveated = false;
+	struct udRenderTarget* pFoveatedViews[2] = {};
+	TArray<FColor> FoveatedColor[2];
+	TArray<float> FoveatedDepth[2];
+	double FoveatedProjArrays[2][16] = {};
+	FIntPoint FoveatedSizes[2] = { FIntPoint::ZeroValue, FIntPoint::ZeroValue };
+	FIntRect FoveatedInnerRect; // Where the inner target goes in the full buffer, set by PrepareRender
+
+	// Single pass stereo, r.Uds.Stereo
+	bool bStereo = false;
+	FUDViewTarget StereoEye;
+
+	// Tiled rendering of the main view, r.Uds.Tiles. Empty when it renders in one piece.
+	TArray<FUDRenderTile> Tiles;
+	int32 TilesCount = 1;
+	FIntPoint TilesSize = FIntPoint::ZeroValue;
+
+	// Layered rendering, r.Uds.Layers. The near layer is the main render; bRenderFarLayer is set by PrepareRender when there is anything far.
+	bool bLayers = false;
+	bool bRenderFarLayer = false;
+	FUDRenderLayer FarLayer;
+
+	// Static layer caching, r.Uds.StaticCache. RenderInstances holds NumStaticInstances static instances, then the dynamic ones.
+	bool bStaticCache = false;
+	bool bStaticChanged = true; // A static instance was added, removed or moved
+	bool bStaticCacheValid = false; // Set by RenderImage once the cache holds the static render for the key below
+	int32 StaticCacheKeyRenders = 0; // Renders made with the key below, the cache is filled from the second
+	int32 NumStaticInstances = 0;
+	TArray<FColor> StaticCacheColor;
+	TArray<float> StaticCacheDepth;
+	FMatrix StaticCacheViewProjection = FMatrix::Identity;
+	FIntPoint StaticCacheSize = FIntPoint::ZeroValue;
+	const FSceneInterface* StaticCacheScene = nullptr;
+	bool bStaticCacheFastRender = false;
+
+	// Parallel views, r.Uds.ParallelViews. Views 1 and up of the family, pooled across frames.
+	TArray<TUniquePtr<FUDViewTarget>> ParallelViews;
+	TArray<UE::Tasks::FTask> ParallelTasks;
+	std::atomic<int32> ParallelNextView{ 0 };
+	int32 NumParallelViews = 0;
+	double ParallelStartSeconds = 0.0;
+
+	// Scene captures and unfocused editor viewports. One renderer for all of them, they render one after another on the game thread.
+	struct udRenderContext* pThrottledRenderer = nullptr;
+	TMap<uint32, TUniquePtr<FUDThrottledTarget>> ThrottledViews;
+	uint32 ThrottledFrame = 0;
+	int32 NumThrottledRenders = 0; // In ThrottledFrame
 
 	TSharedPtr<FUDSceneViewExtension, ESPMode::ThreadSafe> ViewExtension;
 };
\ No newline at end of file
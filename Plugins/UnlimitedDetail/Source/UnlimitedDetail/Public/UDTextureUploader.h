@@ -0,0 +1,87 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHI.h"
+#include "RenderGraphDefinitions.h"
+#include "UDDefine.h"
+#include <atomic>
+
+// Staging buffers kept for reuse; more are allocated while every one of them is still referenced by a pending upload
+#define UDS_UPLOAD_STAGING_BUFFERS 3
+
+// Maximum number of textures a UD output format is split over
+#define UDS_MAX_OUTPUT_PLANES 2
+
+// The changed regions of one upload, staged on the game thread and written into the textures by AddUploadPasses on the render thread
+struct FUDTextureUpload
+{
+	FTexture2DRHIRef Textures[UDS_MAX_OUTPUT_PLANES];
+	EUDOutputFormat Format = EUDOutputFormat::Full;
+	int32 NumPlanes = 0;
+
+	TArray<uint8> Data; // Each region's rows for every plane in turn, every block padded to 4 bytes
+	TArray<FIntRect> Rects;
+
+	// Staged and not yet handed to AddUploadPasses. One still set once nobody holds the upload was dropped on the way.
+	std::atomic<bool> bPending{ false };
+};
+
+using FUDTextureUploadPtr = TSharedPtr<FUDTextureUpload, ESPMode::ThreadSafe>;
+
+// Converts the UD color/depth buffers to the output format and stages them for upload into their textures,
+// only sending the regions that changed since the previous upload
+class FUDTextureUploader
+{
+public:
+	// Forgets what was previously uploaded, the next upload sends the whole target
+	void Reset(int32 InWidth, int32 InHeight, EUDOutputFormat InFormat);
+
+	// The next upload sends the whole target, for when a staged upload never reached the textures. Uploads released
+	// without going through AddUploadPasses (a view that didn't render, a composite slot reused) are caught by Upload itself.
+	void Invalidate() { bForceFullUpload = true; }
+
+	// Game thread: converts and diffs this frame's buffers against the last upload and stages the changed regions.
+	// Textures are in plane order, see GetPlanePixelFormat. Returns null when nothing changed.
+	// Uploads have to reach AddUploadPasses in the order they were staged, the next diff assumes the textures hold this one.
+	FUDTextureUploadPtr Upload(const FTexture2DRHIRef* pTextures, const FColor* pColor, const float* pDepth);
+
+	// Render thread: copies the staged regions into the textures through a queued upload buffer, so RDG orders them before the passes reading the textures
+	static void AddUploadPasses(FRDGBuilder& GraphBuilder, const FUDTextureUploadPtr& Upload);
+
+	// Render thread: the texture as seen by this graph, registered once per graph
+	static FRDGTextureRef RegisterTexture(FRDGBuilder& GraphBuilder, const FTexture2DRHIRef& Texture);
+
+	// Flags UD textures are created with, AddUploadPasses writes them from a compute shader
+	static ETextureCreateFlags GetTextureCreateFlags();
+
+	static int32 GetNumPlanes(EUDOutputFormat Format);
+	static EPixelFormat GetPlanePixelFormat(EUDOutputFormat Format, int32 Plane);
+	static int32 GetBytesPerPixel(EUDOutputFormat Format, int32 Plane);
+
+	// Whether a plane is converted from the udSDK buffers rather than uploaded from them directly
+	static bool IsPlaneConverted(EUDOutputFormat Format, int32 Plane);
+
+	// Returns the data of each plane in ppOutPlanes, converting into ppScratch[Plane] (Count pixels) for converted planes
+	static void ConvertPlanes(EUDOutputFormat Format, const FColor* pColor, const float* pDepth, int32 Count, uint8* const* ppScratch, const uint8** ppOutPlanes);
+
+private:
+	// A staging buffer that no pending upload references any more, or a new one
+	FUDTextureUploadPtr AcquireStagingBuffer();
+
+	struct FPlane
+	{
+		int32 BytesPerPixel = 0;
+		TArray<uint8> Converted; // Unused when the plane uploads a raw udSDK buffer
+		TArray<uint8> Prev; // Contents of the texture as of the last upload
+	};
+
+	int32 Width = 0;
+	int32 Height = 0;
+	EUDOutputFormat Format = EUDOutputFormat::Full;
+	bool bForceFullUpload = true;
+
+	int32 NumPlanes = 0;
+	FPlane Planes[UDS_MAX_OUTPUT_PLANES];
+
+	TArray<FUDTextureUploadPtr, TInlineAllocator<UDS_UPLOAD_STAGING_BUFFERS>> StagingBuffers;
+};
@@ -84,6 +84,7 @@ public class UnlimitedDetail : ModuleRules
 				"CoreUObject",
 				"Engine",
 				"Renderer",
+				"EyeTracker",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
@@ -96,6 +97,12 @@ public class UnlimitedDetail : ModuleRules
 			}
 		);
 
+		// Which level viewport has focus, r.Uds.Editor.ViewportPolicy
+		if (Target.bBuildEditor)
+		{
+			PrivateDependencyModuleNames.Add("UnrealEd");
+		}
+
 		if (Target.Type != TargetRules.TargetType.Server)
 		{
 			PrivateDependencyModuleNames.AddRange(new string[] {